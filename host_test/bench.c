@@ -0,0 +1,397 @@
+/*
+ * bench.c
+ *
+ * Per-sample cost of every stage of the pipeline over simulated channels.
+ * A block of scans goes through one stage at a time, the time of a stage
+ * over the block is divided by its samples, so the clock is read twice per
+ * block and stage, not per sample. The median is measured on its own as
+ * well, across its windows against keeping the window sorted, and the
+ * temperature table against interpolating in float per sample, and the
+ * hysteresis and average kernel against the per-channel path it replaced.
+ * The stages from the mV table on run on mV in Q AD_MV_Q as in ad.c.
+ *
+ *   ad_bench [scans]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include "ad.h"
+#include "ad_hal.h"
+#include "ad_mv.h"
+#include "ad_median.h"
+#include "ad_kernel.h"
+#include "ad_iir.h"
+#include "ad_conv.h"
+#include "ad_history.h"
+#include "ad_ring.h"
+#include "ad_stream.h"
+#include "host_port.h"
+#include "scalar_path.h"
+
+#define BLOCK (256)
+#define CHANNELS (MAX_CHANNELS)
+#define MEDIAN_WINDOW (9)
+#define AVG_WINDOW (16)
+#define IIR_STAGES (2)
+#define SAMPLE_HZ (1000)
+
+typedef enum {
+	STAGE_ADC,
+	STAGE_MV,
+	STAGE_MEDIAN,
+	STAGE_HYST,
+	STAGE_AVG,
+	STAGE_IIR,
+	STAGE_TEMP,
+	STAGE_HISTORY,
+	STAGE_RING,
+	STAGE_STREAM,
+	STAGE_MAX
+} stage_t;
+
+static const char *STAGE_NAMES[STAGE_MAX]={"adc", "mv", "median", "hyst", "avg", "iir", "temp", "history", "ring", "stream"};
+
+static ad_snapshot_t snapshot;
+
+BaseType_t ad_get_all(ad_snapshot_t *s) {
+	*s=snapshot;
+	return pdPASS;
+}
+
+static ad_kernel_t kernel;
+static ad_median_t median[CHANNELS];
+static ad_iir_t iir[CHANNELS];
+static ad_ring_t ring;
+static uint16_t raw[BLOCK][CHANNELS];
+static uint16_t v[BLOCK][CHANNELS];
+static int32_t temp[BLOCK][CHANNELS];
+static int32_t lut[AD_MV_CODES];
+static int64_t ts[BLOCK];
+static uint8_t cobs[AD_STREAM_COBS_MAX];
+static uint64_t ns[STAGE_MAX];
+
+static inline uint64_t now_ns() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t) t.tv_sec*1000000000u+t.tv_nsec;
+}
+
+/**
+ * The window kept sorted, an insert moves up to window samples
+ */
+typedef struct {
+	uint16_t ring[AD_MEDIAN_MAX_WINDOW];
+	uint16_t sorted[AD_MEDIAN_MAX_WINDOW];
+	uint16_t window;
+	uint16_t idx;
+	uint16_t count;
+} sorted_median_t;
+
+static uint16_t sorted_insert(sorted_median_t *m, uint16_t value) {
+	int i;
+	if (m->count==m->window) {
+		uint16_t old=m->ring[m->idx];
+		for(i=0; m->sorted[i]!=old; ++i)
+			;
+		for(; i<m->count-1; ++i)
+			m->sorted[i]=m->sorted[i+1];
+		--m->count;
+	}
+	m->ring[m->idx]=value;
+	if (++m->idx>=m->window)
+		m->idx=0;
+
+	for(i=m->count; i>0 && m->sorted[i-1]>value; --i)
+		m->sorted[i]=m->sorted[i-1];
+	m->sorted[i]=value;
+	++m->count;
+	return m->count&1 ? m->sorted[m->count/2] : (m->sorted[m->count/2-1]+m->sorted[m->count/2])/2;
+}
+
+static void bench_median(long samples) {
+	static const uint16_t WINDOWS[]={5, 9, 17, 33, 65, 129, 255};
+	static uint16_t in[BLOCK*CHANNELS];
+	static ad_median_t m;
+	static sorted_median_t sm;
+	ad_sim_t sim;
+	ad_sim_config_t c={.shape=AD_SIM_TRIANGLE, .low=500, .high=3500, .rate=3, .noise=200};
+	ad_sim_init(&sim, &c, 1);
+	for(int i=0; i<BLOCK*CHANNELS; ++i)
+		in[i]=ad_sim_next(&sim);
+
+	long blocks=samples/(BLOCK*CHANNELS)+1;
+	uint32_t sum=0;
+	printf("\nwindow   median   sorted ns/sample\n");
+	for(unsigned w=0; w<sizeof(WINDOWS)/sizeof(WINDOWS[0]); ++w) {
+		if (WINDOWS[w]>AD_MEDIAN_MAX_WINDOW)
+			break;
+
+		ad_median_init(&m, WINDOWS[w]);
+		uint64_t t=now_ns();
+		for(long b=0; b<blocks; ++b)
+			for(int i=0; i<BLOCK*CHANNELS; ++i)
+				sum+=ad_median_insert(&m, in[i]);
+		uint64_t heap_ns=now_ns()-t;
+
+		memset(&sm, 0, sizeof(sm));
+		sm.window=WINDOWS[w];
+		t=now_ns();
+		for(long b=0; b<blocks; ++b)
+			for(int i=0; i<BLOCK*CHANNELS; ++i)
+				sum-=sorted_insert(&sm, in[i]);
+		uint64_t sorted_ns=now_ns()-t;
+
+		double n=(double) blocks*BLOCK*CHANNELS;
+		printf("%6d %8.2f %8.2f\n", WINDOWS[w], heap_ns/n, sorted_ns/n);
+	}
+	//both give the same medians
+	if (sum)
+		printf("median mismatch %u\n", (unsigned) sum);
+}
+
+static void setup(const uint16_t *mv) {
+	for(uint8_t ch=0; ch<CHANNELS; ++ch) {
+		ad_sim_config_t c={.shape=ch%AD_SIM_SHAPE_MAX, .low=500, .high=3500, .rate=ch+1,
+						   .period=100, .noise=8*ch};
+		host_adc_set(ch, &c);
+		snapshot.ch[ch].running=1;
+		uint16_t seed=ad_mv_lookup(mv, ad_hal_adc_read(ch)<<AD_MV_Q);
+		ad_median_init(&median[ch], MEDIAN_WINDOW);
+		ad_kernel_seed(&kernel, ch, seed);
+		ad_kernel_set_window(&kernel, ch, AVG_WINDOW, seed);
+		ad_iir_config(&iir[ch], AD_FILTER_BIQUAD, IIR_STAGES, SAMPLE_HZ/20, SAMPLE_HZ, seed);
+	}
+	static const ad_conv_point_t points[]={{0, 10}, {4096, 100}};
+	ad_conv_build(points, 2, lut, AD_MV_CODES);
+	ad_history_init(CHANNELS);
+	ad_ring_init(&ring);
+	ad_stream_init();
+	ad_stream_start();
+}
+
+static uint32_t run_block(const uint16_t *mv) {
+	const uint32_t mask=(1u<<CHANNELS)-1;
+	uint64_t t=now_ns();
+	for(int i=0; i<BLOCK; ++i) {
+		ts[i]=ad_hal_time_us();
+		for(uint8_t ch=0; ch<CHANNELS; ++ch)
+			raw[i][ch]=ad_hal_adc_read(ch);
+	}
+	uint64_t t1=now_ns();
+	ns[STAGE_ADC]+=t1-t;
+	t=t1;
+
+	for(int i=0; i<BLOCK; ++i)
+		for(uint8_t ch=0; ch<CHANNELS; ++ch)
+			v[i][ch]=ad_mv_lookup(mv, raw[i][ch]<<AD_MV_Q);
+	t1=now_ns();
+	ns[STAGE_MV]+=t1-t;
+	t=t1;
+
+	for(int i=0; i<BLOCK; ++i)
+		for(uint8_t ch=0; ch<CHANNELS; ++ch)
+			v[i][ch]=ad_median_insert(&median[ch], v[i][ch]);
+	t1=now_ns();
+	ns[STAGE_MEDIAN]+=t1-t;
+	t=t1;
+
+	for(int i=0; i<BLOCK; ++i)
+		ad_kernel_hyst(&kernel, mask, v[i], v[i]);
+	t1=now_ns();
+	ns[STAGE_HYST]+=t1-t;
+	t=t1;
+
+	for(int i=0; i<BLOCK; ++i)
+		ad_kernel_avg(&kernel, mask, v[i], v[i]);
+	t1=now_ns();
+	ns[STAGE_AVG]+=t1-t;
+	t=t1;
+
+	for(int i=0; i<BLOCK; ++i)
+		for(uint8_t ch=0; ch<CHANNELS; ++ch)
+			v[i][ch]=ad_iir_process(&iir[ch], v[i][ch]);
+	t1=now_ns();
+	ns[STAGE_IIR]+=t1-t;
+	t=t1;
+
+	for(int i=0; i<BLOCK; ++i)
+		for(uint8_t ch=0; ch<CHANNELS; ++ch)
+			temp[i][ch]=ad_conv_lookup(lut, AD_MV_CODES, v[i][ch], AD_MV_Q);
+	t1=now_ns();
+	ns[STAGE_TEMP]+=t1-t;
+	t=t1;
+
+	for(int i=0; i<BLOCK; ++i)
+		for(uint8_t ch=0; ch<CHANNELS; ++ch)
+			ad_history_push(ch, ts[i], raw[i][ch], (v[i][ch]+(1<<(AD_MV_Q-1)))>>AD_MV_Q);
+	t1=now_ns();
+	ns[STAGE_HISTORY]+=t1-t;
+	t=t1;
+
+	ad_ring_scan_t scan;
+	for(int i=0; i<BLOCK; ++i) {
+		scan.mask=mask;
+		for(uint8_t ch=0; ch<CHANNELS; ++ch) {
+			scan.raw[ch]=raw[i][ch];
+			scan.ts[ch]=scan.deadline[ch]=ts[i];
+		}
+		ad_ring_push(&ring, &scan);
+		ad_ring_pop(&ring, &scan);
+	}
+	t1=now_ns();
+	ns[STAGE_RING]+=t1-t;
+	t=t1;
+
+	uint32_t bytes=0;
+	for(size_t len; (len=ad_stream_next(cobs)); )
+		bytes+=len;
+	ns[STAGE_STREAM]+=now_ns()-t;
+
+	uint32_t sum=bytes;
+	for(uint8_t ch=0; ch<CHANNELS; ++ch)
+		sum+=v[BLOCK-1][ch]+scan.raw[ch]+temp[BLOCK-1][ch];
+	return sum;
+}
+
+/**
+ * The temperature of d interpolated in float on the sorted points, the
+ * segment is searched per sample
+ */
+static float float_temperature(const ad_conv_point_t *p, int n, uint16_t d) {
+	int seg=0;
+	while (seg<n-2 && d>=p[seg+1].d)
+		++seg;
+	return p[seg].t+(p[seg+1].t-p[seg].t)/(p[seg+1].d-p[seg].d)*(d-p[seg].d);
+}
+
+static void bench_kernel(long samples) {
+	static ad_kernel_t k;
+	static uint16_t in[BLOCK][CHANNELS];
+	static uint16_t out[BLOCK][CHANNELS];
+	const uint32_t mask=(1u<<CHANNELS)-1;
+	for(uint8_t ch=0; ch<CHANNELS; ++ch) {
+		ad_sim_t sim;
+		ad_sim_config_t c={.shape=AD_SIM_STEPS, .low=500+ch*300, .high=900+ch*300, .period=500, .noise=4+ch*4};
+		ad_sim_init(&sim, &c, ch+1);
+		for(int i=0; i<BLOCK; ++i)
+			in[i][ch]=ad_sim_next(&sim)<<AD_KERNEL_Q|(i&((1<<AD_KERNEL_Q)-1));
+		uint16_t window=ch&1 ? 16 : 10;
+		ad_kernel_seed(&k, ch, in[0][ch]);
+		ad_kernel_set_window(&k, ch, window, in[0][ch]);
+		scalar_seed(ch, in[0][ch]);
+		scalar_set_window(ch, window, in[0][ch]);
+	}
+
+	long blocks=samples/(BLOCK*CHANNELS)+1;
+	uint64_t t=now_ns();
+	for(long b=0; b<blocks; ++b)
+		for(int i=0; i<BLOCK; ++i)
+			for(uint8_t ch=0; ch<CHANNELS; ++ch)
+				out[i][ch]=scalar_sample(ch, in[i][ch]);
+	uint64_t scalar_ns=now_ns()-t;
+	uint32_t sum=out[BLOCK-1][0];
+
+	t=now_ns();
+	for(long b=0; b<blocks; ++b)
+		for(int i=0; i<BLOCK; ++i) {
+			ad_kernel_hyst(&k, mask, in[i], out[i]);
+			ad_kernel_avg(&k, mask, out[i], out[i]);
+		}
+	uint64_t kernel_ns=now_ns()-t;
+	sum-=out[BLOCK-1][0];
+
+	double n=(double) blocks*BLOCK*CHANNELS;
+	printf("\nhyst+avg     ns/sample\n");
+	printf("per-channel %9.2f\n", scalar_ns/n);
+	printf("kernel      %9.2f\n", kernel_ns/n);
+	if (sum)
+		printf("kernel mismatch\n");
+}
+
+//results of the timed loops, kept so that the loops are not removed
+static volatile float sink_f;
+static volatile int32_t sink_q;
+
+static void bench_conv(long samples) {
+	static const ad_conv_point_t points[]={{200, 5}, {1100, 21.5}, {2300, 48.25}, {3300, 80.125}};
+	const int n=sizeof(points)/sizeof(points[0]);
+	static uint16_t in[BLOCK*CHANNELS];
+	ad_sim_t sim;
+	ad_sim_config_t c={.shape=AD_SIM_RAMP, .low=0, .high=AD_MV_CODES-1, .rate=7, .noise=20};
+	ad_sim_init(&sim, &c, 1);
+	for(int i=0; i<BLOCK*CHANNELS; ++i)
+		in[i]=ad_sim_next(&sim);
+	ad_conv_build(points, n, lut, AD_MV_CODES);
+
+	long blocks=samples/(BLOCK*CHANNELS)+1;
+	float f=0;
+	uint64_t t=now_ns();
+	for(long b=0; b<blocks; ++b)
+		for(int i=0; i<BLOCK*CHANNELS; ++i)
+			f+=float_temperature(points, n, in[i]);
+	uint64_t float_ns=now_ns()-t;
+	sink_f=f;
+
+	int32_t q=0;
+	t=now_ns();
+	for(long b=0; b<blocks; ++b)
+		for(int i=0; i<BLOCK*CHANNELS; ++i)
+			q+=lut[in[i]];
+	uint64_t lut_ns=now_ns()-t;
+
+	t=now_ns();
+	for(long b=0; b<blocks; ++b)
+		for(int i=0; i<BLOCK*CHANNELS; ++i)
+			q+=ad_conv_lookup(lut, AD_MV_CODES, in[i]<<AD_MV_Q|(i&((1<<AD_MV_Q)-1)), AD_MV_Q);
+	uint64_t lookup_ns=now_ns()-t;
+	sink_q=q;
+
+	//error of both against double, the table is exact within its rounding
+	double float_err=0, lut_err=0;
+	for(int d=0; d<AD_MV_CODES; ++d) {
+		int seg=0;
+		while (seg<n-2 && d>=points[seg+1].d)
+			++seg;
+		double r=points[seg].t+((double) points[seg+1].t-points[seg].t)/(points[seg+1].d-points[seg].d)*(d-points[seg].d);
+		float_err=fmax(float_err, fabs(float_temperature(points, n, d)-r));
+		lut_err=fmax(lut_err, fabs(lut[d]/(double) (1<<AD_CONV_Q)-r));
+	}
+	double n_samples=(double) blocks*BLOCK*CHANNELS;
+	printf("\nconversion  ns/sample  max error C\n");
+	printf("float      %9.2f  %.2e\n", float_ns/n_samples, float_err);
+	printf("lut        %9.2f  %.2e\n", lut_ns/n_samples, lut_err);
+	printf("lut Q%d     %9.2f\n", AD_MV_Q, lookup_ns/n_samples);
+}
+
+int main(int argc, char **argv) {
+	long scans=argc>1 ? atol(argv[1]) : 100000;
+	if (scans<BLOCK)
+		scans=BLOCK;
+
+	const uint16_t *mv=ad_mv_table(ADC_ATTEN_DB_11);
+	if (!mv)
+		return 1;
+
+	setup(mv);
+	long blocks=scans/BLOCK;
+	uint32_t sum=0;
+	for(long b=0; b<blocks; ++b)
+		sum+=run_block(mv);
+
+	double samples=(double) blocks*BLOCK*CHANNELS;
+	double total=0;
+	printf("%ld scans of %d channels, checksum %u\n", blocks*BLOCK, CHANNELS, (unsigned) sum);
+	for(int s=0; s<STAGE_MAX; ++s) {
+		printf("%-8s %8.2f ns/sample\n", STAGE_NAMES[s], ns[s]/samples);
+		total+=ns[s];
+	}
+	printf("%-8s %8.2f ns/sample\n", "total", total/samples);
+
+	bench_median(blocks*BLOCK*CHANNELS);
+	bench_conv(blocks*BLOCK*CHANNELS);
+	bench_kernel(blocks*BLOCK*CHANNELS);
+	return 0;
+}
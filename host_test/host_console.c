@@ -0,0 +1,270 @@
+/*
+ * host_console.c
+ *
+ * Command registry of esp_console and the part of argtable3 the commands
+ * use, see argtable3/argtable3.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <regex.h>
+#include "esp_console.h"
+#include "argtable3/argtable3.h"
+
+#define MAX_CMDS (16)
+#define MAX_ARGS (32)
+#define MAX_LINE (256)
+
+static esp_console_cmd_t cmds[MAX_CMDS];
+static int cmd_count;
+
+esp_err_t esp_console_cmd_register(const esp_console_cmd_t *cmd) {
+	if (!cmd || !cmd->command || !cmd->func || strchr(cmd->command, ' '))
+		return ESP_ERR_INVALID_ARG;
+
+	if (cmd_count==MAX_CMDS)
+		return ESP_ERR_NO_MEM;
+
+	cmds[cmd_count++]=*cmd;
+	return ESP_OK;
+}
+
+esp_err_t esp_console_run(const char *cmdline, int *ret) {
+	char line[MAX_LINE];
+	char *argv[MAX_ARGS];
+	int argc=0;
+	strncpy(line, cmdline, sizeof(line)-1);
+	line[sizeof(line)-1]=0;
+	for(char *arg=strtok(line, " \t"); arg && argc<MAX_ARGS; arg=strtok(NULL, " \t"))
+		argv[argc++]=arg;
+	if (!argc)
+		return ESP_ERR_INVALID_ARG;
+
+	for(int i=0; i<cmd_count; ++i)
+		if (!strcmp(cmds[i].command, argv[0])) {
+			*ret=cmds[i].func(argc, argv);
+			return ESP_OK;
+		}
+
+	return ESP_ERR_NOT_FOUND;
+}
+
+static void reset_count(void *parent) {
+	//every argument has its count right after the header
+	*(int *) ((struct arg_hdr *) parent+1)=0;
+}
+
+static int scan_lit(void *parent, const char *argval) {
+	struct arg_lit *a=parent;
+	(void) argval;
+	if (a->count>=a->hdr.maxcount)
+		return 1;
+
+	++a->count;
+	return 0;
+}
+
+static int scan_int(void *parent, const char *argval) {
+	struct arg_int *a=parent;
+	int base=10;
+	if (argval[0]=='0' && argval[1] && strchr("xXoObB", argval[1])) {
+		base=strchr("xX", argval[1]) ? 16 : strchr("oO", argval[1]) ? 8 : 2;
+		argval+=2;
+	}
+	char *end;
+	long v=strtol(argval, &end, base);
+	if (a->count>=a->hdr.maxcount || end==argval || *end)
+		return 1;
+
+	a->ival[a->count++]=v;
+	return 0;
+}
+
+static int scan_dbl(void *parent, const char *argval) {
+	struct arg_dbl *a=parent;
+	char *end;
+	double v=strtod(argval, &end);
+	if (a->count>=a->hdr.maxcount || end==argval || *end)
+		return 1;
+
+	a->dval[a->count++]=v;
+	return 0;
+}
+
+static int scan_str(void *parent, const char *argval) {
+	struct arg_str *a=parent;
+	if (a->count>=a->hdr.maxcount)
+		return 1;
+
+	a->sval[a->count++]=argval;
+	return 0;
+}
+
+static int scan_rex(void *parent, const char *argval) {
+	struct arg_rex *a=parent;
+	if (a->count>=a->hdr.maxcount || regexec(a->hdr.priv, argval, 0, NULL, 0))
+		return 1;
+
+	a->sval[a->count++]=argval;
+	return 0;
+}
+
+/**
+ * Allocates an argument of size bytes followed by maxcount values of
+ * value_size bytes
+ */
+static void *arg_new(size_t size, size_t value_size, char flag, const char *shortopts, const char *longopts,
+					 const char *datatype, const char *glossary, arg_scanfn *scanfn) {
+	const int maxcount=1;
+	struct arg_hdr *hdr=calloc(1, size+maxcount*value_size);
+	if (!hdr)
+		return NULL;
+
+	*hdr=(struct arg_hdr) {
+		.flag=flag,
+		.shortopts=shortopts,
+		.longopts=longopts,
+		.datatype=datatype,
+		.glossary=glossary,
+		.mincount=0,
+		.maxcount=maxcount,
+		.parent=hdr,
+		.resetfn=reset_count,
+		.scanfn=scanfn
+	};
+	return hdr;
+}
+
+struct arg_lit *arg_lit0(const char *shortopts, const char *longopts, const char *glossary) {
+	return arg_new(sizeof(struct arg_lit), 0, 0, shortopts, longopts, NULL, glossary, scan_lit);
+}
+
+struct arg_int *arg_int0(const char *shortopts, const char *longopts, const char *datatype,
+						 const char *glossary) {
+	struct arg_int *a=arg_new(sizeof(*a), sizeof(int), ARG_HASVALUE, shortopts, longopts, datatype, glossary,
+							  scan_int);
+	if (a)
+		a->ival=(int *) (a+1);
+	return a;
+}
+
+struct arg_dbl *arg_dbl0(const char *shortopts, const char *longopts, const char *datatype,
+						 const char *glossary) {
+	struct arg_dbl *a=arg_new(sizeof(*a), sizeof(double), ARG_HASVALUE, shortopts, longopts, datatype, glossary,
+							  scan_dbl);
+	if (a)
+		a->dval=(double *) (a+1);
+	return a;
+}
+
+struct arg_str *arg_str0(const char *shortopts, const char *longopts, const char *datatype,
+						 const char *glossary) {
+	struct arg_str *a=arg_new(sizeof(*a), sizeof(char *), ARG_HASVALUE, shortopts, longopts, datatype, glossary,
+							  scan_str);
+	if (a)
+		a->sval=(const char **) (a+1);
+	return a;
+}
+
+struct arg_rex *arg_rex0(const char *shortopts, const char *longopts, const char *pattern,
+						 const char *datatype, int flags, const char *glossary) {
+	struct arg_rex *a=arg_new(sizeof(*a), sizeof(char *), ARG_HASVALUE, shortopts, longopts, datatype, glossary,
+							  scan_rex);
+	regex_t *re=malloc(sizeof(regex_t));
+	if (!a || !re || regcomp(re, pattern, REG_EXTENDED|REG_NOSUB|(flags&ARG_REX_ICASE ? REG_ICASE : 0))) {
+		free(a);
+		free(re);
+		return NULL;
+	}
+	a->sval=(const char **) (a+1);
+	a->hdr.priv=re;
+	return a;
+}
+
+struct arg_end *arg_end(int maxerrors) {
+	(void) maxerrors;
+	return arg_new(sizeof(struct arg_end), 0, ARG_TERMINATOR, NULL, NULL, NULL, NULL, NULL);
+}
+
+/**
+ * @return the argument of the long option name, an unambiguous prefix of
+ * 		  one is accepted, NULL if there is none
+ */
+static struct arg_hdr *find_long(void **argtable, const char *name, size_t len) {
+	struct arg_hdr *found=NULL;
+	int matches=0;
+	for(struct arg_hdr **a=(struct arg_hdr **) argtable; !((*a)->flag&ARG_TERMINATOR); ++a) {
+		if (!(*a)->longopts || strncmp((*a)->longopts, name, len))
+			continue;
+
+		if (!(*a)->longopts[len])
+			return *a;
+
+		found=*a;
+		++matches;
+	}
+	return matches==1 ? found : NULL;
+}
+
+static struct arg_hdr *find_short(void **argtable, char c) {
+	for(struct arg_hdr **a=(struct arg_hdr **) argtable; !((*a)->flag&ARG_TERMINATOR); ++a)
+		if ((*a)->shortopts && strchr((*a)->shortopts, c))
+			return *a;
+
+	return NULL;
+}
+
+int arg_parse(int argc, char **argv, void **argtable) {
+	struct arg_hdr **a=(struct arg_hdr **) argtable;
+	for(; !((*a)->flag&ARG_TERMINATOR); ++a)
+		(*a)->resetfn((*a)->parent);
+	struct arg_end *end=(struct arg_end *) *a;
+
+	int errors=0;
+	for(int i=1; i<argc; ++i) {
+		const char *arg=argv[i];
+		if (arg[0]!='-' || !arg[1]) {
+			++errors;	//no positional arguments
+			continue;
+		}
+		if (arg[1]=='-') {
+			const char *name=arg+2;
+			const char *value=strchr(name, '=');
+			struct arg_hdr *opt=find_long(argtable, name, value ? (size_t) (value-name) : strlen(name));
+			if (!opt || (value && !(opt->flag&ARG_HASVALUE))) {
+				++errors;
+				continue;
+			}
+			if (opt->flag&ARG_HASVALUE && !value) {
+				if (i+1==argc) {
+					++errors;
+					continue;
+				}
+				value=argv[++i];
+			}
+			else if (value)
+				++value;
+			errors+=opt->scanfn(opt->parent, value)!=0;
+			continue;
+		}
+		//a cluster of short options, the value of the last one is attached or the next argument
+		for(const char *c=arg+1; *c; ++c) {
+			struct arg_hdr *opt=find_short(argtable, *c);
+			if (!opt) {
+				++errors;
+				break;
+			}
+			if (!(opt->flag&ARG_HASVALUE)) {
+				errors+=opt->scanfn(opt->parent, NULL)!=0;
+				continue;
+			}
+			const char *value=c[1] ? c+1 : i+1<argc ? argv[++i] : NULL;
+			errors+=!value || opt->scanfn(opt->parent, value)!=0;
+			break;
+		}
+	}
+	for(a=(struct arg_hdr **) argtable; !((*a)->flag&ARG_TERMINATOR); ++a)
+		errors+=*(int *) (*a+1)<(*a)->mincount;
+	end->count=errors;
+	return errors;
+}
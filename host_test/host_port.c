@@ -0,0 +1,161 @@
+/*
+ * host_port.c
+ */
+
+#include <string.h>
+#include "driver/adc.h"
+#include "driver/uart.h"
+#include "esp_adc_cal.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+
+#include "host_port.h"
+
+#define UART_SIZE (1<<16)
+#define NVS_KEYS (16)
+#define NVS_BLOB_MAX (4096)
+
+typedef struct {
+	char key[NVS_KEY_NAME_MAX_SIZE];
+	uint8_t value[NVS_BLOB_MAX];
+	size_t len;
+} nvs_entry_t;
+
+static ad_sim_t sims[ADC1_CHANNEL_MAX];
+static uint8_t uart[UART_SIZE];
+static size_t uart_len;
+static nvs_entry_t nvs[NVS_KEYS];
+
+//full scale of the attenuations, mV
+static const uint16_t FULL_SCALE[ADC_ATTEN_MAX]={1100, 1500, 2200, 3100};
+
+int host_adc_set(adc1_channel_t channel, const ad_sim_config_t *config) {
+	return channel<ADC1_CHANNEL_MAX && ad_sim_init(&sims[channel], config, channel+1);
+}
+
+esp_err_t adc1_config_width(adc_bits_width_t width) {
+	return width==ADC_WIDTH_BIT_12 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t adc1_config_channel_atten(adc1_channel_t channel, adc_atten_t atten) {
+	return channel<ADC1_CHANNEL_MAX && atten<ADC_ATTEN_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+int adc1_get_raw(adc1_channel_t channel) {
+	if (channel>=ADC1_CHANNEL_MAX)
+		return -1;
+
+	return sims[channel].seed ? ad_sim_next(&sims[channel]) : 0;
+}
+
+int uart_write_bytes(int port, const void *src, size_t size) {
+	(void) port;
+	size_t n=size<UART_SIZE-uart_len ? size : UART_SIZE-uart_len;
+	memcpy(uart+uart_len, src, n);
+	uart_len+=n;
+	return n;
+}
+
+size_t host_uart_take(uint8_t *buf, size_t size) {
+	size_t n=size<uart_len ? size : uart_len;
+	memcpy(buf, uart, n);
+	memmove(uart, uart+n, uart_len-n);
+	uart_len-=n;
+	return n;
+}
+
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t unit, adc_atten_t atten, adc_bits_width_t width,
+											 uint32_t default_vref, esp_adc_cal_characteristics_t *chars) {
+	(void) unit; (void) width;
+	chars->atten=atten;
+	chars->vref=default_vref;
+	chars->full_scale_mv=FULL_SCALE[atten]*default_vref/1100;
+	return ESP_ADC_CAL_VAL_DEFAULT_VREF;
+}
+
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t raw, const esp_adc_cal_characteristics_t *chars) {
+	return (raw*chars->full_scale_mv+2047)/4095;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+	crc=~crc;
+	while (len--) {
+		crc^=*buf++;
+		for(int bit=0; bit<8; ++bit)
+			crc=crc>>1^(0xedb88320u&-(crc&1));
+	}
+	return ~crc;
+}
+
+static nvs_entry_t *nvs_find(const char *key) {
+	for(int i=0; i<NVS_KEYS; ++i)
+		if (nvs[i].len && !strncmp(nvs[i].key, key, NVS_KEY_NAME_MAX_SIZE))
+			return &nvs[i];
+
+	return NULL;
+}
+
+void host_nvs_erase() {
+	memset(nvs, 0, sizeof(nvs));
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *handle) {
+	(void) name; (void) mode;
+	*handle=1;
+	return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *value, size_t *len) {
+	(void) handle;
+	const nvs_entry_t *e=nvs_find(key);
+	if (!e)
+		return ESP_ERR_NVS_NOT_FOUND;
+
+	if (value && *len<e->len)
+		return ESP_ERR_NVS_INVALID_LENGTH;
+
+	if (value)
+		memcpy(value, e->value, e->len);
+	*len=e->len;
+	return ESP_OK;
+}
+
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char *key, uint16_t *value) {
+	size_t len=sizeof(*value);
+	const nvs_entry_t *e=nvs_find(key);
+	if (e && e->len!=len)
+		return ESP_ERR_NVS_INVALID_LENGTH;
+
+	return nvs_get_blob(handle, key, value, &len);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t len) {
+	(void) handle;
+	if (!len || len>NVS_BLOB_MAX)
+		return ESP_ERR_INVALID_ARG;
+
+	nvs_entry_t *e=nvs_find(key);
+	for(int i=0; !e && i<NVS_KEYS; ++i)
+		if (!nvs[i].len)
+			e=&nvs[i];
+	if (!e)
+		return ESP_ERR_NO_MEM;
+
+	strncpy(e->key, key, NVS_KEY_NAME_MAX_SIZE-1);
+	memcpy(e->value, value, len);
+	e->len=len;
+	return ESP_OK;
+}
+
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char *key, uint16_t value) {
+	return nvs_set_blob(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+	(void) handle;
+	return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+	(void) handle;
+}
@@ -0,0 +1,49 @@
+/*
+ * host_port.h
+ *
+ * Controls of the host port of the ADC, the console UART, the NVS and the
+ * tasks, the tests and the bench set the inputs and read the outputs through
+ * these.
+ */
+
+#ifndef HOST_PORT_H_
+#define HOST_PORT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/adc.h"
+#include "ad_sim.h"
+
+/**
+ * @brief channel reads config from now on, a constant low if never set
+ * @return 0 if the config is invalid
+ */
+int host_adc_set(adc1_channel_t channel, const ad_sim_config_t *config);
+
+/**
+ * @brief moves the bytes written to the UART so far into buf
+ * @return bytes moved, the rest stays
+ */
+size_t host_uart_take(uint8_t *buf, size_t size);
+
+/**
+ * @brief removes every key
+ */
+void host_nvs_erase();
+
+/**
+ * @brief runs the body of a created task in a thread of its own, vTaskDelete()
+ * 		  ends it at its next delay or notification wait
+ * @return 0 if the task is already running or it cannot start
+ */
+int host_task_start(TaskHandle_t task);
+
+/**
+ * @brief the task of the calling thread, the test thread gets one on its
+ * 		  first call, so it can wait for notifications
+ */
+TaskHandle_t host_task_self();
+
+#endif /* HOST_PORT_H_ */
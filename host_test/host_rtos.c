@@ -0,0 +1,421 @@
+/*
+ * host_rtos.c
+ *
+ * Tasks, notifications, mutexes, queues and the esp_timer of the host on
+ * pthreads. Every wait is on the condition of the waiting task or queue
+ * under one lock, the timeouts are on the clock of esp_timer_get_time().
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+
+#include "host_port.h"
+
+#define FOREVER (-1)
+
+struct host_task {
+	TaskFunction_t fn;
+	void *arg;
+	UBaseType_t priority;
+	uint8_t started;
+	uint8_t deleted;
+	uint32_t notify;
+	pthread_t thread;
+	pthread_cond_t cond;
+};
+
+struct host_mutex {
+	pthread_mutex_t mutex;
+};
+
+struct host_queue {
+	UBaseType_t length;
+	UBaseType_t item_size;
+	UBaseType_t head;
+	UBaseType_t used;
+	pthread_cond_t cond;
+	uint8_t items[];
+};
+
+struct esp_timer {
+	esp_timer_cb_t callback;
+	void *arg;
+	uint8_t armed;
+	int64_t expiry;
+	struct esp_timer *next;
+};
+
+static pthread_mutex_t lock=PTHREAD_MUTEX_INITIALIZER;
+static __thread struct host_task *self;
+static struct esp_timer *timers;
+static pthread_cond_t timer_cond;
+static pthread_once_t timer_once=PTHREAD_ONCE_INIT;
+
+static void cond_init(pthread_cond_t *cond) {
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+static inline int64_t ticks_to_deadline(TickType_t ticks) {
+	return ticks==portMAX_DELAY ? FOREVER : esp_timer_get_time()+(int64_t) ticks*portTICK_PERIOD_MS*1000;
+}
+
+/**
+ * Waits on cond with lock held until it is signalled or deadline passes
+ */
+static void wait_for(pthread_cond_t *cond, int64_t deadline) {
+	if (deadline==FOREVER) {
+		pthread_cond_wait(cond, &lock);
+		return;
+	}
+	struct timespec ts={ .tv_sec=deadline/1000000, .tv_nsec=deadline%1000000*1000 };
+	pthread_cond_timedwait(cond, &lock, &ts);
+}
+
+static inline int expired(int64_t deadline) {
+	return deadline!=FOREVER && esp_timer_get_time()>=deadline;
+}
+
+/**
+ * Ends the calling task if it was deleted, lock is held
+ */
+static void exit_if_deleted(struct host_task *task) {
+	if (!task->deleted)
+		return;
+
+	pthread_mutex_unlock(&lock);
+	pthread_exit(NULL);
+}
+
+static struct host_task *task_new(TaskFunction_t fn, void *arg, UBaseType_t priority) {
+	struct host_task *task=calloc(1, sizeof(*task));
+	if (!task)
+		return NULL;
+
+	task->fn=fn;
+	task->arg=arg;
+	task->priority=priority;
+	cond_init(&task->cond);
+	return task;
+}
+
+static void *task_main(void *arg) {
+	self=arg;
+	self->fn(self->arg);
+	return NULL;
+}
+
+TaskHandle_t host_task_self() {
+	if (!self)
+		self=task_new(NULL, NULL, tskIDLE_PRIORITY);
+	return self;
+}
+
+int host_task_start(TaskHandle_t task) {
+	if (!task || !task->fn || task->started)
+		return 0;
+
+	task->started=1;
+	return !pthread_create(&task->thread, NULL, task_main, task);
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+					   UBaseType_t priority, TaskHandle_t *handle) {
+	(void) name; (void) stack;
+	struct host_task *task=task_new(fn, arg, priority);
+	if (!task)
+		return pdFAIL;
+
+	if (handle)
+		*handle=task;
+	return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+								   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+	(void) core;
+	return xTaskCreate(fn, name, stack, arg, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+	if (!task)
+		task=host_task_self();
+	pthread_mutex_lock(&lock);
+	task->deleted=1;
+	pthread_cond_broadcast(&task->cond);
+	if (task==self)
+		exit_if_deleted(task);
+	pthread_mutex_unlock(&lock);
+	if (task->started)
+		pthread_join(task->thread, NULL);
+	task->started=0;
+}
+
+void vTaskDelay(TickType_t ticks) {
+	struct host_task *task=host_task_self();
+	int64_t deadline=ticks_to_deadline(ticks);
+	pthread_mutex_lock(&lock);
+	while (!task->deleted && !expired(deadline))
+		wait_for(&task->cond, deadline);
+	exit_if_deleted(task);
+	pthread_mutex_unlock(&lock);
+}
+
+TickType_t xTaskGetTickCount() {
+	return esp_timer_get_time()/(portTICK_PERIOD_MS*1000);
+}
+
+void vTaskDelayUntil(TickType_t *last, TickType_t ticks) {
+	*last+=ticks;
+	int32_t left=(int32_t) (*last-xTaskGetTickCount());
+	vTaskDelay(left>0 ? left : 0);
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+	pthread_mutex_lock(&lock);
+	switch (action) {
+	case eSetBits:
+		task->notify|=value;
+		break;
+	case eIncrement:
+		++task->notify;
+		break;
+	case eSetValueWithOverwrite:
+		task->notify=value;
+		break;
+	default:
+		break;
+	}
+	pthread_cond_broadcast(&task->cond);
+	pthread_mutex_unlock(&lock);
+	return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+	return xTaskNotify(task, 0, eIncrement);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) {
+	xTaskNotifyGive(task);
+	if (woken)
+		*woken=pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+	struct host_task *task=host_task_self();
+	int64_t deadline=ticks_to_deadline(ticks);
+	pthread_mutex_lock(&lock);
+	while (!task->notify && !task->deleted && !expired(deadline))
+		wait_for(&task->cond, deadline);
+	exit_if_deleted(task);
+	uint32_t value=task->notify;
+	if (value)
+		task->notify=clear ? 0 : value-1;
+	pthread_mutex_unlock(&lock);
+	return value;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+	(void) task;
+	return 0;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task) {
+	return (task ? task : host_task_self())->priority;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+	struct host_mutex *sem=malloc(sizeof(*sem));
+	if (!sem)
+		return NULL;
+
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+	pthread_mutex_init(&sem->mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	return sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+	if (ticks==portMAX_DELAY)
+		return !pthread_mutex_lock(&sem->mutex);
+
+	if (!ticks)
+		return !pthread_mutex_trylock(&sem->mutex);
+
+	//the timed lock waits on the real time clock
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec+=ticks*portTICK_PERIOD_MS/1000;
+	ts.tv_nsec+=ticks*portTICK_PERIOD_MS%1000*1000000;
+	if (ts.tv_nsec>=1000000000) {
+		++ts.tv_sec;
+		ts.tv_nsec-=1000000000;
+	}
+	return !pthread_mutex_timedlock(&sem->mutex, &ts);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+	return !pthread_mutex_unlock(&sem->mutex);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+	pthread_mutex_destroy(&sem->mutex);
+	free(sem);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+	struct host_queue *queue=calloc(1, sizeof(*queue)+length*item_size);
+	if (!queue)
+		return NULL;
+
+	queue->length=length;
+	queue->item_size=item_size;
+	cond_init(&queue->cond);
+	return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+	int64_t deadline=ticks_to_deadline(ticks);
+	pthread_mutex_lock(&lock);
+	while (queue->used==queue->length && !expired(deadline))
+		wait_for(&queue->cond, deadline);
+	BaseType_t res=queue->used<queue->length;
+	if (res) {
+		UBaseType_t tail=(queue->head+queue->used)%queue->length;
+		memcpy(queue->items+tail*queue->item_size, item, queue->item_size);
+		++queue->used;
+		pthread_cond_broadcast(&queue->cond);
+	}
+	pthread_mutex_unlock(&lock);
+	return res;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+	int64_t deadline=ticks_to_deadline(ticks);
+	pthread_mutex_lock(&lock);
+	while (!queue->used && !expired(deadline))
+		wait_for(&queue->cond, deadline);
+	BaseType_t res=queue->used>0;
+	if (res) {
+		memcpy(item, queue->items+queue->head*queue->item_size, queue->item_size);
+		queue->head=(queue->head+1)%queue->length;
+		--queue->used;
+		pthread_cond_broadcast(&queue->cond);
+	}
+	pthread_mutex_unlock(&lock);
+	return res;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+	pthread_cond_destroy(&queue->cond);
+	free(queue);
+}
+
+/**
+ * Dispatch thread of the timers, it runs the callback of the earliest
+ * expired timer without the lock
+ */
+static void *fn_timers(void *arg) {
+	(void) arg;
+	pthread_mutex_lock(&lock);
+	for(;;) {
+		struct esp_timer *first=NULL;
+		for(struct esp_timer *t=timers; t; t=t->next)
+			if (t->armed && (!first || t->expiry<first->expiry))
+				first=t;
+
+		if (!first) {
+			wait_for(&timer_cond, FOREVER);
+			continue;
+		}
+		if (!expired(first->expiry)) {
+			wait_for(&timer_cond, first->expiry);
+			continue;
+		}
+		first->armed=0;
+		esp_timer_cb_t callback=first->callback;
+		void *cb_arg=first->arg;
+		pthread_mutex_unlock(&lock);
+		callback(cb_arg);
+		pthread_mutex_lock(&lock);
+	}
+	return NULL;
+}
+
+static void timers_init() {
+	pthread_t thread;
+	cond_init(&timer_cond);
+	pthread_create(&thread, NULL, fn_timers, NULL);
+	pthread_detach(thread);
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *timer) {
+	if (!args || !args->callback || !timer)
+		return ESP_ERR_INVALID_ARG;
+
+	struct esp_timer *t=calloc(1, sizeof(*t));
+	if (!t)
+		return ESP_ERR_NO_MEM;
+
+	pthread_once(&timer_once, timers_init);
+	t->callback=args->callback;
+	t->arg=args->arg;
+	pthread_mutex_lock(&lock);
+	t->next=timers;
+	timers=t;
+	pthread_mutex_unlock(&lock);
+	*timer=t;
+	return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+	esp_err_t res=ESP_ERR_INVALID_STATE;
+	pthread_mutex_lock(&lock);
+	if (!timer->armed) {
+		timer->armed=1;
+		timer->expiry=esp_timer_get_time()+timeout_us;
+		pthread_cond_signal(&timer_cond);
+		res=ESP_OK;
+	}
+	pthread_mutex_unlock(&lock);
+	return res;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+	esp_err_t res=ESP_ERR_INVALID_STATE;
+	pthread_mutex_lock(&lock);
+	if (timer->armed) {
+		timer->armed=0;
+		res=ESP_OK;
+	}
+	pthread_mutex_unlock(&lock);
+	return res;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+	esp_err_t res=ESP_ERR_INVALID_STATE;
+	pthread_mutex_lock(&lock);
+	if (!timer->armed) {
+		struct esp_timer **t=&timers;
+		while (*t!=timer)
+			t=&(*t)->next;
+		*t=timer->next;
+		res=ESP_OK;
+	}
+	pthread_mutex_unlock(&lock);
+	if (res==ESP_OK)
+		free(timer);
+	return res;
+}
@@ -0,0 +1,96 @@
+/*
+ * argtable3.h
+ *
+ * The part of argtable3 the console commands use: optional literals,
+ * integers, doubles, strings and regular expressions with short and long
+ * options. A long option can be abbreviated to a unique prefix, an integer
+ * takes the 0x, 0o and 0b prefixes.
+ */
+
+#ifndef HOST_ARGTABLE3_H_
+#define HOST_ARGTABLE3_H_
+
+#define ARG_TERMINATOR (0x1)
+#define ARG_HASVALUE (0x2)
+
+#define ARG_REX_ICASE (1)
+
+typedef void (arg_resetfn)(void *parent);
+typedef int (arg_scanfn)(void *parent, const char *argval);
+
+/**
+ * Common head of the arguments, scanfn stores argval and returns non-zero
+ * if it is invalid or the argument is given too many times
+ */
+struct arg_hdr {
+	char flag;
+	const char *shortopts;
+	const char *longopts;
+	const char *datatype;
+	const char *glossary;
+	int mincount;
+	int maxcount;
+	void *parent;
+	arg_resetfn *resetfn;
+	arg_scanfn *scanfn;
+	void *priv;
+};
+
+struct arg_lit {
+	struct arg_hdr hdr;
+	int count;
+};
+
+struct arg_int {
+	struct arg_hdr hdr;
+	int count;
+	int *ival;
+};
+
+struct arg_dbl {
+	struct arg_hdr hdr;
+	int count;
+	double *dval;
+};
+
+struct arg_str {
+	struct arg_hdr hdr;
+	int count;
+	const char **sval;
+};
+
+struct arg_rex {
+	struct arg_hdr hdr;
+	int count;
+	const char **sval;
+};
+
+struct arg_end {
+	struct arg_hdr hdr;
+	int count;		//errors of the last arg_parse
+};
+
+struct arg_lit *arg_lit0(const char *shortopts, const char *longopts, const char *glossary);
+
+struct arg_int *arg_int0(const char *shortopts, const char *longopts, const char *datatype,
+						 const char *glossary);
+
+struct arg_dbl *arg_dbl0(const char *shortopts, const char *longopts, const char *datatype,
+						 const char *glossary);
+
+struct arg_str *arg_str0(const char *shortopts, const char *longopts, const char *datatype,
+						 const char *glossary);
+
+struct arg_rex *arg_rex0(const char *shortopts, const char *longopts, const char *pattern,
+						 const char *datatype, int flags, const char *glossary);
+
+struct arg_end *arg_end(int maxerrors);
+
+/**
+ * @param argtable the arguments, the last one is an arg_end
+ * @return the number of errors, an unknown option, a missing or invalid
+ * 		   value and a repeated option are errors
+ */
+int arg_parse(int argc, char **argv, void **argtable);
+
+#endif /* HOST_ARGTABLE3_H_ */
@@ -0,0 +1,53 @@
+/*
+ * adc.h
+ *
+ * ADC1 of the host, every channel reads from a signal generator of ad_sim,
+ * see host_adc_set().
+ */
+
+#ifndef HOST_DRIVER_ADC_H_
+#define HOST_DRIVER_ADC_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+	ADC_UNIT_1=1,
+	ADC_UNIT_2=2
+} adc_unit_t;
+
+typedef enum {
+	ADC_CHANNEL_0=0, ADC_CHANNEL_1, ADC_CHANNEL_2, ADC_CHANNEL_3,
+	ADC_CHANNEL_4, ADC_CHANNEL_5, ADC_CHANNEL_6, ADC_CHANNEL_7,
+	ADC_CHANNEL_MAX
+} adc_channel_t;
+
+typedef enum {
+	ADC1_CHANNEL_0=0, ADC1_CHANNEL_1, ADC1_CHANNEL_2, ADC1_CHANNEL_3,
+	ADC1_CHANNEL_4, ADC1_CHANNEL_5, ADC1_CHANNEL_6, ADC1_CHANNEL_7,
+	ADC1_CHANNEL_MAX
+} adc1_channel_t;
+
+typedef enum {
+	ADC_ATTEN_DB_0=0,
+	ADC_ATTEN_DB_2_5,
+	ADC_ATTEN_DB_6,
+	ADC_ATTEN_DB_11,
+	ADC_ATTEN_MAX
+} adc_atten_t;
+
+typedef enum {
+	ADC_WIDTH_BIT_12=3
+} adc_bits_width_t;
+
+esp_err_t adc1_config_width(adc_bits_width_t width);
+
+/**
+ * @brief the host ADC reads codes, the mV of an attenuation come from
+ * 		  esp_adc_cal
+ */
+esp_err_t adc1_config_channel_atten(adc1_channel_t channel, adc_atten_t atten);
+
+int adc1_get_raw(adc1_channel_t channel);
+
+#endif /* HOST_DRIVER_ADC_H_ */
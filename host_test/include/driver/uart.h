@@ -0,0 +1,15 @@
+/*
+ * uart.h
+ *
+ * The console UART of the host collects the written bytes, see
+ * host_uart_take().
+ */
+
+#ifndef HOST_DRIVER_UART_H_
+#define HOST_DRIVER_UART_H_
+
+#include <stddef.h>
+
+int uart_write_bytes(int port, const void *src, size_t size);
+
+#endif /* HOST_DRIVER_UART_H_ */
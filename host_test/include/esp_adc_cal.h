@@ -0,0 +1,33 @@
+/*
+ * esp_adc_cal.h
+ *
+ * Linear characterization of an ideal ADC, full scale at each attenuation
+ * of the ESP32 data sheet.
+ */
+
+#ifndef HOST_ESP_ADC_CAL_H_
+#define HOST_ESP_ADC_CAL_H_
+
+#include <stdint.h>
+#include "driver/adc.h"
+
+typedef enum {
+	ESP_ADC_CAL_VAL_EFUSE_VREF=0,
+	ESP_ADC_CAL_VAL_EFUSE_TP,
+	ESP_ADC_CAL_VAL_DEFAULT_VREF,
+	ESP_ADC_CAL_VAL_EFUSE_TP_FIT,
+	ESP_ADC_CAL_VAL_MAX
+} esp_adc_cal_value_t;
+
+typedef struct {
+	adc_atten_t atten;
+	uint32_t vref;
+	uint32_t full_scale_mv;
+} esp_adc_cal_characteristics_t;
+
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t unit, adc_atten_t atten, adc_bits_width_t width,
+											 uint32_t default_vref, esp_adc_cal_characteristics_t *chars);
+
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t raw, const esp_adc_cal_characteristics_t *chars);
+
+#endif /* HOST_ESP_ADC_CAL_H_ */
@@ -0,0 +1,11 @@
+/*
+ * esp_attr.h
+ */
+
+#ifndef HOST_ESP_ATTR_H_
+#define HOST_ESP_ATTR_H_
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#endif /* HOST_ESP_ATTR_H_ */
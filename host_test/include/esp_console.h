@@ -0,0 +1,33 @@
+/*
+ * esp_console.h
+ *
+ * Command registry of the host, a test runs a command line with
+ * esp_console_run().
+ */
+
+#ifndef HOST_ESP_CONSOLE_H_
+#define HOST_ESP_CONSOLE_H_
+
+#include "esp_err.h"
+
+typedef int (*esp_console_cmd_func_t)(int argc, char **argv);
+
+typedef struct {
+	const char *command;
+	const char *help;
+	const char *hint;
+	esp_console_cmd_func_t func;
+	void *argtable;
+} esp_console_cmd_t;
+
+esp_err_t esp_console_cmd_register(const esp_console_cmd_t *cmd);
+
+/**
+ * @brief splits cmdline at the spaces and calls the command of the first word
+ * @param ret the return value of the command
+ * @return ESP_ERR_INVALID_ARG for an empty line, ESP_ERR_NOT_FOUND for an
+ * 		   unknown command
+ */
+esp_err_t esp_console_run(const char *cmdline, int *ret);
+
+#endif /* HOST_ESP_CONSOLE_H_ */
@@ -0,0 +1,20 @@
+/*
+ * esp_cpu.h
+ *
+ * The host has no cycle counter of a fixed rate, a "cycle" is 1 ns of the
+ * monotonic clock.
+ */
+
+#ifndef HOST_ESP_CPU_H_
+#define HOST_ESP_CPU_H_
+
+#include <stdint.h>
+#include <time.h>
+
+static inline uint32_t esp_cpu_get_ccount() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t) ((uint64_t) ts.tv_sec*1000000000u+ts.tv_nsec);
+}
+
+#endif /* HOST_ESP_CPU_H_ */
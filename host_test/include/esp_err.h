@@ -0,0 +1,32 @@
+/*
+ * esp_err.h
+ */
+
+#ifndef HOST_ESP_ERR_H_
+#define HOST_ESP_ERR_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK (0)
+#define ESP_FAIL (-1)
+#define ESP_ERR_NO_MEM (0x101)
+#define ESP_ERR_INVALID_ARG (0x102)
+#define ESP_ERR_INVALID_STATE (0x103)
+#define ESP_ERR_NOT_FOUND (0x105)
+
+static inline const char *esp_err_to_name(esp_err_t err) {
+	return err==ESP_OK ? "ESP_OK" : "ESP_ERR";
+}
+
+#define ESP_ERROR_CHECK(x) do { \
+	esp_err_t err_=(x); \
+	if (err_!=ESP_OK) { \
+		fprintf(stderr, "%s:%d: %s failed: 0x%x\n", __FILE__, __LINE__, #x, err_); \
+		abort(); \
+	} \
+} while (0)
+
+#endif /* HOST_ESP_ERR_H_ */
@@ -0,0 +1,19 @@
+/*
+ * esp_heap_caps.h
+ */
+
+#ifndef HOST_ESP_HEAP_CAPS_H_
+#define HOST_ESP_HEAP_CAPS_H_
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT (1<<2)
+#define MALLOC_CAP_SPIRAM (1<<10)
+#define MALLOC_CAP_INTERNAL (1<<11)
+
+static inline void *heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+	(void) caps;
+	return calloc(n, size);
+}
+
+#endif /* HOST_ESP_HEAP_CAPS_H_ */
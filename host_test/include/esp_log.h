@@ -0,0 +1,30 @@
+/*
+ * esp_log.h
+ *
+ * Errors and warnings go to stderr, the rest is dropped.
+ */
+
+#ifndef HOST_ESP_LOG_H_
+#define HOST_ESP_LOG_H_
+
+#include <stdio.h>
+
+typedef enum {
+	ESP_LOG_NONE,
+	ESP_LOG_ERROR,
+	ESP_LOG_WARN,
+	ESP_LOG_INFO,
+	ESP_LOG_DEBUG,
+	ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+static inline void esp_log_level_set(const char *tag, esp_log_level_t level) {
+	(void) tag; (void) level;
+}
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) do { (void) (tag); } while (0)
+#define ESP_LOGD(tag, fmt, ...) do { (void) (tag); } while (0)
+
+#endif /* HOST_ESP_LOG_H_ */
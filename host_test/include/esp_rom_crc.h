@@ -0,0 +1,16 @@
+/*
+ * esp_rom_crc.h
+ */
+
+#ifndef HOST_ESP_ROM_CRC_H_
+#define HOST_ESP_ROM_CRC_H_
+
+#include <stdint.h>
+
+/**
+ * @brief CRC-32 of the ROM, crc is the result of the previous block, 0 for
+ * 		  the first
+ */
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif /* HOST_ESP_ROM_CRC_H_ */
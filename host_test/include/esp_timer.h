@@ -0,0 +1,52 @@
+/*
+ * esp_timer.h
+ *
+ * The callbacks run in one dispatch thread of host_rtos.c, ESP_TIMER_ISR
+ * dispatches there as well.
+ */
+
+#ifndef HOST_ESP_TIMER_H_
+#define HOST_ESP_TIMER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "esp_err.h"
+
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef enum {
+	ESP_TIMER_TASK,
+	ESP_TIMER_ISR
+} esp_timer_dispatch_t;
+
+typedef struct {
+	esp_timer_cb_t callback;
+	void *arg;
+	esp_timer_dispatch_t dispatch_method;
+	const char *name;
+	bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+static inline int64_t esp_timer_get_time() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec*1000000+ts.tv_nsec/1000;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *timer);
+
+/**
+ * @return ESP_ERR_INVALID_STATE if the timer is armed
+ */
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+
+/**
+ * @return ESP_ERR_INVALID_STATE if the timer is not armed
+ */
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+
+#endif /* HOST_ESP_TIMER_H_ */
@@ -0,0 +1,37 @@
+/*
+ * FreeRTOS.h
+ *
+ * Types and constants of FreeRTOS on the host, a tick is 1 ms. The tasks,
+ * semaphores and queues are pthreads in host_rtos.c.
+ */
+
+#ifndef HOST_FREERTOS_H_
+#define HOST_FREERTOS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_attr.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE (0)
+#define pdTRUE (1)
+#define pdFAIL (pdFALSE)
+#define pdPASS (pdTRUE)
+#define portMAX_DELAY ((TickType_t) 0xffffffffUL)
+#define portTICK_PERIOD_MS (1)
+#define portNUM_PROCESSORS (2)
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms))
+#define portYIELD_FROM_ISR() do { } while (0)
+//evaluated in the release build too, ad_init() creates its tasks in it
+#define configASSERT(x) do { \
+	if (!(x)) { \
+		fprintf(stderr, "%s:%d: assert %s\n", __FILE__, __LINE__, #x); \
+		abort(); \
+	} \
+} while (0)
+
+#endif /* HOST_FREERTOS_H_ */
@@ -0,0 +1,20 @@
+/*
+ * queue.h
+ */
+
+#ifndef HOST_QUEUE_H_
+#define HOST_QUEUE_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_queue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+
+void vQueueDelete(QueueHandle_t queue);
+
+#endif /* HOST_QUEUE_H_ */
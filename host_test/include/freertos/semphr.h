@@ -0,0 +1,24 @@
+/*
+ * semphr.h
+ *
+ * Mutexes of the host. A task taking a mutex it already holds fails at once
+ * instead of waiting for its timeout.
+ */
+
+#ifndef HOST_SEMPHR_H_
+#define HOST_SEMPHR_H_
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+typedef struct host_mutex *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+
+#endif /* HOST_SEMPHR_H_ */
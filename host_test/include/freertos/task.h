@@ -0,0 +1,56 @@
+/*
+ * task.h
+ *
+ * A created task does not run until a test starts it with host_task_start(),
+ * most tests call the task body functions themselves. A deleted task ends at
+ * its next delay or notification wait.
+ */
+
+#ifndef HOST_TASK_H_
+#define HOST_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef enum {
+	eNoAction,
+	eSetBits,
+	eIncrement,
+	eSetValueWithOverwrite
+} eNotifyAction;
+
+#define tskIDLE_PRIORITY (0)
+#define tskNO_AFFINITY (0x7fffffff)
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+					   UBaseType_t priority, TaskHandle_t *handle);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+								   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+
+void vTaskDelete(TaskHandle_t task);
+
+void vTaskDelay(TickType_t ticks);
+
+void vTaskDelayUntil(TickType_t *last, TickType_t ticks);
+
+TickType_t xTaskGetTickCount();
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken);
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+
+/**
+ * @return 0, the host does not watch the stacks
+ */
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task);
+
+#endif /* HOST_TASK_H_ */
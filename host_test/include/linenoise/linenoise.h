@@ -0,0 +1,10 @@
+/*
+ * linenoise.h
+ *
+ * The host console has no line editing, esp_console_run() takes whole lines.
+ */
+
+#ifndef HOST_LINENOISE_H_
+#define HOST_LINENOISE_H_
+
+#endif /* HOST_LINENOISE_H_ */
@@ -0,0 +1,46 @@
+/*
+ * nvs.h
+ *
+ * In-memory NVS of the host, one namespace of a few keys, see
+ * host_nvs_erase().
+ */
+
+#ifndef HOST_NVS_H_
+#define HOST_NVS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define NVS_KEY_NAME_MAX_SIZE (16)
+
+#define ESP_ERR_NVS_BASE (0x1100)
+#define ESP_ERR_NVS_NOT_FOUND (ESP_ERR_NVS_BASE+0x02)
+#define ESP_ERR_NVS_INVALID_LENGTH (ESP_ERR_NVS_BASE+0x0c)
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+	NVS_READONLY,
+	NVS_READWRITE
+} nvs_open_mode_t;
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *handle);
+
+/**
+ * @param value NULL stores the length of the blob in *len, else *len must be
+ * 		  at least the length of the blob
+ */
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *value, size_t *len);
+
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char *key, uint16_t *value);
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t len);
+
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char *key, uint16_t value);
+
+esp_err_t nvs_commit(nvs_handle_t handle);
+
+void nvs_close(nvs_handle_t handle);
+
+#endif /* HOST_NVS_H_ */
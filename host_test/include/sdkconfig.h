@@ -0,0 +1,79 @@
+/*
+ * sdkconfig.h
+ *
+ * Configuration of the host build, the defaults of main/Kconfig.projbuild.
+ * It is force included into every file like the generated one of ESP-IDF.
+ * The acquisition mode is chosen per target, see CMakeLists.txt.
+ */
+
+#ifndef HOST_SDKCONFIG_H_
+#define HOST_SDKCONFIG_H_
+
+#define CONFIG_AD_CHANNEL_COUNT 8
+#define CONFIG_AD_AVG_MAX_WINDOW 1024
+#define CONFIG_AD_MEDIAN_MAX_WINDOW 255
+#define CONFIG_AD_HYST_NOISE_K 30
+#define CONFIG_AD_HYST_NOISE_SHIFT 6
+#define CONFIG_AD_HYST_MIN_DELTA 2
+#define CONFIG_AD_HYST_MAX_DELTA 50
+#define CONFIG_AD_RING_SIZE 16
+#define CONFIG_AD_HISTORY_SIZE 512
+#define CONFIG_AD_STREAM_PERIOD_MS 20
+#define CONFIG_AD_STREAM_MAX_SAMPLES 128
+#define CONFIG_AD_DEFAULT_VREF_MV 1100
+#define CONFIG_AD_LOG_RING_SIZE 128
+#define CONFIG_AD_LOG_RATE 20
+#define CONFIG_AD_ALARM_MAX 16
+#define CONFIG_AD_TASK_PRIORITY 10
+#define CONFIG_AD_TASK_CORE 1
+#define CONFIG_AD_PROC_CORE 0
+#define CONFIG_AD_TIMER_LEAD_US 0
+#define CONFIG_AD_CONV_FREQ_HZ 20000
+#define CONFIG_AD_FRAME_SCANS 32
+#define CONFIG_AD_SAMPLE_PERIOD_US 100000
+#define CONFIG_AD_ADAPTIVE_QUIET_MS 10000
+#define CONFIG_AD_ADAPTIVE_MAX_SHIFT 6
+#define CONFIG_AD_AVG_WINDOW 10
+#define CONFIG_AD_CH0_PIN 7
+#define CONFIG_AD_CH0_ATTEN 2
+#define CONFIG_AD_CH0_PERIOD_US 100000
+#define CONFIG_AD_CH0_AVG_WINDOW 10
+#define CONFIG_AD_CH0_MEDIAN 0
+#define CONFIG_AD_CH1_PIN 6
+#define CONFIG_AD_CH1_ATTEN 2
+#define CONFIG_AD_CH1_PERIOD_US 100000
+#define CONFIG_AD_CH1_AVG_WINDOW 10
+#define CONFIG_AD_CH1_MEDIAN 0
+#define CONFIG_AD_CH2_PIN 5
+#define CONFIG_AD_CH2_ATTEN 2
+#define CONFIG_AD_CH2_PERIOD_US 100000
+#define CONFIG_AD_CH2_AVG_WINDOW 10
+#define CONFIG_AD_CH2_MEDIAN 0
+#define CONFIG_AD_CH3_PIN 4
+#define CONFIG_AD_CH3_ATTEN 2
+#define CONFIG_AD_CH3_PERIOD_US 100000
+#define CONFIG_AD_CH3_AVG_WINDOW 10
+#define CONFIG_AD_CH3_MEDIAN 0
+#define CONFIG_AD_CH4_PIN 3
+#define CONFIG_AD_CH4_ATTEN 2
+#define CONFIG_AD_CH4_PERIOD_US 100000
+#define CONFIG_AD_CH4_AVG_WINDOW 10
+#define CONFIG_AD_CH4_MEDIAN 0
+#define CONFIG_AD_CH5_PIN 2
+#define CONFIG_AD_CH5_ATTEN 2
+#define CONFIG_AD_CH5_PERIOD_US 100000
+#define CONFIG_AD_CH5_AVG_WINDOW 10
+#define CONFIG_AD_CH5_MEDIAN 0
+#define CONFIG_AD_CH6_PIN 1
+#define CONFIG_AD_CH6_ATTEN 2
+#define CONFIG_AD_CH6_PERIOD_US 100000
+#define CONFIG_AD_CH6_AVG_WINDOW 10
+#define CONFIG_AD_CH6_MEDIAN 0
+#define CONFIG_AD_CH7_PIN 0
+#define CONFIG_AD_CH7_ATTEN 2
+#define CONFIG_AD_CH7_PERIOD_US 100000
+#define CONFIG_AD_CH7_AVG_WINDOW 10
+#define CONFIG_AD_CH7_MEDIAN 0
+#define CONFIG_ESP_CONSOLE_UART_NUM 0
+
+#endif /* HOST_SDKCONFIG_H_ */
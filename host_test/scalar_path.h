@@ -0,0 +1,131 @@
+/*
+ * scalar_path.h
+ *
+ * The per-channel hysteresis and average of ad.c before ad_kernel, kept as
+ * the reference of the kernel and the baseline of its benchmark. The state
+ * of a channel is interleaved with the rest of the channel as in the old
+ * ad_struct, a channel is checked on every call. The band centre is the
+ * middle of the clipped band, so the kernel matches it away from 0 and
+ * AD_KERNEL_MAX only.
+ */
+
+#ifndef HOST_SCALAR_PATH_H_
+#define HOST_SCALAR_PATH_H_
+
+#include <stdint.h>
+#include "ad_kernel.h"
+
+#define SCALAR_NOISE_K_SCALE (CONFIG_AD_HYST_NOISE_K*908/10)
+#define SCALAR_NOISE_TO_DELTA(noise) \
+	((((noise)>>6)*SCALAR_NOISE_K_SCALE)>>(AD_KERNEL_NOISE_Q-6+10))
+#define SCALAR_MIN_DELTA (CONFIG_AD_HYST_MIN_DELTA<<AD_KERNEL_Q)
+#define SCALAR_MAX_DELTA (CONFIG_AD_HYST_MAX_DELTA<<AD_KERNEL_Q)
+#define SCALAR_MIN(a,b) ((a)<(b)?(a):(b))
+#define SCALAR_MAX(a,b) ((a)>(b)?(a):(b))
+
+typedef struct {
+	uint16_t hyst_min;
+	uint16_t hyst_max;
+	uint16_t hyst_delta;
+	uint16_t prev;
+	uint32_t noise;
+} scalar_hyst_t;
+
+typedef struct {
+	uint16_t queue[CONFIG_AD_AVG_MAX_WINDOW];
+	uint32_t sum;
+	uint16_t idx;
+	uint16_t window;
+	int8_t shift;
+} scalar_avg_t;
+
+typedef struct {
+	uint8_t running;
+	float calibration[40];		//stands for the calibration points
+	uint16_t raw;
+	scalar_hyst_t hyst;
+	scalar_avg_t avg;
+	uint16_t normalized;
+} scalar_channel_t;
+
+static scalar_channel_t scalar_channel[AD_KERNEL_CHANNELS];
+
+__attribute__((noinline)) static int scalar_check_channel(uint8_t ch) {
+	return ch<AD_KERNEL_CHANNELS;
+}
+
+static inline void scalar_set_hyst(scalar_hyst_t *h, uint16_t centre, uint16_t delta) {
+	h->hyst_delta=delta;
+	h->hyst_min=centre>delta ? centre-delta : 0;
+	h->hyst_max=SCALAR_MIN(AD_KERNEL_MAX, centre+delta);
+}
+
+static inline void scalar_seed(uint8_t ch, uint16_t value) {
+	scalar_hyst_t *h=&scalar_channel[ch].hyst;
+	scalar_set_hyst(h, value, SCALAR_MAX_DELTA);
+	h->prev=value;
+	h->noise=((uint64_t) (SCALAR_MAX_DELTA+1)<<(AD_KERNEL_NOISE_Q+10))/SCALAR_NOISE_K_SCALE;
+}
+
+static inline void scalar_set_window(uint8_t ch, uint16_t window, uint16_t seed) {
+	scalar_avg_t *avg=&scalar_channel[ch].avg;
+	for(uint16_t i=0; i<window; ++i)
+		avg->queue[i]=seed;
+	avg->sum=(uint32_t) seed*window;
+	avg->idx=0;
+	avg->window=window;
+	avg->shift=-1;
+	if (!(window&(window-1)))
+		for(avg->shift=0; (1<<avg->shift)<window; ++avg->shift)
+			;
+}
+
+static inline void scalar_track_noise(uint8_t ch, uint16_t in) {
+	scalar_hyst_t *h=&scalar_channel[ch].hyst;
+	uint32_t diff=(in>h->prev ? in-h->prev : h->prev-in)<<AD_KERNEL_NOISE_Q;
+	h->prev=in;
+	h->noise+=((int32_t) diff-(int32_t) h->noise)>>CONFIG_AD_HYST_NOISE_SHIFT;
+	uint16_t delta=SCALAR_MIN(SCALAR_MAX(SCALAR_NOISE_TO_DELTA(h->noise), SCALAR_MIN_DELTA),
+							  SCALAR_MAX_DELTA);
+	if (delta!=h->hyst_delta)
+		scalar_set_hyst(h, (h->hyst_min+h->hyst_max)>>1, delta);
+}
+
+static uint16_t scalar_get_hyst(uint16_t raw, uint8_t ch) {
+	if (!scalar_check_channel(ch))
+		return 0;
+	scalar_hyst_t *h=&scalar_channel[ch].hyst;
+	if (raw>h->hyst_max) {
+		h->hyst_max=SCALAR_MIN(AD_KERNEL_MAX, h->hyst_max+h->hyst_delta);
+		h->hyst_min=SCALAR_MIN(AD_KERNEL_MAX, h->hyst_min+h->hyst_delta);
+		return h->hyst_max;
+	}
+	if (raw<h->hyst_min) {
+		h->hyst_min=SCALAR_MAX(0, h->hyst_min-h->hyst_delta);
+		h->hyst_max=SCALAR_MAX(0, h->hyst_max-h->hyst_delta);
+		return h->hyst_min;
+	}
+	return raw;
+}
+
+static uint16_t scalar_get_avg(uint16_t input, uint8_t ch) {
+	if (!scalar_check_channel(ch))
+		return 0;
+	scalar_avg_t *avg=&scalar_channel[ch].avg;
+	avg->sum+=input-avg->queue[avg->idx];
+	avg->queue[avg->idx]=input;
+	if (++avg->idx>=avg->window)
+		avg->idx=0;
+	return avg->shift>=0 ? avg->sum>>avg->shift : avg->sum/avg->window;
+}
+
+/**
+ * @brief noise, hysteresis and average of one sample of ch
+ */
+static inline uint16_t scalar_sample(uint8_t ch, uint16_t in) {
+	scalar_track_noise(ch, in);
+	scalar_channel[ch].normalized=scalar_get_avg(scalar_get_hyst(in, ch), ch);
+	return scalar_channel[ch].normalized;
+}
+
+#endif /* HOST_SCALAR_PATH_H_ */
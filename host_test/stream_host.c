@@ -0,0 +1,74 @@
+/*
+ * stream_host.c
+ *
+ * The telemetry stream on the host. A ramp per channel goes into the
+ * history, ad_stream_next frames it and the frames go to stdout, the way
+ * the stream task writes them to the console UART. tools/ad_stream.py
+ * --run decodes them over a pseudo-terminal.
+ *
+ *   ad_stream_host [rounds] [channels] [samples per round]
+ *
+ * Sample i of channel ch is (i+ch*1000)&0xfff, every round stores samples
+ * per channel and sends every frame they fill.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "ad.h"
+#include "ad_history.h"
+#include "ad_stream.h"
+
+static ad_snapshot_t snapshot;
+
+/**
+ * ad.c is not built into this binary, the stream reads the running flags
+ * from here
+ */
+BaseType_t ad_get_all(ad_snapshot_t *s) {
+	*s=snapshot;
+	return pdPASS;
+}
+
+static int write_all(const uint8_t *data, size_t len) {
+	while (len) {
+		ssize_t n=write(STDOUT_FILENO, data, len);
+		if (n<=0)
+			return 0;
+		data+=n;
+		len-=n;
+	}
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	static uint8_t cobs[AD_STREAM_COBS_MAX];
+	long rounds=argc>1 ? atol(argv[1]) : 1000;
+	int channels=argc>2 ? atoi(argv[2]) : 2;
+	int samples=argc>3 ? atoi(argv[3]) : 64;
+	if (channels<1 || channels>MAX_CHANNELS || samples<1 || samples>=CONFIG_AD_HISTORY_SIZE) {
+		fprintf(stderr, "usage: %s [rounds] [channels 1..%d] [samples 1..%d]\n",
+				argv[0], MAX_CHANNELS, CONFIG_AD_HISTORY_SIZE-1);
+		return 2;
+	}
+
+	for(int ch=0; ch<channels; ++ch)
+		snapshot.ch[ch].running=1;
+	if (ad_history_init(channels)!=pdPASS || ad_stream_init()!=pdPASS || ad_stream_start()!=pdPASS)
+		return 1;
+
+	uint32_t i=0;
+	for(long r=0; r<rounds; ++r) {
+		for(int k=0; k<samples; ++k, ++i)
+			for(int ch=0; ch<channels; ++ch)
+				ad_history_push(ch, (int64_t) i*1000, 0, (i+ch*1000)&0xfff);
+		for(size_t len; (len=ad_stream_next(cobs)); )
+			if (!write_all(cobs, len))
+				return 1;
+	}
+
+	ad_stream_stats_t stats;
+	ad_stream_get_stats(&stats);
+	fprintf(stderr, "%u samples, %u lost\n", (unsigned) stats.samples, (unsigned) stats.lost);
+	return 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * test.h
+ *
+ * Assertions of the host tests. A failed assertion prints its location and
+ * the test goes on, the exit code of the test program is the failure count.
+ */
+
+#ifndef HOST_TEST_H_
+#define HOST_TEST_H_
+
+#include <stdio.h>
+
+static int test_failures;
+
+#define TEST_ASSERT(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		++test_failures; \
+	} \
+} while (0)
+
+#define TEST_ASSERT_EQUAL(expected, actual) do { \
+	long long e_=(long long) (expected), a_=(long long) (actual); \
+	if (e_!=a_) { \
+		fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, a_, e_); \
+		++test_failures; \
+	} \
+} while (0)
+
+#define RUN_TEST(fn) do { \
+	int before_=test_failures; \
+	fn(); \
+	printf("%s %s\n", test_failures==before_ ? "PASS" : "FAIL", #fn); \
+} while (0)
+
+#define TEST_EXIT() (test_failures ? 1 : 0)
+
+#endif /* HOST_TEST_H_ */
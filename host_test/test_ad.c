@@ -0,0 +1,623 @@
+/*
+ * test_ad.c
+ *
+ * ad.c with the polling sampler, included so the tests reach its static
+ * functions. ad_init() runs once, every test leaves the channels at the
+ * defaults of the channel table.
+ */
+
+#include "ad.c"
+#include "host_port.h"
+#include "test.h"
+
+#define WAKE_SLACK_US (50000)
+#define RUN_TIMEOUT_MS (5000)
+
+bool G_LOG_ON;		//console.c is not built, the deferred log stays off
+
+/**
+ * The ADC of ch reads code from now on
+ */
+static void adc_const(uint8_t ch, uint16_t code) {
+	ad_sim_config_t c={.shape=AD_SIM_NOISE, .low=code, .high=code};
+	TEST_ASSERT(host_adc_set(CHANNELS[ch].pin, &c));
+}
+
+static int run(const char *line) {
+	int ret=-1;
+	TEST_ASSERT_EQUAL(ESP_OK, esp_console_run(line, &ret));
+	return ret;
+}
+
+static void store_blob(const void *blob, size_t len) {
+	ad_hal_store_t store;
+	TEST_ASSERT_EQUAL(ESP_OK, ad_hal_store_open(&store, 1));
+	TEST_ASSERT_EQUAL(ESP_OK, ad_hal_store_set_blob(store, K_CFG, blob, len));
+	ad_hal_store_close(store);
+}
+
+/**
+ * @return length of the stored configuration, 0 if there is none
+ */
+static size_t stored_len() {
+	ad_hal_store_t store;
+	size_t len=0;
+	TEST_ASSERT_EQUAL(ESP_OK, ad_hal_store_open(&store, 0));
+	if (ad_hal_store_get_blob(store, K_CFG, NULL, &len)!=ESP_OK)
+		len=0;
+	ad_hal_store_close(store);
+	return len;
+}
+
+static void reset_defaults() {
+	host_nvs_erase();
+	restore_cfg_from_flash();
+}
+
+static void test_validate_calibration() {
+	calibration_t *cal=&ad_channel[0].calibration;
+	cal->point[0]=(cal_point_t) {.d=100, .t=20};
+	cal->point[1]=(cal_point_t) {.d=900, .t=80};
+	cal->point[2]=(cal_point_t) {.d=500, .t=50};
+	cal->points=3;
+	TEST_ASSERT(validate_calibration(0));
+	TEST_ASSERT_EQUAL(3, cal->points);
+	TEST_ASSERT_EQUAL(500, cal->point[2].d);
+
+	//an invalid calibration falls back to the default two points
+	cal->point[2].d=100;
+	TEST_ASSERT(!validate_calibration(0));
+	TEST_ASSERT_EQUAL(2, cal->points);
+	TEST_ASSERT_EQUAL(DEF_D0, cal->point[0].d);
+	TEST_ASSERT_EQUAL(DEF_D1, cal->point[1].d);
+	TEST_ASSERT_EQUAL(DEF_T1, cal->point[1].t);
+
+	cal->points=1;
+	TEST_ASSERT(!validate_calibration(0));
+	cal->points=CAL_MAX_POINTS+1;
+	TEST_ASSERT(!validate_calibration(0));
+	cal->points=2;
+	cal->point[1].t=MAX_TEMP+1;
+	TEST_ASSERT(!validate_calibration(0));
+	cal->point[0].t=MIN_TEMP-1;
+	TEST_ASSERT(!validate_calibration(0));
+	TEST_ASSERT(validate_calibration(0));
+	TEST_ASSERT(!validate_calibration(MAX_CHANNELS));
+	update_conversion(0);
+}
+
+static void test_cfg_save_load() {
+	reset_defaults();
+	set_avg_window(1, 32, ad_channel[1].filtered);
+	ad_channel[2].osr.shift=3;
+	ad_median_init(&ad_channel[3].median, 5);
+	TEST_ASSERT_EQUAL(pdPASS, save_cfg_to_flash());
+	size_t len=cfg_size(CFG_VERSION, MAX_CHANNELS);
+	TEST_ASSERT_EQUAL(len, stored_len());
+
+	cfg_image_t img;
+	TEST_ASSERT_EQUAL(pdPASS, cfg_load(&img));
+	TEST_ASSERT_EQUAL(32, img.ch[1].window);
+	TEST_ASSERT_EQUAL(3, img.ch[2].osr_shift);
+	TEST_ASSERT_EQUAL(5, img.ch[3].median);
+	TEST_ASSERT_EQUAL(CHANNELS[0].window, img.ch[0].window);
+	TEST_ASSERT(img.crc);
+	TEST_ASSERT(!memcmp(&img, &cfg_stored, len));
+
+	//a save right after the load finds the image unchanged and writes nothing
+	TEST_ASSERT_EQUAL(pdPASS, restore_cfg_from_flash());
+	host_nvs_erase();
+	TEST_ASSERT_EQUAL(pdPASS, save_cfg_to_flash());
+	TEST_ASSERT_EQUAL(0, stored_len());
+
+	//a changed one is written
+	set_avg_window(1, 16, ad_channel[1].filtered);
+	TEST_ASSERT_EQUAL(pdPASS, save_cfg_to_flash());
+	TEST_ASSERT_EQUAL(len, stored_len());
+	TEST_ASSERT_EQUAL(pdPASS, cfg_load(&img));
+	TEST_ASSERT_EQUAL(16, img.ch[1].window);
+	reset_defaults();
+}
+
+static void test_cfg_crc() {
+	static cfg_image_t stored;
+	cfg_image_t img;
+	size_t len=cfg_size(CFG_VERSION, MAX_CHANNELS);
+	reset_defaults();
+	set_avg_window(1, 32, ad_channel[1].filtered);
+	TEST_ASSERT_EQUAL(pdPASS, save_cfg_to_flash());
+	stored=cfg_stored;
+	TEST_ASSERT_EQUAL(stored.crc, esp_rom_crc32_le(0, (const uint8_t *) &stored, len-sizeof(uint32_t)));
+
+	//a flipped bit
+	stored.ch[1].window^=0x100;
+	store_blob(&stored, len);
+	TEST_ASSERT_EQUAL(pdFAIL, cfg_load(&img));
+	TEST_ASSERT_EQUAL(CHANNELS[1].window, img.ch[1].window);
+	TEST_ASSERT_EQUAL(0, img.crc);
+	stored.ch[1].window^=0x100;
+
+	//a cut image, a version from the future
+	store_blob(&stored, len-1);
+	TEST_ASSERT_EQUAL(pdFAIL, cfg_load(&img));
+	stored.version=CFG_VERSION+1;
+	stored.crc=cfg_crc(&stored, len);
+	store_blob(&stored, len);
+	TEST_ASSERT_EQUAL(pdFAIL, cfg_load(&img));
+	TEST_ASSERT_EQUAL(CHANNELS[1].window, img.ch[1].window);
+
+	//a valid image loads again
+	stored.version=CFG_VERSION;
+	stored.crc=cfg_crc(&stored, len);
+	store_blob(&stored, len);
+	TEST_ASSERT_EQUAL(pdPASS, cfg_load(&img));
+	TEST_ASSERT_EQUAL(32, img.ch[1].window);
+	reset_defaults();
+}
+
+static void test_cfg_upgrade_v1() {
+	static struct __attribute__((packed)) {
+		uint8_t version;
+		uint8_t channels;
+		cfg_channel_v1_t ch[MAX_CHANNELS];
+		uint32_t crc;
+	} v1={.version=1, .channels=MAX_CHANNELS};
+	size_t len=cfg_size(1, MAX_CHANNELS);
+	TEST_ASSERT_EQUAL(sizeof(v1), len);
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch)
+		v1.ch[ch]=(cfg_channel_v1_t) {
+			.d0=100+ch, .d1=3000, .t0=15, .t1=85,
+			.window=16, .period_us=5000, .osr_shift=2, .median=3,
+			.filter=AD_FILTER_EMA, .stages=1, .cutoff_hz=10
+		};
+	v1.crc=cfg_crc((const cfg_image_t *) &v1, len);
+	host_nvs_erase();
+	store_blob(&v1, len);
+
+	cfg_image_t img;
+	TEST_ASSERT_EQUAL(pdPASS, cfg_load(&img));
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch) {
+		const cfg_channel_t *c=&img.ch[ch];
+		TEST_ASSERT_EQUAL(2, c->points);
+		//the codes of the calibration are mV from version 3
+		TEST_ASSERT_EQUAL(ad_channel[ch].mv[100+ch], c->point[0].d);
+		TEST_ASSERT_EQUAL(ad_channel[ch].mv[3000], c->point[1].d);
+		TEST_ASSERT_EQUAL(15, c->point[0].t);
+		TEST_ASSERT_EQUAL(85, c->point[1].t);
+		TEST_ASSERT_EQUAL(16, c->window);
+		TEST_ASSERT_EQUAL(5000, c->period_us);
+		TEST_ASSERT_EQUAL(2, c->osr_shift);
+		TEST_ASSERT_EQUAL(3, c->median);
+		TEST_ASSERT_EQUAL(AD_FILTER_EMA, c->filter);
+	}
+	//the upgraded image is not the one in the flash, the next save writes it
+	TEST_ASSERT_EQUAL(0, img.crc);
+	TEST_ASSERT_EQUAL(pdPASS, restore_cfg_from_flash());
+	TEST_ASSERT_EQUAL(pdPASS, save_cfg_to_flash());
+	TEST_ASSERT_EQUAL(cfg_size(CFG_VERSION, MAX_CHANNELS), stored_len());
+	TEST_ASSERT_EQUAL(pdPASS, cfg_load(&img));
+	TEST_ASSERT_EQUAL(ad_channel[1].mv[101], img.ch[1].point[0].d);
+	TEST_ASSERT(img.crc);
+	reset_defaults();
+}
+
+static void test_cfg_upgrade_v2() {
+	static cfg_image_t v2={.version=2, .channels=MAX_CHANNELS};
+	size_t len=cfg_size(2, MAX_CHANNELS);
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch) {
+		cfg_default(ch, &v2.ch[ch]);
+		v2.ch[ch].point[0]=(cal_point_t) {.d=200, .t=20};
+		v2.ch[ch].point[1]=(cal_point_t) {.d=2000, .t=40};
+		v2.ch[ch].point[2]=(cal_point_t) {.d=4000, .t=90};
+		v2.ch[ch].points=3;
+	}
+	v2.crc=cfg_crc(&v2, len);
+	host_nvs_erase();
+	store_blob(&v2, len);
+
+	cfg_image_t img;
+	TEST_ASSERT_EQUAL(pdPASS, cfg_load(&img));
+	TEST_ASSERT_EQUAL(3, img.ch[4].points);
+	TEST_ASSERT_EQUAL(ad_channel[4].mv[200], img.ch[4].point[0].d);
+	TEST_ASSERT_EQUAL(ad_channel[4].mv[2000], img.ch[4].point[1].d);
+	TEST_ASSERT_EQUAL(ad_channel[4].mv[4000], img.ch[4].point[2].d);
+	TEST_ASSERT_EQUAL(0, img.crc);
+
+	//an image of fewer channels keeps them, the others are the defaults
+	static uint8_t two[sizeof(cfg_image_t)];
+	len=cfg_size(CFG_VERSION, 2);
+	cfg_image_t *part=(cfg_image_t *) two;
+	part->version=CFG_VERSION;
+	part->channels=2;
+	for(uint8_t ch=0; ch<2; ++ch) {
+		cfg_default(ch, &part->ch[ch]);
+		part->ch[ch].window=64;
+	}
+	uint32_t crc=cfg_crc(part, len);
+	memcpy(two+len-sizeof(crc), &crc, sizeof(crc));
+	store_blob(two, len);
+	TEST_ASSERT_EQUAL(pdPASS, cfg_load(&img));
+	TEST_ASSERT_EQUAL(64, img.ch[1].window);
+	TEST_ASSERT_EQUAL(CHANNELS[2].window, img.ch[2].window);
+	TEST_ASSERT_EQUAL(0, img.crc);
+	reset_defaults();
+}
+
+static void test_cfg_legacy() {
+	ad_hal_store_t store;
+	host_nvs_erase();
+	TEST_ASSERT_EQUAL(ESP_OK, ad_hal_store_open(&store, 1));
+	TEST_ASSERT_EQUAL(ESP_OK, nvs_set_u16(store, "d00", 200));
+	TEST_ASSERT_EQUAL(ESP_OK, nvs_set_u16(store, "d10", 3500));
+	TEST_ASSERT_EQUAL(ESP_OK, nvs_set_u16(store, "t00", 1250));
+	TEST_ASSERT_EQUAL(ESP_OK, nvs_set_u16(store, "t10", 9000));
+	TEST_ASSERT_EQUAL(ESP_OK, nvs_set_u16(store, "win0", 20));
+	ad_hal_store_close(store);
+
+	//the keys are read although there is no image
+	cfg_image_t img;
+	TEST_ASSERT_EQUAL(pdFAIL, cfg_load(&img));
+	TEST_ASSERT_EQUAL(ad_channel[0].mv[200], img.ch[0].point[0].d);
+	TEST_ASSERT_EQUAL(ad_channel[0].mv[3500], img.ch[0].point[1].d);
+	TEST_ASSERT(fabsf(img.ch[0].point[0].t-12.5f)<1e-3f);
+	TEST_ASSERT(fabsf(img.ch[0].point[1].t-90.0f)<1e-3f);
+	TEST_ASSERT_EQUAL(20, img.ch[0].window);
+	TEST_ASSERT_EQUAL(CHANNELS[1].window, img.ch[1].window);
+	TEST_ASSERT_EQUAL(DEF_D1, img.ch[1].point[1].d);
+
+	//applied, then saved as an image
+	restore_cfg_from_flash();
+	TEST_ASSERT_EQUAL(20, ad_kernel.avg_window[0]);
+	TEST_ASSERT(ad_channel[0].calibration.calibrated);
+	TEST_ASSERT_EQUAL(pdPASS, save_cfg_to_flash());
+	TEST_ASSERT_EQUAL(pdPASS, cfg_load(&img));
+	TEST_ASSERT_EQUAL(20, img.ch[0].window);
+	TEST_ASSERT_EQUAL(ad_channel[0].mv[3500], img.ch[0].point[1].d);
+	reset_defaults();
+}
+
+/**
+ * @return a code whose mV differ from the next code from 1000 on
+ */
+static uint16_t rising_code(const uint16_t *mv) {
+	uint16_t code=1000;
+	while (mv[code+1]==mv[code])
+		++code;
+	return code;
+}
+
+static void test_filter_scan() {
+	ad_struct *a=&ad_channel[0];
+	uint16_t code=rising_code(a->mv);
+	uint16_t raw_q=(code<<MV_Q)+(1<<(MV_Q-1));	//half way to the next code
+	uint16_t v=ad_mv_lookup(a->mv, raw_q);
+	set_avg_window(0, 1, v);
+	ad_kernel_seed(&ad_kernel, 0, v);
+	a->raw_q=raw_q;
+	ad_channel[2].raw_q=raw_q;
+	int64_t ts[MAX_CHANNELS]={[0]=1234, [2]=5678};
+	uint32_t updates=a->updates;
+	uint32_t other=ad_channel[1].updates;
+	uint32_t history=ad_history_count(0);
+	filter_scan(ad_channel, &ad_kernel, 1u<<0|1u<<2, ts, NULL);
+
+	TEST_ASSERT_EQUAL(code+1, a->raw);
+	TEST_ASSERT_EQUAL(Q_ROUND(v), a->raw_mv);
+	//the fraction of the oversampling is carried through the filters
+	TEST_ASSERT_EQUAL(v, a->filtered);
+	TEST_ASSERT(a->filtered>a->mv[code]<<MV_Q && a->filtered<a->mv[code+1]<<MV_Q);
+	TEST_ASSERT_EQUAL(Q_ROUND(v), a->normalized);
+	TEST_ASSERT_EQUAL(ad_conv_lookup(a->calibration.lut, LUT_SIZE, v, MV_Q), a->temperature);
+	TEST_ASSERT_EQUAL(1234, a->timestamp);
+	TEST_ASSERT_EQUAL(updates+1, a->updates);
+	TEST_ASSERT_EQUAL(5678, ad_channel[2].timestamp);
+	TEST_ASSERT_EQUAL(other, ad_channel[1].updates);
+	TEST_ASSERT_EQUAL(history+1, ad_history_count(0));
+
+	ad_value_t pub;
+	read_published(0, &pub);
+	TEST_ASSERT_EQUAL(a->normalized, pub.normalized);
+	TEST_ASSERT_EQUAL(a->temperature, pub.temperature);
+
+	//a scratch copy does not reach the history
+	static ad_struct scratch[MAX_CHANNELS];
+	memcpy(scratch, ad_channel, sizeof(scratch));
+	filter_scan(scratch, &ad_kernel, 1u<<0, ts, NULL);
+	TEST_ASSERT_EQUAL(history+1, ad_history_count(0));
+	TEST_ASSERT_EQUAL(updates+1, a->updates);
+	reset_defaults();
+}
+
+static void test_oversampling() {
+	ad_struct *a=&ad_channel[0];
+	uint16_t code=rising_code(a->mv);
+	ad_sim_config_t c={.shape=AD_SIM_STEPS, .low=code, .high=code+1, .period=1};
+	TEST_ASSERT(host_adc_set(CHANNELS[0].pin, &c));
+
+	//the bursts average code and code+1, the half code is kept up to MV_Q extra bits
+	a->osr.shift=0;
+	TEST_ASSERT_EQUAL(code<<MV_Q, read_burst(0, &a->osr));
+	TEST_ASSERT_EQUAL((code+1)<<MV_Q, read_burst(0, &a->osr));
+	for(uint8_t shift=1; shift<=MAX_OSR_SHIFT; ++shift) {
+		a->osr.shift=shift;
+		TEST_ASSERT_EQUAL((code<<MV_Q)+(1<<(MV_Q-1)), read_burst(0, &a->osr));
+	}
+	TEST_ASSERT_EQUAL(code+1, read_raw(0));
+	a->osr.shift=0;
+	adc_const(0, 0);
+}
+
+static void test_process_scan() {
+	ad_struct *a=&ad_channel[0];
+	uint16_t v=ad_mv_lookup(a->mv, 2000<<MV_Q);
+	set_avg_window(0, 1, v);
+	ad_kernel_seed(&ad_kernel, 0, v);
+	ad_ring_scan_t scan={.mask=1u<<0};
+	scan.raw[0]=2000<<MV_Q;
+	scan.ts[0]=ad_hal_time_us();
+	scan.deadline[0]=scan.ts[0];
+	uint32_t updates=a->updates;
+	process_scan(&scan);
+	TEST_ASSERT_EQUAL(updates+1, a->updates);
+	TEST_ASSERT_EQUAL(2000, a->raw);
+	TEST_ASSERT_EQUAL(Q_ROUND(v), a->normalized);
+
+	ad_snapshot_t snap;
+	TEST_ASSERT_EQUAL(pdPASS, ad_get_all(&snap));
+	TEST_ASSERT_EQUAL(2000, snap.ch[0].raw);
+	TEST_ASSERT_EQUAL(Q_ROUND(v), snap.ch[0].normalized);
+	TEST_ASSERT_EQUAL(a->updates, snap.ch[0].seq);
+	TEST_ASSERT_EQUAL(scan.ts[0], snap.ch[0].timestamp);
+	uint32_t scans=snap.scan;
+
+	//the console holds ad_sem, the burst is counted as skipped
+	a->osr.shift=2;
+	uint32_t skipped=a->stats.skipped;
+	uint32_t timeouts=ad_task_stats.lock_timeouts;
+	TEST_ASSERT(xSemaphoreTake(ad_sem, portMAX_DELAY));
+	process_scan(&scan);
+	xSemaphoreGive(ad_sem);
+	TEST_ASSERT_EQUAL(skipped+4, a->stats.skipped);
+	TEST_ASSERT_EQUAL(timeouts+1, ad_task_stats.lock_timeouts);
+	TEST_ASSERT_EQUAL(updates+1, a->updates);
+	TEST_ASSERT_EQUAL(pdPASS, ad_get_all(&snap));
+	TEST_ASSERT_EQUAL(scans+1, snap.scan);
+	reset_defaults();
+}
+
+static void test_sched_sampled() {
+	ad_sched_t s={.effective_us=1000, .next_due=10000};
+	sched_sampled(&s, 10000);
+	TEST_ASSERT_EQUAL(11000, s.next_due);
+	TEST_ASSERT_EQUAL(0, s.overruns);
+	sched_sampled(&s, 11100);
+	TEST_ASSERT_EQUAL(1100, s.measured_us);
+	TEST_ASSERT_EQUAL(100, s.jitter_max_us);
+	TEST_ASSERT_EQUAL(12000, s.next_due);
+
+	//two slots are missed, the deadline stays on the grid
+	sched_sampled(&s, 14500);
+	TEST_ASSERT_EQUAL(2, s.overruns);
+	TEST_ASSERT_EQUAL(15000, s.next_due);
+	TEST_ASSERT_EQUAL(2400, s.jitter_max_us);
+}
+
+static void test_sched_adapt() {
+	ad_sched_t *s=&ad_channel[0].sched;
+	int64_t t=ad_hal_time_us();
+	set_period(0, 1000);
+	sched_take_restart(t);
+	ad_kernel_seed(&ad_kernel, 0, 1000<<MV_Q);
+
+	//not adaptive, the period stays
+	TEST_ASSERT_EQUAL(0, sched_adapt(0, t));
+	t+=ADAPTIVE_QUIET_US;
+	TEST_ASSERT_EQUAL(0, sched_adapt(0, t));
+	TEST_ASSERT_EQUAL(0, s->backoff);
+
+	//doubles every quiet period up to the max shift
+	s->adaptive=1;
+	t+=ADAPTIVE_QUIET_US/2;
+	TEST_ASSERT_EQUAL(0, sched_adapt(0, t));
+	TEST_ASSERT_EQUAL(0, s->backoff);
+	for(int i=1; i<=CONFIG_AD_ADAPTIVE_MAX_SHIFT+2; ++i) {
+		t+=ADAPTIVE_QUIET_US;
+		TEST_ASSERT_EQUAL(0, sched_adapt(0, t));
+		TEST_ASSERT_EQUAL(i<CONFIG_AD_ADAPTIVE_MAX_SHIFT ? i : CONFIG_AD_ADAPTIVE_MAX_SHIFT, s->backoff);
+	}
+	sched_apply(0, t);
+	TEST_ASSERT_EQUAL(1000<<CONFIG_AD_ADAPTIVE_MAX_SHIFT, s->effective_us);
+	sched_sampled(s, t);
+
+	//the first sample which moves the band falls back at once
+	ad_kernel_seed(&ad_kernel, 0, 2000<<MV_Q);
+	TEST_ASSERT_EQUAL(1, sched_adapt(0, t+10));
+	TEST_ASSERT_EQUAL(0, s->backoff);
+	sched_apply(0, t+10);
+	TEST_ASSERT_EQUAL(1000, s->effective_us);
+	TEST_ASSERT_EQUAL(t+1000, s->next_due);
+	TEST_ASSERT_EQUAL(0, sched_adapt(0, t+20));
+
+	//the backed off period stays within MAX_PERIOD_US
+	set_period(0, MAX_PERIOD_US/2);
+	for(int i=0; i<3; ++i) {
+		t+=ADAPTIVE_QUIET_US;
+		sched_adapt(0, t);
+	}
+	TEST_ASSERT_EQUAL(1, s->backoff);
+	s->adaptive=0;
+	reset_defaults();
+}
+
+static void test_wait_until() {
+	TaskHandle_t task=ad_tsk;
+	ad_tsk=host_task_self();
+
+	//the timer wakes the task at the deadline
+	int64_t deadline=ad_hal_time_us()+20000;
+	wait_until(deadline);
+	int64_t now=ad_hal_time_us();
+	TEST_ASSERT(now>=deadline);
+	TEST_ASSERT(now<deadline+WAKE_SLACK_US);
+
+	//a passed deadline returns at once
+	wait_until(now-1000);
+	TEST_ASSERT(ad_hal_time_us()-now<WAKE_SLACK_US);
+
+	//the console wakes it early
+	sched_request(0);
+	now=ad_hal_time_us();
+	wait_until(now+1000000);
+	TEST_ASSERT(ad_hal_time_us()-now<WAKE_SLACK_US);
+	esp_timer_stop(ad_timer);
+	ulTaskNotifyTake(pdTRUE, 0);
+	sched_restart=0;
+	ad_tsk=task;
+}
+
+static void test_cmd() {
+	TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, esp_console_run("nope", NULL));
+	TEST_ASSERT_EQUAL(1, run("ad"));
+	TEST_ASSERT_EQUAL(1, run("ad --nope"));
+	TEST_ASSERT_EQUAL(1, run("ad --window"));
+	TEST_ASSERT_EQUAL(1, run("ad --window x"));
+	TEST_ASSERT_EQUAL(1, run("ad --window 0"));
+	TEST_ASSERT_EQUAL(0, run("ad --window 8"));
+	TEST_ASSERT_EQUAL(8, ad_kernel.avg_window[0]);
+
+	//the channel sticks for the next commands, a long option can be abbreviated
+	TEST_ASSERT_EQUAL(1, run("ad -l 8"));
+	TEST_ASSERT_EQUAL(0, run("ad --window 8"));
+	TEST_ASSERT_EQUAL(0, run("ad --ch 1"));
+	TEST_ASSERT_EQUAL(0, run("ad -w4"));
+	TEST_ASSERT_EQUAL(4, ad_kernel.avg_window[1]);
+	TEST_ASSERT_EQUAL(8, ad_kernel.avg_window[0]);
+	TEST_ASSERT_EQUAL(1, run("ad -l -1"));
+	TEST_ASSERT_EQUAL(0, run("ad -w 2"));
+	TEST_ASSERT_EQUAL(2, ad_kernel.avg_window[1]);
+	TEST_ASSERT_EQUAL(0, run("ad -l 0"));
+
+	TEST_ASSERT_EQUAL(1, run("ad --period 50"));
+	TEST_ASSERT_EQUAL(0, run("ad --period 2000"));
+	TEST_ASSERT_EQUAL(2000, ad_channel[0].sched.period_us);
+	TEST_ASSERT(sched_restart&1);
+	TEST_ASSERT_EQUAL(1, run("ad --adaptive maybe"));
+	TEST_ASSERT_EQUAL(0, run("ad --adaptive on"));
+	TEST_ASSERT(ad_channel[0].sched.adaptive);
+	TEST_ASSERT_EQUAL(0, run("ad --adaptive off"));
+	TEST_ASSERT(!ad_channel[0].sched.adaptive);
+
+	TEST_ASSERT_EQUAL(1, run("ad --osr 12"));
+	TEST_ASSERT_EQUAL(1, run("ad --osr 512"));
+	TEST_ASSERT_EQUAL(0, run("ad --osr 16"));
+	TEST_ASSERT_EQUAL(4, ad_channel[0].osr.shift);
+	TEST_ASSERT_EQUAL(0, run("ad --osrcost"));
+	TEST_ASSERT_EQUAL(1, run("ad --median 2"));
+	TEST_ASSERT_EQUAL(0, run("ad --median 5"));
+	TEST_ASSERT_EQUAL(5, ad_channel[0].median.window);
+	TEST_ASSERT_EQUAL(1, run("ad --filter fir"));
+	TEST_ASSERT_EQUAL(1, run("ad --filter ema --fc 0"));
+	TEST_ASSERT_EQUAL(0, run("ad --filter ema --fc 1 --stages 2"));
+	TEST_ASSERT_EQUAL(AD_FILTER_EMA, ad_channel[0].iir.type);
+	TEST_ASSERT_EQUAL(2, ad_channel[0].iir.stages);
+
+	TEST_ASSERT_EQUAL(0, run("ad --start"));
+	TEST_ASSERT(ad_channel[0].running && (ad_running&1));
+	TEST_ASSERT_EQUAL(0, run("ad --stop"));
+	TEST_ASSERT(!ad_channel[0].running && !(ad_running&1));
+
+	//a point is captured at the current code and appended
+	adc_const(0, 1500);
+	calibration_t *cal=&ad_channel[0].calibration;
+	TEST_ASSERT_EQUAL(0, run("ad -c --point 2 --temp 50"));
+	TEST_ASSERT_EQUAL(3, cal->points);
+	TEST_ASSERT_EQUAL(ad_channel[0].mv[1500], cal->point[2].d);
+	TEST_ASSERT_EQUAL(0, run("ad -c --point 3 --temp 60"));
+	TEST_ASSERT_EQUAL(3, cal->points);
+	TEST_ASSERT_EQUAL(1, run("ad -c"));
+	TEST_ASSERT_EQUAL(0, run("ad -c --reset"));
+	TEST_ASSERT_EQUAL(2, cal->points);
+	TEST_ASSERT_EQUAL(0, run("ad -c -0 25"));
+	TEST_ASSERT_EQUAL(ad_channel[0].mv[1500], cal->point[0].d);
+	TEST_ASSERT_EQUAL(25, cal->point[0].t);
+	adc_const(0, 0);
+
+	//save, change, restore
+	TEST_ASSERT_EQUAL(0, run("ad --save"));
+	TEST_ASSERT_EQUAL(0, run("ad --window 16"));
+	TEST_ASSERT_EQUAL(0, run("ad --restore"));
+	TEST_ASSERT_EQUAL(8, ad_kernel.avg_window[0]);
+	TEST_ASSERT_EQUAL(4, ad_channel[0].osr.shift);
+	TEST_ASSERT_EQUAL(25, ad_channel[0].calibration.point[0].t);
+
+	TEST_ASSERT_EQUAL(1, run("ad --dump 0"));
+	TEST_ASSERT_EQUAL(0, run("ad --dump 4"));
+	TEST_ASSERT_EQUAL(1, run("ad --bench 0"));
+	TEST_ASSERT_EQUAL(0, run("ad --bench 10"));
+	TEST_ASSERT_EQUAL(1, run("ad --stream maybe"));
+	TEST_ASSERT_EQUAL(0, run("ad --stream stat"));
+	TEST_ASSERT_EQUAL(0, run("ad --stat"));
+	TEST_ASSERT_EQUAL(0, run("ad --stats"));
+	TEST_ASSERT_EQUAL(0, run("ad --timing"));
+	TEST_ASSERT_EQUAL(0, run("ad --alarms"));
+	sched_restart=0;
+	ulTaskNotifyTake(pdTRUE, 0);
+	reset_defaults();
+}
+
+/**
+ * The ADC task itself on channel 0, the value settles on the mV of the code
+ */
+static void test_fn_ad() {
+	adc_const(0, 1200);
+	TEST_ASSERT_EQUAL(0, run("ad --period 1000"));
+	TEST_ASSERT_EQUAL(0, run("ad --start"));
+	TEST_ASSERT(host_task_start(ad_tsk));
+
+	//the earlier tests left updates of their own
+	ad_snapshot_t snap={0};
+	ad_get_all(&snap);
+	uint32_t until=snap.ch[0].seq+500;
+	for(int ms=0; ms<RUN_TIMEOUT_MS && snap.ch[0].seq<until; ms+=10) {
+		vTaskDelay(pdMS_TO_TICKS(10));
+		ad_get_all(&snap);
+	}
+	vTaskDelete(ad_tsk);
+	TEST_ASSERT(snap.ch[0].seq>=until);
+	TEST_ASSERT_EQUAL(1200, ad_channel[0].raw);
+	TEST_ASSERT_EQUAL(ad_channel[0].mv[1200], ad_channel[0].normalized);
+	uint16_t value;
+	TEST_ASSERT_EQUAL(pdPASS, ad_get(&value, 0, 0));
+	TEST_ASSERT_EQUAL(ad_channel[0].mv[1200], value);
+	TEST_ASSERT_EQUAL(pdFAIL, ad_get(&value, 0, 1));
+
+	ad_timing_t t;
+	TEST_ASSERT_EQUAL(pdPASS, ad_get_timing(0, &t));
+	TEST_ASSERT_EQUAL(1000, t.effective_us);
+	TEST_ASSERT(t.measured_us>0);
+	ad_stats_t st;
+	TEST_ASSERT_EQUAL(pdPASS, ad_get_stats(&st));
+	TEST_ASSERT(st.loops>=500);
+	TEST_ASSERT(st.ch[0].conversions>=500);
+	TEST_ASSERT_EQUAL(0, st.ch[1].conversions);
+}
+
+int main() {
+	adc_const(0, 0);
+	TEST_ASSERT_EQUAL(pdPASS, ad_init());
+	RUN_TEST(test_validate_calibration);
+	RUN_TEST(test_cfg_save_load);
+	RUN_TEST(test_cfg_crc);
+	RUN_TEST(test_cfg_upgrade_v1);
+	RUN_TEST(test_cfg_upgrade_v2);
+	RUN_TEST(test_cfg_legacy);
+	RUN_TEST(test_filter_scan);
+	RUN_TEST(test_oversampling);
+	RUN_TEST(test_process_scan);
+	RUN_TEST(test_sched_sampled);
+	RUN_TEST(test_sched_adapt);
+	RUN_TEST(test_wait_until);
+	RUN_TEST(test_cmd);
+	RUN_TEST(test_fn_ad);
+	return TEST_EXIT();
+}
@@ -0,0 +1,115 @@
+/*
+ * test_ad_frame.c
+ *
+ * ad.c with the frame sampler fed by the simulated DMA of ad_dma.c, included
+ * so the tests reach its static functions.
+ */
+
+#include "ad.c"
+#include "host_port.h"
+#include "test.h"
+
+#define RUN_TIMEOUT_MS (5000)
+
+bool G_LOG_ON;		//console.c is not built, the deferred log stays off
+
+static int run(const char *line) {
+	int ret=-1;
+	TEST_ASSERT_EQUAL(ESP_OK, esp_console_run(line, &ret));
+	return ret;
+}
+
+/**
+ * Waits until channel 0 got count more updates
+ */
+static void wait_updates(uint32_t count) {
+	ad_snapshot_t snap={0};
+	ad_get_all(&snap);
+	uint32_t until=snap.ch[0].seq+count;
+	for(int ms=0; ms<RUN_TIMEOUT_MS && (int32_t) (snap.ch[0].seq-until)<0; ms+=10) {
+		vTaskDelay(pdMS_TO_TICKS(10));
+		ad_get_all(&snap);
+	}
+	TEST_ASSERT((int32_t) (snap.ch[0].seq-until)>=0);
+}
+
+static void test_prime() {
+	//ad_init() seeded raw of every channel from the first frame
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch) {
+		TEST_ASSERT(ad_channel[ch].raw>0);
+		TEST_ASSERT_EQUAL(ad_channel[ch].raw<<MV_Q, ad_channel[ch].raw_q);
+	}
+}
+
+static void test_decimate() {
+	ad_osr_t osr={.shift=2};
+	uint16_t out=0;
+	TEST_ASSERT_EQUAL(0, decimate(&osr, 1000, &out));
+	TEST_ASSERT_EQUAL(0, decimate(&osr, 1001, &out));
+	TEST_ASSERT_EQUAL(0, decimate(&osr, 1000, &out));
+	TEST_ASSERT_EQUAL(1, decimate(&osr, 1001, &out));
+	TEST_ASSERT_EQUAL((1000<<MV_Q)+(1<<(MV_Q-1)), out);
+	TEST_ASSERT_EQUAL(0, osr.acc);
+	TEST_ASSERT_EQUAL(0, osr.count);
+
+	//a burst longer than the fraction rounds
+	osr.shift=6;
+	for(int i=0; i<63; ++i)
+		TEST_ASSERT_EQUAL(0, decimate(&osr, 1000+(i&1), &out));
+	TEST_ASSERT_EQUAL(1, decimate(&osr, 1001, &out));
+	TEST_ASSERT_EQUAL((1000<<MV_Q)+(1<<(MV_Q-1)), out);
+}
+
+static void test_sim_cmd() {
+	TEST_ASSERT_EQUAL(1, run("ad --sim bogus"));
+	TEST_ASSERT_EQUAL(1, run("ad --sim steps,1000,1001,1,0,0"));
+	TEST_ASSERT_EQUAL(1, run("ad --sim noise,2000,1000"));
+	TEST_ASSERT_EQUAL(0, run("ad --sim noise,1000,1000,1,1,0"));
+	const ad_sim_config_t *c=ad_dma_sim_get(0);
+	TEST_ASSERT(c!=NULL);
+	TEST_ASSERT(ad_dma_sim_get(MAX_CHANNELS)==NULL);
+	TEST_ASSERT_EQUAL(pdFAIL, ad_dma_sim_config(MAX_CHANNELS, c));
+}
+
+static void test_fn_ad() {
+	ad_struct *a=&ad_channel[0];
+	TEST_ASSERT_EQUAL(0, run("ad --period 1000"));
+	TEST_ASSERT_EQUAL(0, run("ad --start"));
+	TEST_ASSERT(host_task_start(ad_tsk));
+	wait_updates(100);
+	TEST_ASSERT_EQUAL(1000, a->raw);
+	TEST_ASSERT_EQUAL(1000<<MV_Q, a->raw_q);
+	TEST_ASSERT_EQUAL(a->mv[1000], a->normalized);
+
+	//the bursts of the oversampling keep the half code of the steps
+	TEST_ASSERT_EQUAL(0, run("ad --osr 4"));
+	TEST_ASSERT_EQUAL(0, run("ad --sim steps,1000,1001,1,1,0"));
+	//the new config is taken by the next frame
+	wait_updates(200);
+	vTaskDelete(ad_tsk);
+	uint16_t raw_q=(1000<<MV_Q)+(1<<(MV_Q-1));
+	TEST_ASSERT_EQUAL(raw_q, a->raw_q);
+	TEST_ASSERT_EQUAL(1001, a->raw);
+	TEST_ASSERT_EQUAL(ad_mv_lookup(a->mv, raw_q), a->filtered);
+	TEST_ASSERT_EQUAL(Q_ROUND(a->filtered), a->normalized);
+
+	//the stopped channels are converted but not filtered
+	ad_stats_t st;
+	TEST_ASSERT_EQUAL(pdPASS, ad_get_stats(&st));
+	TEST_ASSERT(st.loops>0);
+	TEST_ASSERT(st.ch[0].conversions>=300);
+	TEST_ASSERT(st.ch[1].conversions>0);
+	TEST_ASSERT_EQUAL(0, st.ch[1].updates);
+	ad_timing_t t;
+	TEST_ASSERT_EQUAL(pdPASS, ad_get_timing(0, &t));
+	TEST_ASSERT_EQUAL(1000, t.effective_us);
+}
+
+int main() {
+	TEST_ASSERT_EQUAL(pdPASS, ad_init());
+	RUN_TEST(test_prime);
+	RUN_TEST(test_decimate);
+	RUN_TEST(test_sim_cmd);
+	RUN_TEST(test_fn_ad);
+	return TEST_EXIT();
+}
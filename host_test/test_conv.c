@@ -0,0 +1,172 @@
+/*
+ * test_conv.c
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ad_conv.h"
+#include "test.h"
+
+#define SIZE (4096)
+
+static int32_t lut[SIZE];
+
+static int cmp_point(const void *a, const void *b) {
+	return ((const ad_conv_point_t *) a)->d-((const ad_conv_point_t *) b)->d;
+}
+
+/**
+ * temperature of d in Q AD_CONV_Q, on the segment of the sorted points
+ * that holds d, the first or last one outside them
+ */
+static double reference(const ad_conv_point_t *points, int n, int d) {
+	ad_conv_point_t p[AD_CONV_MAX_POINTS];
+	memcpy(p, points, n*sizeof(ad_conv_point_t));
+	qsort(p, n, sizeof(ad_conv_point_t), cmp_point);
+	int seg=0;
+	while (seg<n-2 && d>=p[seg+1].d)
+		++seg;
+	double tga=((double) p[seg+1].t-p[seg].t)/(p[seg+1].d-p[seg].d);
+	return (p[seg].t+tga*(d-p[seg].d))*(1<<AD_CONV_Q);
+}
+
+static int32_t max_error(const ad_conv_point_t *p, int n) {
+	double worst=0;
+	for(int d=0; d<SIZE; ++d) {
+		double e=fabs(lut[d]-reference(p, n, d));
+		worst=e>worst ? e : worst;
+	}
+	return ceil(worst);
+}
+
+static void test_invalid() {
+	ad_conv_point_t p[AD_CONV_MAX_POINTS+1]={{0, 10}, {100, 20}, {100, 30}};
+	lut[0]=-1;
+	TEST_ASSERT(!ad_conv_build(p, 1, lut, SIZE));
+	TEST_ASSERT(!ad_conv_build(p, 3, lut, SIZE));
+	TEST_ASSERT(!ad_conv_build(p, AD_CONV_MAX_POINTS+1, lut, SIZE));
+	TEST_ASSERT(!ad_conv_build(NULL, 2, lut, SIZE));
+	TEST_ASSERT_EQUAL(-1, lut[0]);
+	TEST_ASSERT(ad_conv_build(p, 2, lut, SIZE));
+}
+
+static void test_two_points() {
+	static const ad_conv_point_t p[]={{0, 10}, {4096, 100}};
+	TEST_ASSERT(ad_conv_build(p, 2, lut, SIZE));
+	TEST_ASSERT_EQUAL(10<<AD_CONV_Q, lut[0]);
+	TEST_ASSERT_EQUAL(55<<AD_CONV_Q, lut[2048]);
+	TEST_ASSERT(max_error(p, 2)<=1);
+	TEST_ASSERT(fabsf(AD_CONV_TO_FLOAT(lut[1024])-32.5f)<1e-4f);
+}
+
+/**
+ * Points in capture order, the segments follow the sorted order and the
+ * outer ones are extended
+ */
+static void test_segments() {
+	static const ad_conv_point_t p[]={{3000, 80}, {1000, 20}, {2000, 50}};
+	TEST_ASSERT(ad_conv_build(p, 3, lut, SIZE));
+	TEST_ASSERT_EQUAL(20<<AD_CONV_Q, lut[1000]);
+	TEST_ASSERT_EQUAL(50<<AD_CONV_Q, lut[2000]);
+	TEST_ASSERT_EQUAL(80<<AD_CONV_Q, lut[3000]);
+	TEST_ASSERT_EQUAL(35<<AD_CONV_Q, lut[1500]);
+	TEST_ASSERT_EQUAL(65<<AD_CONV_Q, lut[2500]);
+	TEST_ASSERT_EQUAL(-10<<AD_CONV_Q, lut[0]);
+	TEST_ASSERT_EQUAL(110<<AD_CONV_Q, lut[4000]);
+	TEST_ASSERT(max_error(p, 3)<=1);
+}
+
+/**
+ * A steep segment leaves the range of the table far out, the entries
+ * saturate there. A point out of the range is rejected.
+ */
+static void test_saturation() {
+	static const ad_conv_point_t p[]={{1000, 0}, {1001, 100}};
+	TEST_ASSERT(ad_conv_build(p, 2, lut, SIZE));
+	TEST_ASSERT_EQUAL(0, lut[1000]);
+	TEST_ASSERT_EQUAL(100<<AD_CONV_Q, lut[1001]);
+	TEST_ASSERT_EQUAL(32700LL<<AD_CONV_Q, lut[1000+327]);
+	TEST_ASSERT_EQUAL(INT32_MAX, lut[1000+328]);
+	TEST_ASSERT_EQUAL(INT32_MAX, lut[SIZE-1]);
+	TEST_ASSERT_EQUAL(-32700LL*(1<<AD_CONV_Q), lut[1000-327]);
+	TEST_ASSERT_EQUAL(INT32_MIN, lut[1000-328]);
+	TEST_ASSERT_EQUAL(INT32_MIN, lut[0]);
+	for(int d=1; d<SIZE; ++d)
+		TEST_ASSERT(lut[d]>=lut[d-1]);
+
+	ad_conv_point_t bad[]={{0, 10}, {100, 40000}};
+	lut[0]=-1;
+	TEST_ASSERT(!ad_conv_build(bad, 2, lut, SIZE));
+	bad[1].t=NAN;
+	TEST_ASSERT(!ad_conv_build(bad, 2, lut, SIZE));
+	TEST_ASSERT_EQUAL(-1, lut[0]);
+}
+
+/**
+ * A value with a fraction falls between its entry and the next one, within
+ * the rounding of the entries and the truncation of the step from the
+ * reference line; the last entry holds past the table, a saturated entry
+ * next to a valid one does not overflow
+ */
+static void test_lookup() {
+	static const ad_conv_point_t p[]={{0, 10}, {1000, 20}, {2000, 60}};
+	TEST_ASSERT(ad_conv_build(p, 3, lut, SIZE));
+	const uint8_t q=4;
+	int32_t worst=0;
+	for(uint32_t x=0; x<(SIZE-1u)<<q; x+=7) {
+		double expected=reference(p, 3, x>>q)+(reference(p, 3, (x>>q)+1)-reference(p, 3, x>>q))
+				*(x&((1<<q)-1))/(1<<q);
+		double e=fabs(ad_conv_lookup(lut, SIZE, x, q)-expected);
+		worst=e>worst ? ceil(e) : worst;
+	}
+	TEST_ASSERT(worst<=2);
+	TEST_ASSERT_EQUAL(lut[1000], ad_conv_lookup(lut, SIZE, 1000<<q, q));
+	TEST_ASSERT_EQUAL(lut[SIZE-1], ad_conv_lookup(lut, SIZE, (SIZE-1)<<q|3, q));
+	TEST_ASSERT_EQUAL(lut[SIZE-1], ad_conv_lookup(lut, SIZE, UINT32_MAX, q));
+	TEST_ASSERT_EQUAL(lut[7], ad_conv_lookup(lut, SIZE, 7, 0));
+
+	static const ad_conv_point_t steep[]={{1000, 0}, {1001, 100}};
+	TEST_ASSERT(ad_conv_build(steep, 2, lut, SIZE));
+	int32_t half=ad_conv_lookup(lut, SIZE, (1000-328)<<q|8, q);
+	TEST_ASSERT(half>INT32_MIN && half<lut[1000-327]);
+	TEST_ASSERT_EQUAL(INT32_MAX, ad_conv_lookup(lut, SIZE, (1000+330)<<q|8, q));
+}
+
+/**
+ * Random calibrations stay within an LSB of the table everywhere, also far
+ * out on the extended segments
+ */
+static void test_accuracy() {
+	ad_conv_point_t p[AD_CONV_MAX_POINTS];
+	srand(1);
+	int32_t worst=0;
+	for(int k=0; k<200; ++k) {
+		int n=2+rand()%(AD_CONV_MAX_POINTS-1);
+		for(int i=0; i<n; ++i) {
+			uint16_t d;
+			int dup;
+			do {
+				d=rand()%SIZE;
+				dup=0;
+				for(int j=0; j<i; ++j)
+					dup|=p[j].d==d;
+			} while (dup);
+			p[i]=(ad_conv_point_t) {.d=d, .t=(rand()%100000)/1000.0f};
+		}
+		TEST_ASSERT(ad_conv_build(p, n, lut, SIZE));
+		int32_t e=max_error(p, n);
+		worst=e>worst ? e : worst;
+	}
+	TEST_ASSERT(worst<=1);
+}
+
+int main() {
+	RUN_TEST(test_invalid);
+	RUN_TEST(test_two_points);
+	RUN_TEST(test_segments);
+	RUN_TEST(test_saturation);
+	RUN_TEST(test_lookup);
+	RUN_TEST(test_accuracy);
+	return TEST_EXIT();
+}
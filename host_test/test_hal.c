@@ -0,0 +1,73 @@
+/*
+ * test_hal.c
+ */
+
+#include <string.h>
+#include "ad_hal.h"
+#include "esp_rom_crc.h"
+#include "host_port.h"
+#include "test.h"
+
+static void test_adc() {
+	TEST_ASSERT_EQUAL(0, ad_hal_adc_read(ADC1_CHANNEL_3));
+	ad_sim_config_t c={.shape=AD_SIM_RAMP, .low=10, .high=40, .rate=10};
+	TEST_ASSERT(host_adc_set(ADC1_CHANNEL_3, &c));
+	TEST_ASSERT_EQUAL(20, ad_hal_adc_read(ADC1_CHANNEL_3));
+	TEST_ASSERT_EQUAL(30, ad_hal_adc_read(ADC1_CHANNEL_3));
+	TEST_ASSERT_EQUAL(0, ad_hal_adc_read(ADC1_CHANNEL_2));
+}
+
+static void test_time() {
+	int64_t t0=ad_hal_time_us();
+	uint32_t c0=ad_hal_cycles();
+	volatile uint32_t x=0;
+	for(int i=0; i<100000; ++i)
+		x+=i;
+	TEST_ASSERT(ad_hal_time_us()>=t0);
+	TEST_ASSERT(ad_hal_cycles()-c0>0);
+}
+
+static void test_store() {
+	static const uint8_t blob[]={1, 2, 3, 0, 5};
+	uint8_t buf[16];
+	size_t len=sizeof(buf);
+	ad_hal_store_t store;
+	host_nvs_erase();
+	TEST_ASSERT_EQUAL(ESP_OK, ad_hal_store_open(&store, 1));
+	TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, ad_hal_store_get_blob(store, "cfg", buf, &len));
+	TEST_ASSERT_EQUAL(ESP_OK, ad_hal_store_set_blob(store, "cfg", blob, sizeof(blob)));
+
+	//NULL queries the length
+	len=0;
+	TEST_ASSERT_EQUAL(ESP_OK, ad_hal_store_get_blob(store, "cfg", NULL, &len));
+	TEST_ASSERT_EQUAL(sizeof(blob), len);
+	len=2;
+	TEST_ASSERT_EQUAL(ESP_ERR_NVS_INVALID_LENGTH, ad_hal_store_get_blob(store, "cfg", buf, &len));
+	len=sizeof(buf);
+	TEST_ASSERT_EQUAL(ESP_OK, ad_hal_store_get_blob(store, "cfg", buf, &len));
+	TEST_ASSERT_EQUAL(sizeof(blob), len);
+	TEST_ASSERT(!memcmp(blob, buf, sizeof(blob)));
+
+	uint16_t value;
+	TEST_ASSERT_EQUAL(ESP_ERR_NVS_INVALID_LENGTH, ad_hal_store_get_u16(store, "cfg", &value));
+	TEST_ASSERT_EQUAL(ESP_OK, nvs_set_u16(store, "v", 0x1234));
+	TEST_ASSERT_EQUAL(ESP_OK, ad_hal_store_get_u16(store, "v", &value));
+	TEST_ASSERT_EQUAL(0x1234, value);
+	ad_hal_store_close(store);
+}
+
+static void test_crc() {
+	static const char check[]="123456789";
+	TEST_ASSERT_EQUAL(0xcbf43926, esp_rom_crc32_le(0, (const uint8_t *) check, 9));
+	//blocks chain through the previous result
+	uint32_t crc=esp_rom_crc32_le(0, (const uint8_t *) check, 4);
+	TEST_ASSERT_EQUAL(0xcbf43926, esp_rom_crc32_le(crc, (const uint8_t *) check+4, 5));
+}
+
+int main() {
+	RUN_TEST(test_adc);
+	RUN_TEST(test_time);
+	RUN_TEST(test_store);
+	RUN_TEST(test_crc);
+	return TEST_EXIT();
+}
@@ -0,0 +1,166 @@
+/*
+ * test_history.c
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include "ad.h"
+#include "ad_history.h"
+#include "test.h"
+
+#define HISTORY_SIZE (CONFIG_AD_HISTORY_SIZE)
+#define PUSHES (500000)
+
+static ad_record_t records[HISTORY_SIZE];
+
+static void test_empty() {
+	TEST_ASSERT(ad_history_init(MAX_CHANNELS+1)==pdFAIL);
+	TEST_ASSERT(ad_history_init(2)==pdPASS);
+	TEST_ASSERT_EQUAL(2*HISTORY_SIZE*sizeof(ad_record_t), ad_history_bytes());
+	TEST_ASSERT_EQUAL(0, ad_history_read(0, records, HISTORY_SIZE));
+	TEST_ASSERT_EQUAL(0, ad_history_count(0));
+	//channels past the initialized ones are ignored
+	ad_history_push(2, 1, 1, 1);
+	TEST_ASSERT_EQUAL(0, ad_history_count(2));
+	TEST_ASSERT_EQUAL(0, ad_history_read(2, records, HISTORY_SIZE));
+}
+
+static void test_order() {
+	ad_history_init(2);
+	for(int i=0; i<10; ++i)
+		ad_history_push(1, 100+i, i, 2*i);
+
+	TEST_ASSERT_EQUAL(0, ad_history_count(0));
+	TEST_ASSERT_EQUAL(10, ad_history_count(1));
+	TEST_ASSERT_EQUAL(10, ad_history_head(1));
+	int n=ad_history_read(1, records, 4);
+	TEST_ASSERT_EQUAL(4, n);
+	for(int i=0; i<n; ++i) {
+		TEST_ASSERT_EQUAL(106+i, records[i].timestamp);
+		TEST_ASSERT_EQUAL(6+i, records[i].raw);
+		TEST_ASSERT_EQUAL(12+2*i, records[i].filtered);
+	}
+}
+
+/**
+ * A full ring keeps the last HISTORY_SIZE records, a reader gives up the
+ * oldest one, its slot is the next to be overwritten
+ */
+static void test_wrap() {
+	ad_history_init(1);
+	uint32_t pushed=3*HISTORY_SIZE+7;
+	for(uint32_t i=0; i<pushed; ++i)
+		ad_history_push(0, i, i, i);
+
+	TEST_ASSERT_EQUAL(HISTORY_SIZE, ad_history_count(0));
+	TEST_ASSERT_EQUAL(HISTORY_SIZE-1, ad_history_read(0, records, HISTORY_SIZE));
+	for(int i=0; i<HISTORY_SIZE-1; ++i)
+		TEST_ASSERT_EQUAL(pushed-HISTORY_SIZE+1+i, records[i].timestamp);
+	TEST_ASSERT_EQUAL(10, ad_history_read(0, records, 10));
+	TEST_ASSERT_EQUAL(pushed-1, records[9].timestamp);
+}
+
+/**
+ * The cursor resumes where the previous read stopped and counts the records
+ * overwritten before they were read
+ */
+static void test_read_from() {
+	ad_history_init(1);
+	uint32_t cursor=0, lost=0;
+	TEST_ASSERT_EQUAL(0, ad_history_read_from(0, &cursor, records, 8, &lost));
+	for(int i=0; i<20; ++i)
+		ad_history_push(0, i, i, i);
+
+	TEST_ASSERT_EQUAL(8, ad_history_read_from(0, &cursor, records, 8, &lost));
+	TEST_ASSERT_EQUAL(7, records[7].raw);
+	TEST_ASSERT_EQUAL(12, ad_history_read_from(0, &cursor, records, 100, &lost));
+	TEST_ASSERT_EQUAL(8, records[0].raw);
+	TEST_ASSERT_EQUAL(20, cursor);
+	TEST_ASSERT_EQUAL(0, lost);
+
+	for(int i=20; i<20+2*HISTORY_SIZE; ++i)
+		ad_history_push(0, i, i, i);
+	int n=ad_history_read_from(0, &cursor, records, HISTORY_SIZE, &lost);
+	//the oldest slot may be under overwrite, it is given up as well
+	TEST_ASSERT_EQUAL(HISTORY_SIZE-1, n);
+	TEST_ASSERT_EQUAL(HISTORY_SIZE+1, lost);
+	TEST_ASSERT_EQUAL(20+HISTORY_SIZE+1, records[0].raw);
+	TEST_ASSERT_EQUAL(20+2*HISTORY_SIZE-1, records[n-1].raw);
+	TEST_ASSERT_EQUAL(ad_history_head(0), cursor);
+
+	//a cursor at the head skips everything stored so far
+	ad_history_push(0, 0, 0, 0);
+	cursor=ad_history_head(0)-1;
+	TEST_ASSERT_EQUAL(1, ad_history_read_from(0, &cursor, records, 8, NULL));
+}
+
+/**
+ * The record keeps the low 32 bits of the time, the signed difference
+ * orders records across the wrap
+ */
+static void test_timestamp() {
+	ad_history_init(1);
+	int64_t t=0x100000000LL-5;
+	ad_history_push(0, t, 0, 0);
+	ad_history_push(0, t+10, 0, 0);
+	TEST_ASSERT_EQUAL(2, ad_history_read(0, records, 2));
+	TEST_ASSERT_EQUAL((uint32_t) t, records[0].timestamp);
+	TEST_ASSERT_EQUAL(5, records[1].timestamp);
+	TEST_ASSERT_EQUAL(10, (int32_t) (records[1].timestamp-records[0].timestamp));
+}
+
+static volatile int pushing;
+
+/**
+ * Every field of record n is derived from n, a torn record mixes two
+ */
+static void *pusher(void *arg) {
+	for(uint32_t n=1; n<=PUSHES; ++n) {
+		ad_history_push(0, n, n, ~n);
+		//a burst longer than the ring, the reader loses records
+		if (!(n%(HISTORY_SIZE+HISTORY_SIZE/2)))
+			sched_yield();
+	}
+	pushing=0;
+	return NULL;
+}
+
+/**
+ * A writer and a reader thread, the reader gets every record whole and in
+ * order or counts it as lost
+ */
+static void test_threads() {
+	pthread_t t;
+	uint32_t cursor=0, lost=0, read=0, last=0, torn=0, backwards=0;
+	ad_history_init(1);
+	pushing=1;
+	pthread_create(&t, NULL, pusher, NULL);
+	int more;
+	do {
+		more=pushing;
+		int n=ad_history_read_from(0, &cursor, records, HISTORY_SIZE, &lost);
+		for(int i=0; i<n; ++i) {
+			torn+=records[i].raw!=(uint16_t) records[i].timestamp || records[i].filtered!=(uint16_t) ~records[i].timestamp;
+			backwards+=records[i].timestamp<=last;
+			last=records[i].timestamp;
+		}
+		read+=n;
+		sched_yield();
+	} while (more || cursor!=ad_history_head(0));
+	pthread_join(t, NULL);
+	printf("%u read, %u lost\n", (unsigned) read, (unsigned) lost);
+	TEST_ASSERT_EQUAL(0, torn);
+	TEST_ASSERT_EQUAL(0, backwards);
+	TEST_ASSERT_EQUAL(PUSHES, read+lost);
+	TEST_ASSERT_EQUAL(PUSHES, last);
+}
+
+int main() {
+	RUN_TEST(test_empty);
+	RUN_TEST(test_order);
+	RUN_TEST(test_wrap);
+	RUN_TEST(test_read_from);
+	RUN_TEST(test_timestamp);
+	RUN_TEST(test_threads);
+	return TEST_EXIT();
+}
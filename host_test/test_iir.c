@@ -0,0 +1,87 @@
+/*
+ * test_iir.c
+ */
+
+#include <math.h>
+#include "ad_iir.h"
+#include "test.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static ad_iir_t f;
+
+static void test_config() {
+	TEST_ASSERT(ad_iir_config(&f, AD_FILTER_NONE, 0, 0, 10, 0));
+	TEST_ASSERT(!ad_iir_config(&f, AD_FILTER_EMA, 0, 1, 10, 0));
+	TEST_ASSERT(!ad_iir_config(&f, AD_FILTER_BIQUAD, AD_IIR_MAX_STAGES+1, 1, 10, 0));
+	TEST_ASSERT(!ad_iir_config(&f, AD_FILTER_BIQUAD, 1, 5, 10, 0));
+	TEST_ASSERT(!ad_iir_config(&f, AD_FILTER_BIQUAD, 1, 0, 10, 0));
+	TEST_ASSERT(!ad_iir_config(&f, AD_FILTER_MAX, 1, 1, 10, 0));
+	TEST_ASSERT(ad_iir_config(&f, AD_FILTER_BIQUAD, AD_IIR_MAX_STAGES, 1, 10, 0));
+}
+
+static void test_none() {
+	ad_iir_config(&f, AD_FILTER_NONE, 0, 0, 10, 0);
+	for(uint16_t x=0; x<4096; x+=511)
+		TEST_ASSERT_EQUAL(x, ad_iir_process(&f, x));
+}
+
+/**
+ * A seeded filter holds a constant input without a transient
+ */
+static void test_seed() {
+	for(int type=AD_FILTER_EMA; type<AD_FILTER_MAX; ++type) {
+		ad_iir_config(&f, type, 2, 1, 100, 1234);
+		for(int i=0; i<1000; ++i)
+			TEST_ASSERT_EQUAL(1234, ad_iir_process(&f, 1234));
+	}
+}
+
+/**
+ * Every type, stage count and cutoff settles exactly on a step
+ */
+static void test_dc_gain() {
+	static const float cutoffs[]={0.1f, 0.3f, 1, 10, 45};
+	for(int type=AD_FILTER_EMA; type<AD_FILTER_MAX; ++type)
+		for(uint8_t stages=1; stages<=AD_IIR_MAX_STAGES; ++stages)
+			for(unsigned c=0; c<sizeof(cutoffs)/sizeof(cutoffs[0]); ++c) {
+				ad_iir_config(&f, type, stages, cutoffs[c], 100, 0);
+				uint16_t y=0;
+				for(int i=0; i<2000000 && y!=3000; ++i)
+					y=ad_iir_process(&f, 3000);
+				for(int i=0; i<10000; ++i)
+					y=ad_iir_process(&f, 3000);
+				if (y!=3000)
+					fprintf(stderr, "%s, %d stages, %f Hz\n", ad_iir_name(type), stages, cutoffs[c]);
+				TEST_ASSERT_EQUAL(3000, y);
+			}
+}
+
+/**
+ * One biquad section is 3 dB down at the cutoff
+ */
+static void test_cutoff() {
+	float fs=1000, fc=20;
+	ad_iir_config(&f, AD_FILTER_BIQUAD, 1, fc, fs, 2000);
+	int lo=4096, hi=0;
+	for(int i=0; i<5000; ++i) {
+		uint16_t y=ad_iir_process(&f, 2000+1000*sin(2*M_PI*fc*i/fs));
+		if (i>=4000) {
+			lo=y<lo ? y : lo;
+			hi=y>hi ? y : hi;
+		}
+	}
+	float gain=(hi-lo)/2000.0f;
+	TEST_ASSERT(fabsf(gain-(float) M_SQRT1_2)<0.02f);
+}
+
+int main() {
+	RUN_TEST(test_config);
+	RUN_TEST(test_none);
+	RUN_TEST(test_seed);
+	RUN_TEST(test_dc_gain);
+	RUN_TEST(test_cutoff);
+	return TEST_EXIT();
+}
@@ -0,0 +1,275 @@
+/*
+ * test_kernel.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ad_kernel.h"
+#include "scalar_path.h"
+#include "test.h"
+
+#define Q(x) ((x)<<AD_KERNEL_Q)
+#define MIN_DELTA Q(CONFIG_AD_HYST_MIN_DELTA)
+#define MAX_DELTA Q(CONFIG_AD_HYST_MAX_DELTA)
+
+static ad_kernel_t k;
+
+static void test_set_window() {
+	TEST_ASSERT(!ad_kernel_set_window(&k, 0, 0, 100));
+	TEST_ASSERT(!ad_kernel_set_window(&k, 0, CONFIG_AD_AVG_MAX_WINDOW+1, 100));
+	TEST_ASSERT(ad_kernel_set_window(&k, 0, CONFIG_AD_AVG_MAX_WINDOW, 100));
+	TEST_ASSERT(ad_kernel_set_window(&k, 0, 16, 100));
+	TEST_ASSERT_EQUAL(4, k.avg_shift[0]);
+	TEST_ASSERT(ad_kernel_set_window(&k, 0, 10, 100));
+	TEST_ASSERT_EQUAL(-1, k.avg_shift[0]);
+	TEST_ASSERT_EQUAL(1000, k.avg_sum[0]);
+}
+
+/**
+ * The output is the mean of the last window inputs, rounded down
+ */
+static void test_avg() {
+	static const uint16_t windows[]={1, 3, 8, 10, 64};
+	for(unsigned w=0; w<sizeof(windows)/sizeof(windows[0]); ++w) {
+		uint16_t window=windows[w];
+		uint16_t hist[256];
+		ad_kernel_set_window(&k, 1, window, 500);
+		for(int i=0; i<256; ++i) {
+			uint16_t in[AD_KERNEL_CHANNELS], out[AD_KERNEL_CHANNELS];
+			in[1]=hist[i]=(i*37)%4096;
+			ad_kernel_avg(&k, 1u<<1, in, out);
+			uint32_t sum=0;
+			for(int j=i-window+1; j<=i; ++j)
+				sum+=j<0 ? 500 : hist[j];
+			TEST_ASSERT_EQUAL(sum/window, out[1]);
+		}
+	}
+}
+
+/**
+ * Inside the band a sample passes through, a step moves the band by delta
+ * per sample and gives its edge until the band contains the input
+ */
+static void test_hyst() {
+	ad_kernel_seed(&k, 2, Q(1000));
+	TEST_ASSERT_EQUAL(Q(1000), ad_kernel_centre(&k, 2));
+	TEST_ASSERT_EQUAL(Q(1000)-MAX_DELTA, k.hyst_min[2]);
+	TEST_ASSERT_EQUAL(Q(1000)+MAX_DELTA, k.hyst_max[2]);
+
+	uint16_t v[AD_KERNEL_CHANNELS];
+	v[2]=Q(1010);
+	ad_kernel_hyst(&k, 1u<<2, v, v);
+	TEST_ASSERT_EQUAL(Q(1010), v[2]);
+	TEST_ASSERT_EQUAL(Q(1000), ad_kernel_centre(&k, 2));
+
+	uint16_t delta=k.hyst_delta[2];
+	v[2]=Q(2000);
+	ad_kernel_hyst(&k, 1u<<2, v, v);
+	TEST_ASSERT_EQUAL(k.hyst_max[2], v[2]);
+	TEST_ASSERT(ad_kernel_centre(&k, 2)>Q(1000));
+	TEST_ASSERT(k.hyst_delta[2]>=delta);
+	for(int i=0; i<1000; ++i) {
+		v[2]=Q(2000);
+		ad_kernel_hyst(&k, 1u<<2, v, v);
+	}
+	TEST_ASSERT_EQUAL(Q(2000), v[2]);
+	TEST_ASSERT(k.hyst_min[2]<=Q(2000) && k.hyst_max[2]>=Q(2000));
+}
+
+/**
+ * The fraction of a sample inside the band passes through, a step of less
+ * than a unit moves the output by the step
+ */
+static void test_fraction() {
+	ad_kernel_seed(&k, 6, Q(1500));
+	ad_kernel_set_window(&k, 6, 1, Q(1500));
+	uint16_t v[AD_KERNEL_CHANNELS];
+	for(int i=0; i<2000; ++i) {
+		v[6]=Q(1500)+(i&1);
+		ad_kernel_hyst(&k, 1u<<6, v, v);
+	}
+	TEST_ASSERT_EQUAL(MIN_DELTA, k.hyst_delta[6]);
+	for(int f=0; f<(1<<AD_KERNEL_Q); ++f) {
+		v[6]=Q(1500)+f;
+		ad_kernel_hyst(&k, 1u<<6, v, v);
+		ad_kernel_avg(&k, 1u<<6, v, v);
+		TEST_ASSERT_EQUAL(Q(1500)+f, v[6]);
+	}
+}
+
+/**
+ * A flat input shrinks delta to the minimum, noise widens it again
+ */
+static void test_noise() {
+	ad_kernel_seed(&k, 3, Q(2000));
+	uint16_t v[AD_KERNEL_CHANNELS];
+	for(int i=0; i<2000; ++i) {
+		v[3]=Q(2000);
+		ad_kernel_hyst(&k, 1u<<3, v, v);
+	}
+	TEST_ASSERT_EQUAL(MIN_DELTA, k.hyst_delta[3]);
+
+	uint32_t seed=1;
+	for(int i=0; i<2000; ++i) {
+		seed=seed*1103515245+12345;
+		v[3]=Q(2000+(int) ((seed>>16)%21)-10);
+		ad_kernel_hyst(&k, 1u<<3, v, v);
+	}
+	TEST_ASSERT(k.hyst_delta[3]>MIN_DELTA);
+	TEST_ASSERT(k.hyst_delta[3]<=MAX_DELTA);
+}
+
+/**
+ * A full scale step keeps the noise estimate in range and saturates delta
+ */
+static void test_full_scale() {
+	ad_kernel_seed(&k, 7, 0);
+	uint16_t v[AD_KERNEL_CHANNELS];
+	for(int i=0; i<200; ++i) {
+		v[7]=i&1 ? AD_KERNEL_MAX : 0;
+		ad_kernel_hyst(&k, 1u<<7, v, v);
+	}
+	TEST_ASSERT_EQUAL(MAX_DELTA, k.hyst_delta[7]);
+	TEST_ASSERT(k.noise[7]<=(uint32_t) AD_KERNEL_MAX<<AD_KERNEL_NOISE_Q);
+}
+
+/**
+ * Next to 0 the band is clipped, a delta change keeps the unclipped centre
+ */
+static void test_clipped_centre() {
+	ad_kernel_seed(&k, 4, Q(10));
+	TEST_ASSERT_EQUAL(0, k.hyst_min[4]);
+	uint16_t v[AD_KERNEL_CHANNELS];
+	for(int i=0; i<2000; ++i) {
+		v[4]=Q(10+(i&1));
+		ad_kernel_hyst(&k, 1u<<4, v, v);
+	}
+	TEST_ASSERT_EQUAL(Q(10), ad_kernel_centre(&k, 4));
+	TEST_ASSERT(v[4]==Q(10) || v[4]==Q(11));
+}
+
+/**
+ * A stage touches the channels of the mask only
+ */
+static void test_mask() {
+	for(uint8_t ch=0; ch<AD_KERNEL_CHANNELS; ++ch) {
+		ad_kernel_seed(&k, ch, Q(100*ch));
+		ad_kernel_set_window(&k, ch, 4, Q(100*ch));
+	}
+	ad_kernel_t before=k;
+	uint16_t v[AD_KERNEL_CHANNELS];
+	for(uint8_t ch=0; ch<AD_KERNEL_CHANNELS; ++ch)
+		v[ch]=Q(4000);
+	ad_kernel_hyst(&k, 1u<<5, v, v);
+	ad_kernel_avg(&k, 1u<<5, v, v);
+	for(uint8_t ch=0; ch<AD_KERNEL_CHANNELS; ++ch) {
+		if (ch==5)
+			continue;
+		TEST_ASSERT_EQUAL(Q(4000), v[ch]);
+		TEST_ASSERT_EQUAL(before.hyst_centre[ch], k.hyst_centre[ch]);
+		TEST_ASSERT_EQUAL(before.avg_sum[ch], k.avg_sum[ch]);
+	}
+	TEST_ASSERT(before.avg_sum[5]!=k.avg_sum[5]);
+}
+
+/**
+ * Input of ch at sample i: a level per channel with steps on the odd
+ * channels and noise growing with the channel, kept off the band clipping
+ */
+static uint16_t reference_input(int i, uint8_t ch) {
+	int level=Q(500+ch*400+(i/5000%2)*300*(ch&1));
+	return level+rand()%(1+Q(ch*8));
+}
+
+static void reference_init(uint16_t seed, uint8_t ch) {
+	uint16_t window=ch&1 ? 16 : 10;
+	ad_kernel_seed(&k, ch, seed);
+	ad_kernel_set_window(&k, ch, window, seed);
+	scalar_seed(ch, seed);
+	scalar_set_window(ch, window, seed);
+}
+
+/**
+ * The kernel gives the output of the per-channel path it replaced on every
+ * sample of every channel
+ */
+static void test_reference() {
+	srand(3);
+	for(uint8_t ch=0; ch<AD_KERNEL_CHANNELS; ++ch)
+		reference_init(reference_input(0, ch), ch);
+
+	const uint32_t all=(1u<<AD_KERNEL_CHANNELS)-1;
+	int bad=0;
+	for(int i=0; i<50000; ++i) {
+		uint16_t v[AD_KERNEL_CHANNELS], expected[AD_KERNEL_CHANNELS];
+		for(uint8_t ch=0; ch<AD_KERNEL_CHANNELS; ++ch) {
+			v[ch]=reference_input(i, ch);
+			expected[ch]=scalar_sample(ch, v[ch]);
+		}
+		ad_kernel_hyst(&k, all, v, v);
+		ad_kernel_avg(&k, all, v, v);
+		bad+=memcmp(expected, v, sizeof(v))!=0;
+	}
+	TEST_ASSERT_EQUAL(0, bad);
+}
+
+/**
+ * Every channel is processed on the scans of its mask bit only, as if the
+ * per-channel path was called for it alone
+ */
+static void test_sparse() {
+	srand(5);
+	for(uint8_t ch=0; ch<AD_KERNEL_CHANNELS; ++ch)
+		reference_init(reference_input(0, ch), ch);
+
+	int bad=0;
+	for(int i=0; i<50000; ++i) {
+		uint32_t mask=rand()&((1u<<AD_KERNEL_CHANNELS)-1);
+		mask&=rand();
+		uint16_t v[AD_KERNEL_CHANNELS], expected[AD_KERNEL_CHANNELS];
+		for(uint8_t ch=0; ch<AD_KERNEL_CHANNELS; ++ch) {
+			v[ch]=reference_input(i, ch);
+			expected[ch]=mask>>ch&1 ? scalar_sample(ch, v[ch]) : v[ch];
+		}
+		ad_kernel_hyst(&k, mask, v, v);
+		ad_kernel_avg(&k, mask, v, v);
+		bad+=memcmp(expected, v, sizeof(v))!=0;
+	}
+	TEST_ASSERT_EQUAL(0, bad);
+}
+
+/**
+ * The bits of the mask, lowest first, each once
+ */
+static void test_for_each() {
+	static const uint32_t masks[]={0, 1, 0x80000000, 0xffffffff, 0xaaaaaaaa, 0x80000001, 0x00010100, 0x12345678};
+	for(unsigned m=0; m<sizeof(masks)/sizeof(masks[0]); ++m) {
+		uint32_t seen=0;
+		int count=0;
+		int last=-1;
+		AD_KERNEL_FOR_EACH(ch, masks[m]) {
+			TEST_ASSERT((int) ch>last);
+			TEST_ASSERT(masks[m]>>ch&1);
+			seen|=1u<<ch;
+			last=ch;
+			++count;
+		}
+		TEST_ASSERT_EQUAL(masks[m], seen);
+		TEST_ASSERT_EQUAL(__builtin_popcount(masks[m]), count);
+	}
+}
+
+int main() {
+	RUN_TEST(test_set_window);
+	RUN_TEST(test_avg);
+	RUN_TEST(test_hyst);
+	RUN_TEST(test_fraction);
+	RUN_TEST(test_noise);
+	RUN_TEST(test_full_scale);
+	RUN_TEST(test_clipped_centre);
+	RUN_TEST(test_mask);
+	RUN_TEST(test_reference);
+	RUN_TEST(test_sparse);
+	RUN_TEST(test_for_each);
+	return TEST_EXIT();
+}
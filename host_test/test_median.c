@@ -0,0 +1,93 @@
+/*
+ * test_median.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ad_median.h"
+#include "test.h"
+
+static ad_median_t m;
+
+static int cmp_u16(const void *a, const void *b) {
+	return *(const uint16_t *) a-*(const uint16_t *) b;
+}
+
+/**
+ * median of the last n samples by sorting them
+ */
+static uint16_t sorted_median(const uint16_t *last, int n) {
+	uint16_t sorted[AD_MEDIAN_MAX_WINDOW];
+	memcpy(sorted, last, n*sizeof(uint16_t));
+	qsort(sorted, n, sizeof(uint16_t), cmp_u16);
+	return n&1 ? sorted[n/2] : (sorted[n/2-1]+sorted[n/2])/2;
+}
+
+static void test_init() {
+	TEST_ASSERT(ad_median_init(&m, 0));
+	TEST_ASSERT(!ad_median_init(&m, AD_MEDIAN_MIN_WINDOW-1));
+	TEST_ASSERT(!ad_median_init(&m, AD_MEDIAN_MAX_WINDOW+1));
+	TEST_ASSERT(ad_median_init(&m, AD_MEDIAN_MIN_WINDOW));
+	TEST_ASSERT(ad_median_init(&m, AD_MEDIAN_MAX_WINDOW));
+}
+
+static void test_off() {
+	ad_median_init(&m, 0);
+	for(uint16_t v=0; v<100; v+=7)
+		TEST_ASSERT_EQUAL(v, ad_median_insert(&m, v));
+}
+
+/**
+ * A spike shorter than half the window never reaches the output, an even
+ * count of samples gives the mean of the two middle ones
+ */
+static void test_window5() {
+	static const uint16_t in[]={10, 20, 4000, 30, 40, 0, 50, 60, 70};
+	static const uint16_t out[]={10, 15, 20, 25, 30, 30, 40, 40, 50};
+	ad_median_init(&m, 5);
+	for(unsigned i=0; i<sizeof(in)/sizeof(in[0]); ++i)
+		TEST_ASSERT_EQUAL(out[i], ad_median_insert(&m, in[i]));
+}
+
+static void test_copy() {
+	ad_median_t copy;
+	ad_median_init(&m, 7);
+	for(uint16_t v=0; v<5; ++v)
+		ad_median_insert(&m, v*10);
+	ad_median_copy(&copy, &m);
+	TEST_ASSERT(copy.heap>=copy.heap_buf && copy.heap<copy.heap_buf+AD_MEDIAN_MAX_WINDOW);
+	TEST_ASSERT_EQUAL(ad_median_insert(&m, 100), ad_median_insert(&copy, 100));
+	ad_median_insert(&copy, 0);
+	TEST_ASSERT_EQUAL(30, ad_median_insert(&m, 30));
+}
+
+/**
+ * Every window against sorting, on 12 bit noise and on a narrow range with
+ * many equal samples
+ */
+static void test_reference() {
+	static uint16_t in[4*AD_MEDIAN_MAX_WINDOW];
+	srand(1);
+	for(int range=4096; range>=8; range/=512) {
+		for(int window=AD_MEDIAN_MIN_WINDOW; window<=AD_MEDIAN_MAX_WINDOW; ++window) {
+			int n=3*window+20;
+			int bad=0;
+			ad_median_init(&m, window);
+			for(int i=0; i<n; ++i) {
+				in[i]=rand()%range;
+				int count=i+1<window ? i+1 : window;
+				bad+=ad_median_insert(&m, in[i])!=sorted_median(in+i+1-count, count);
+			}
+			TEST_ASSERT_EQUAL(0, bad);
+		}
+	}
+}
+
+int main() {
+	RUN_TEST(test_init);
+	RUN_TEST(test_off);
+	RUN_TEST(test_window5);
+	RUN_TEST(test_copy);
+	RUN_TEST(test_reference);
+	return TEST_EXIT();
+}
@@ -0,0 +1,92 @@
+/*
+ * test_mv.c
+ */
+
+#include <string.h>
+#include "ad_mv.h"
+#include "test.h"
+
+static uint32_t twice(adc_atten_t atten, uint16_t raw) {
+	return atten==ADC_ATTEN_DB_0 ? 2*raw : 40000u*raw;
+}
+
+/**
+ * Without an injected source the table is the characterization of the chip,
+ * the host port models a linear 0..3100mV at 11dB
+ */
+static void test_default() {
+	TEST_ASSERT(!strcmp("none", ad_mv_source_name(ADC_ATTEN_DB_11)));
+	TEST_ASSERT_EQUAL(0, ad_mv_bytes());
+	const uint16_t *table=ad_mv_table(ADC_ATTEN_DB_11);
+	TEST_ASSERT(table);
+	TEST_ASSERT(!strcmp("default Vref", ad_mv_source_name(ADC_ATTEN_DB_11)));
+	TEST_ASSERT_EQUAL(0, table[0]);
+	TEST_ASSERT_EQUAL(1550, table[2048]);
+	TEST_ASSERT_EQUAL(3100, table[AD_MV_CODES-1]);
+	for(int raw=1; raw<AD_MV_CODES; ++raw)
+		TEST_ASSERT(table[raw]>=table[raw-1]);
+	TEST_ASSERT(table==ad_mv_table(ADC_ATTEN_DB_11));
+	TEST_ASSERT_EQUAL(AD_MV_CODES*sizeof(uint16_t), ad_mv_bytes());
+}
+
+/**
+ * An injected source builds the tables made after it, large values saturate
+ */
+static void test_injected() {
+	ad_mv_set_source(twice);
+	const uint16_t *table=ad_mv_table(ADC_ATTEN_DB_0);
+	TEST_ASSERT(table);
+	TEST_ASSERT(!strcmp("injected", ad_mv_source_name(ADC_ATTEN_DB_0)));
+	TEST_ASSERT_EQUAL(2*4095, table[AD_MV_CODES-1]);
+	TEST_ASSERT_EQUAL(2*1234, table[1234]);
+
+	table=ad_mv_table(ADC_ATTEN_DB_2_5);
+	TEST_ASSERT_EQUAL(40000, table[1]);
+	TEST_ASSERT_EQUAL(UINT16_MAX, table[2]);
+	TEST_ASSERT_EQUAL(3*AD_MV_CODES*sizeof(uint16_t), ad_mv_bytes());
+
+	//a built table is kept
+	TEST_ASSERT(!strcmp("default Vref", ad_mv_source_name(ADC_ATTEN_DB_11)));
+	TEST_ASSERT_EQUAL(3100, ad_mv_table(ADC_ATTEN_DB_11)[AD_MV_CODES-1]);
+	ad_mv_set_source(NULL);
+}
+
+/**
+ * The fraction of a code is interpolated towards the next entry, the last
+ * code stays in range, 4096mV and above saturate
+ */
+static void test_lookup() {
+	const uint16_t *table=ad_mv_table(ADC_ATTEN_DB_0);		//2mV per code, test_injected
+	TEST_ASSERT(table);
+	const int one=1<<AD_MV_Q;
+	TEST_ASSERT_EQUAL(2*1234*one, ad_mv_lookup(table, 1234*one));
+	TEST_ASSERT_EQUAL(2*1234*one+2*(one/4), ad_mv_lookup(table, 1234*one+one/4));
+	for(uint32_t raw=1; raw<2048*one; ++raw)
+		TEST_ASSERT(ad_mv_lookup(table, raw)==ad_mv_lookup(table, raw-1)+2);
+	TEST_ASSERT_EQUAL(UINT16_MAX, ad_mv_lookup(table, 2048*one));
+	TEST_ASSERT_EQUAL(UINT16_MAX, ad_mv_lookup(table, UINT16_MAX));
+
+	//linear 0..3100mV, a step of the fraction is 3100/4095/16mV
+	table=ad_mv_table(ADC_ATTEN_DB_11);
+	TEST_ASSERT_EQUAL(table[AD_MV_CODES-1]*one, ad_mv_lookup(table, UINT16_MAX));
+	TEST_ASSERT_EQUAL(table[100]*one, ad_mv_lookup(table, 100*one));
+	int last=-1;
+	for(uint32_t raw=0; raw<=UINT16_MAX; ++raw) {
+		uint16_t mv=ad_mv_lookup(table, raw);
+		TEST_ASSERT((int) mv>=last);
+		last=mv;
+	}
+}
+
+static void test_invalid() {
+	TEST_ASSERT(!ad_mv_table(ADC_ATTEN_MAX));
+	TEST_ASSERT(!strcmp("none", ad_mv_source_name(ADC_ATTEN_MAX)));
+}
+
+int main() {
+	RUN_TEST(test_default);
+	RUN_TEST(test_injected);
+	RUN_TEST(test_lookup);
+	RUN_TEST(test_invalid);
+	return TEST_EXIT();
+}
@@ -0,0 +1,120 @@
+/*
+ * test_ring.c
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include "ad_ring.h"
+#include "test.h"
+
+#define STRESS_SCANS (200000)
+
+static ad_ring_t ring;
+
+static void make_scan(ad_ring_scan_t *scan, uint32_t n) {
+	memset(scan, 0, sizeof(*scan));
+	scan->mask=n|1;
+	for(int ch=0; ch<AD_RING_CHANNELS; ++ch) {
+		scan->raw[ch]=n+ch;
+		scan->ts[ch]=(int64_t) n<<20|ch;
+		scan->deadline[ch]=-(int64_t) n;
+	}
+}
+
+static int check_scan(const ad_ring_scan_t *scan, uint32_t n) {
+	ad_ring_scan_t expected;
+	make_scan(&expected, n);
+	return !memcmp(scan, &expected, sizeof(expected));
+}
+
+static void test_order() {
+	ad_ring_init(&ring);
+	ad_ring_scan_t scan;
+	TEST_ASSERT(!ad_ring_pop(&ring, &scan));
+	for(uint32_t n=0; n<3; ++n) {
+		make_scan(&scan, n);
+		TEST_ASSERT(ad_ring_push(&ring, &scan));
+	}
+	TEST_ASSERT_EQUAL(3, ad_ring_used(&ring));
+	for(uint32_t n=0; n<3; ++n) {
+		TEST_ASSERT(ad_ring_pop(&ring, &scan));
+		TEST_ASSERT(check_scan(&scan, n));
+	}
+	TEST_ASSERT(!ad_ring_pop(&ring, &scan));
+	TEST_ASSERT_EQUAL(3, ring.max_used);
+}
+
+static void test_full() {
+	ad_ring_init(&ring);
+	ad_ring_scan_t scan;
+	for(uint32_t n=0; n<AD_RING_SIZE+5; ++n) {
+		make_scan(&scan, n);
+		TEST_ASSERT_EQUAL(n<AD_RING_SIZE, ad_ring_push(&ring, &scan));
+	}
+	TEST_ASSERT_EQUAL(5, ring.overflows);
+	TEST_ASSERT_EQUAL(AD_RING_SIZE, ring.max_used);
+	for(uint32_t n=0; n<AD_RING_SIZE; ++n) {
+		TEST_ASSERT(ad_ring_pop(&ring, &scan));
+		TEST_ASSERT(check_scan(&scan, n));
+	}
+}
+
+/**
+ * head and tail run freely, the slots stay in order across their wrap
+ */
+static void test_wrap() {
+	ad_ring_init(&ring);
+	ring.head=ring.tail=UINT32_MAX-2;
+	ad_ring_scan_t scan;
+	for(uint32_t n=0; n<AD_RING_SIZE; ++n) {
+		make_scan(&scan, n);
+		TEST_ASSERT(ad_ring_push(&ring, &scan));
+	}
+	TEST_ASSERT_EQUAL(AD_RING_SIZE, ad_ring_used(&ring));
+	make_scan(&scan, 99);
+	TEST_ASSERT(!ad_ring_push(&ring, &scan));
+	for(uint32_t n=0; n<AD_RING_SIZE; ++n) {
+		TEST_ASSERT(ad_ring_pop(&ring, &scan));
+		TEST_ASSERT(check_scan(&scan, n));
+	}
+}
+
+static void *producer(void *arg) {
+	ad_ring_scan_t scan;
+	for(uint32_t n=0; n<STRESS_SCANS; ++n) {
+		make_scan(&scan, n);
+		while (!ad_ring_push(&ring, &scan))
+			sched_yield();
+	}
+	return NULL;
+}
+
+/**
+ * A producer and a consumer thread, every scan arrives complete and in order
+ */
+static void test_threads() {
+	ad_ring_init(&ring);
+	pthread_t thread;
+	pthread_create(&thread, NULL, producer, NULL);
+	ad_ring_scan_t scan;
+	uint32_t bad=0;
+	for(uint32_t n=0; n<STRESS_SCANS; ) {
+		if (!ad_ring_pop(&ring, &scan)) {
+			sched_yield();
+			continue;
+		}
+		bad+=!check_scan(&scan, n++);
+	}
+	pthread_join(thread, NULL);
+	TEST_ASSERT_EQUAL(0, bad);
+	TEST_ASSERT_EQUAL(0, ad_ring_used(&ring));
+}
+
+int main() {
+	RUN_TEST(test_order);
+	RUN_TEST(test_full);
+	RUN_TEST(test_wrap);
+	RUN_TEST(test_threads);
+	return TEST_EXIT();
+}
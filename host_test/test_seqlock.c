@@ -0,0 +1,123 @@
+/*
+ * test_seqlock.c
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include "ad_seqlock.h"
+#include "test.h"
+
+#define WRITES (200000)
+#define READERS (4)
+#define WORDS (16)
+
+/**
+ * Every word of a value is the number of its write, a torn copy mixes two
+ */
+typedef struct {
+	uint32_t word[WORDS];
+} value_t;
+
+static uint32_t seq;
+static value_t buf[2];
+static volatile int writing;
+
+typedef struct {
+	uint32_t reads;
+	uint32_t copies;
+	uint32_t retries;
+	uint32_t torn;
+	uint32_t backwards;		//older than a value read before
+	uint32_t last;
+} reader_t;
+
+static void *writer(void *arg) {
+	for(uint32_t n=1; n<=WRITES; ++n) {
+		value_t *v=&buf[ad_seqlock_write_begin(&seq)];
+		for(int i=0; i<WORDS; ++i) {
+			v->word[i]=n;
+			//a preempted writer, readers land in the middle of the copy
+			if (i==WORDS/2 && !(n&63))
+				sched_yield();
+		}
+		ad_seqlock_write_end(&seq);
+	}
+	writing=0;
+	return NULL;
+}
+
+static void *reader(void *arg) {
+	reader_t *r=arg;
+	value_t v;
+	int more;
+	do {
+		more=writing;
+		uint32_t s;
+		int tries=0;
+		do {
+			s=ad_seqlock_read_begin(&seq);
+			for(int i=0; i<WORDS; ++i) {
+				v.word[i]=buf[s&1].word[i];
+				//a preempted reader, the writer overwrites the buffer
+				if (i==WORDS/2 && !(++r->copies&7))
+					sched_yield();
+			}
+			++tries;
+		} while (ad_seqlock_read_retry(&seq, s));
+		r->retries+=tries-1;
+		++r->reads;
+		for(int i=1; i<WORDS; ++i)
+			if (v.word[i]!=v.word[0]) {
+				++r->torn;
+				break;
+			}
+		r->backwards+=v.word[0]<r->last;
+		r->last=v.word[0];
+		TEST_ASSERT_EQUAL(s, v.word[0]);
+	} while (more);
+	return NULL;
+}
+
+/**
+ * Readers never see a value mixed of two writes or older than one they saw,
+ * the writer never waits for them and the last write is read
+ */
+static void test_stress() {
+	static reader_t readers[READERS];
+	pthread_t threads[READERS+1];
+	writing=1;
+	for(int i=0; i<READERS; ++i)
+		pthread_create(&threads[i], NULL, reader, &readers[i]);
+	pthread_create(&threads[READERS], NULL, writer, NULL);
+	for(int i=0; i<=READERS; ++i)
+		pthread_join(threads[i], NULL);
+
+	uint32_t reads=0, retries=0;
+	for(int i=0; i<READERS; ++i) {
+		TEST_ASSERT_EQUAL(0, readers[i].torn);
+		TEST_ASSERT_EQUAL(0, readers[i].backwards);
+		TEST_ASSERT_EQUAL(WRITES, readers[i].last);
+		reads+=readers[i].reads;
+		retries+=readers[i].retries;
+	}
+	TEST_ASSERT_EQUAL(WRITES, seq);
+	//the readers ran into writes, else the test proved nothing
+	TEST_ASSERT(retries>0);
+	printf("%u reads, %u retries\n", (unsigned) reads, (unsigned) retries);
+}
+
+static void test_empty() {
+	uint32_t s=0;
+	TEST_ASSERT_EQUAL(0, ad_seqlock_read_begin(&s));
+	TEST_ASSERT_EQUAL(1, ad_seqlock_write_begin(&s));
+	ad_seqlock_write_end(&s);
+	TEST_ASSERT_EQUAL(1, ad_seqlock_read_begin(&s));
+	TEST_ASSERT(!ad_seqlock_read_retry(&s, 1));
+	TEST_ASSERT_EQUAL(0, ad_seqlock_write_begin(&s));
+}
+
+int main() {
+	RUN_TEST(test_empty);
+	RUN_TEST(test_stress);
+	return TEST_EXIT();
+}
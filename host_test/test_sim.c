@@ -0,0 +1,94 @@
+/*
+ * test_sim.c
+ */
+
+#include <string.h>
+#include "ad_sim.h"
+#include "test.h"
+
+static ad_sim_t sim;
+
+static void test_init() {
+	ad_sim_config_t c={.shape=AD_SIM_TRIANGLE, .low=100, .high=200, .rate=10};
+	TEST_ASSERT(ad_sim_init(&sim, &c, 1));
+	TEST_ASSERT(!ad_sim_init(&sim, &c, 0));
+	TEST_ASSERT(!ad_sim_init(&sim, NULL, 1));
+	c.low=300;
+	TEST_ASSERT(!ad_sim_init(&sim, &c, 1));
+	c.low=100;
+	c.high=AD_SIM_CODES;
+	TEST_ASSERT(!ad_sim_init(&sim, &c, 1));
+	c.high=200;
+	c.shape=AD_SIM_SHAPE_MAX;
+	TEST_ASSERT(!ad_sim_init(&sim, &c, 1));
+	c.shape=AD_SIM_SPIKES;
+	TEST_ASSERT(!ad_sim_init(&sim, &c, 1));
+	c.period=4;
+	TEST_ASSERT(ad_sim_init(&sim, &c, 1));
+	TEST_ASSERT(!strcmp("spikes", ad_sim_name(AD_SIM_SPIKES)));
+	TEST_ASSERT(!ad_sim_name(AD_SIM_SHAPE_MAX));
+}
+
+static void test_shapes() {
+	ad_sim_config_t c={.shape=AD_SIM_TRIANGLE, .low=100, .high=140, .rate=20};
+	static const uint16_t triangle[]={120, 140, 120, 100, 120};
+	ad_sim_init(&sim, &c, 1);
+	for(int i=0; i<5; ++i)
+		TEST_ASSERT_EQUAL(triangle[i], ad_sim_next(&sim));
+
+	c.shape=AD_SIM_RAMP;
+	static const uint16_t ramp[]={120, 140, 100, 120};
+	ad_sim_init(&sim, &c, 1);
+	for(int i=0; i<4; ++i)
+		TEST_ASSERT_EQUAL(ramp[i], ad_sim_next(&sim));
+
+	c.shape=AD_SIM_SPIKES;
+	c.period=3;
+	static const uint16_t spikes[]={140, 100, 100, 140};
+	ad_sim_init(&sim, &c, 1);
+	for(int i=0; i<4; ++i)
+		TEST_ASSERT_EQUAL(spikes[i], ad_sim_next(&sim));
+
+	c.shape=AD_SIM_STEPS;
+	c.period=2;
+	static const uint16_t steps[]={100, 100, 140, 140, 100};
+	ad_sim_init(&sim, &c, 1);
+	for(int i=0; i<5; ++i)
+		TEST_ASSERT_EQUAL(steps[i], ad_sim_next(&sim));
+
+	c.shape=AD_SIM_NOISE;
+	ad_sim_init(&sim, &c, 1);
+	TEST_ASSERT_EQUAL(120, ad_sim_next(&sim));
+}
+
+/**
+ * The noise stays within its peak to peak and the output is clamped
+ */
+static void test_noise() {
+	ad_sim_config_t c={.shape=AD_SIM_NOISE, .low=2000, .high=2000, .noise=50};
+	ad_sim_init(&sim, &c, 7);
+	uint16_t lo=UINT16_MAX, hi=0;
+	for(int i=0; i<10000; ++i) {
+		uint16_t v=ad_sim_next(&sim);
+		lo=v<lo ? v : lo;
+		hi=v>hi ? v : hi;
+	}
+	TEST_ASSERT(lo>=1975 && lo<1980);
+	TEST_ASSERT(hi<2025 && hi>2020);
+
+	c.low=c.high=0;
+	ad_sim_init(&sim, &c, 7);
+	for(int i=0; i<1000; ++i)
+		TEST_ASSERT(ad_sim_next(&sim)<25);
+	c.low=c.high=AD_SIM_CODES-1;
+	ad_sim_init(&sim, &c, 7);
+	for(int i=0; i<1000; ++i)
+		TEST_ASSERT(ad_sim_next(&sim)<AD_SIM_CODES);
+}
+
+int main() {
+	RUN_TEST(test_init);
+	RUN_TEST(test_shapes);
+	RUN_TEST(test_noise);
+	return TEST_EXIT();
+}
@@ -0,0 +1,215 @@
+/*
+ * test_stream.c
+ */
+
+#include <string.h>
+#include "ad.h"
+#include "ad_history.h"
+#include "ad_stream.h"
+#include "test.h"
+
+#define HEADER_BYTES (8)
+
+static ad_snapshot_t fake;
+
+/**
+ * ad.c is not built on the host, the stream reads the running flags from here
+ */
+BaseType_t ad_get_all(ad_snapshot_t *snapshot) {
+	*snapshot=fake;
+	return pdPASS;
+}
+
+/**
+ * @return decoded length, 0 on a malformed frame
+ */
+static size_t cobs_decode(const uint8_t *src, size_t len, uint8_t *dst) {
+	if (!len || src[len-1])
+		return 0;
+
+	size_t out=0;
+	for(size_t i=0; i<len-1; ) {
+		uint8_t code=src[i++];
+		if (!code || i+code-1>len-1)
+			return 0;
+		for(uint8_t j=1; j<code; ++j) {
+			if (!src[i])
+				return 0;
+			dst[out++]=src[i++];
+		}
+		if (code<0xff && i<len-1)
+			dst[out++]=0;
+	}
+	return out;
+}
+
+static uint16_t crc16(const uint8_t *data, size_t len) {
+	uint16_t crc=0xffff;
+	while (len--) {
+		crc^=(uint16_t) *data++<<8;
+		for(uint8_t i=0; i<8; ++i)
+			crc=crc&0x8000 ? (crc<<1)^0x1021 : crc<<1;
+	}
+	return crc;
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+	return p[0]|p[1]<<8;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+	return get_u16(p)|(uint32_t) get_u16(p+2)<<16;
+}
+
+static uint16_t get_sample(const uint8_t *samples, int i) {
+	const uint8_t *p=samples+i/2*3;
+	return i&1 ? (p[1]>>4)|p[2]<<4 : p[0]|(p[1]&0xf)<<8;
+}
+
+static uint8_t cobs[AD_STREAM_COBS_MAX];
+static uint8_t frame[AD_STREAM_FRAME_MAX];
+
+/**
+ * @return decoded length of the next frame, 0 if none or it is malformed
+ */
+static size_t next_frame() {
+	size_t len=ad_stream_next(cobs);
+	if (!len)
+		return 0;
+
+	TEST_ASSERT(len<=AD_STREAM_COBS_MAX);
+	TEST_ASSERT(!memchr(cobs, 0, len-1));
+	size_t n=cobs_decode(cobs, len, frame);
+	TEST_ASSERT(n>=HEADER_BYTES);
+	TEST_ASSERT_EQUAL(crc16(frame, n-2), get_u16(frame+n-2));
+	return n;
+}
+
+static void start(uint32_t running) {
+	memset(&fake, 0, sizeof(fake));
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch)
+		fake.ch[ch].running=running>>ch&1;
+	TEST_ASSERT(ad_history_init(MAX_CHANNELS)==pdPASS);
+	TEST_ASSERT(ad_stream_start()==pdPASS);
+}
+
+static void test_idle() {
+	start(0);
+	ad_history_push(0, 1, 100, 100);
+	TEST_ASSERT_EQUAL(0, ad_stream_next(cobs));
+	start(1);
+	TEST_ASSERT_EQUAL(0, ad_stream_next(cobs));
+}
+
+static void test_frame() {
+	static const uint16_t ch0[]={0x123, 0xabc, 0xfff};
+	static const uint16_t ch1[]={0, 0xf0f};
+	start(0x03);
+	for(int i=0; i<3; ++i)
+		ad_history_push(0, 1000+i, 0, ch0[i]);
+	for(int i=0; i<2; ++i)
+		ad_history_push(1, 0x100000000LL+2000+i, 0, ch1[i]);
+
+	size_t n=next_frame();
+	TEST_ASSERT_EQUAL(HEADER_BYTES+2+5+2+3+2, n);
+	TEST_ASSERT_EQUAL(AD_STREAM_VERSION, frame[0]);
+	TEST_ASSERT_EQUAL(0, get_u16(frame+1));
+	TEST_ASSERT_EQUAL(2001, get_u32(frame+3));
+	TEST_ASSERT_EQUAL(0x03, frame[7]);
+	const uint8_t *p=frame+HEADER_BYTES;
+	TEST_ASSERT_EQUAL(3, p[0]);
+	TEST_ASSERT_EQUAL(0, p[1]);
+	for(int i=0; i<3; ++i)
+		TEST_ASSERT_EQUAL(ch0[i], get_sample(p+2, i));
+	p+=2+5;
+	TEST_ASSERT_EQUAL(2, p[0]);
+	TEST_ASSERT_EQUAL(0, p[1]);
+	for(int i=0; i<2; ++i)
+		TEST_ASSERT_EQUAL(ch1[i], get_sample(p+2, i));
+
+	TEST_ASSERT_EQUAL(0, ad_stream_next(cobs));
+	ad_history_push(1, 3000, 0, 7);
+	TEST_ASSERT_EQUAL(HEADER_BYTES+2+2+2, next_frame());
+	TEST_ASSERT_EQUAL(1, get_u16(frame+1));
+	TEST_ASSERT_EQUAL(0x02, frame[7]);
+	TEST_ASSERT_EQUAL(7, get_sample(frame+HEADER_BYTES+2, 0));
+
+	ad_stream_stats_t stats;
+	ad_stream_get_stats(&stats);
+	TEST_ASSERT_EQUAL(6, stats.samples);
+	TEST_ASSERT_EQUAL(0, stats.lost);
+}
+
+/**
+ * Samples overwritten in the history before they were sent are counted,
+ * the byte of the frame saturates
+ */
+static void test_lost() {
+	start(0x01);
+	uint32_t pushed=CONFIG_AD_HISTORY_SIZE+1000;
+	for(uint32_t i=0; i<pushed; ++i)
+		ad_history_push(0, i, 0, i&0xfff);
+
+	uint32_t lost=pushed-(CONFIG_AD_HISTORY_SIZE-1);
+	TEST_ASSERT(next_frame());
+	TEST_ASSERT_EQUAL(CONFIG_AD_STREAM_MAX_SAMPLES, frame[HEADER_BYTES]);
+	TEST_ASSERT_EQUAL(lost>0xff ? 0xff : lost, frame[HEADER_BYTES+1]);
+	TEST_ASSERT_EQUAL(lost&0xfff, get_sample(frame+HEADER_BYTES+2, 0));
+
+	uint32_t sent=CONFIG_AD_STREAM_MAX_SAMPLES;
+	while (next_frame()) {
+		TEST_ASSERT_EQUAL(0, frame[HEADER_BYTES+1]);
+		TEST_ASSERT_EQUAL((lost+sent)&0xfff, get_sample(frame+HEADER_BYTES+2, 0));
+		sent+=frame[HEADER_BYTES];
+	}
+	TEST_ASSERT_EQUAL(pushed, lost+sent);
+
+	ad_stream_stats_t stats;
+	ad_stream_get_stats(&stats);
+	TEST_ASSERT_EQUAL(lost, stats.lost);
+	TEST_ASSERT_EQUAL(sent, stats.samples);
+}
+
+/**
+ * Every channel with the max samples fills the frame, runs of more than 254
+ * non-zero bytes need the long COBS blocks
+ */
+static void test_full() {
+	start((1<<MAX_CHANNELS)-1);
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch)
+		for(int i=0; i<CONFIG_AD_STREAM_MAX_SAMPLES; ++i)
+			ad_history_push(ch, i, 0, 0x111*(ch+1));
+
+	TEST_ASSERT_EQUAL(AD_STREAM_FRAME_MAX, next_frame());
+	const uint8_t *p=frame+HEADER_BYTES;
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch) {
+		TEST_ASSERT_EQUAL(CONFIG_AD_STREAM_MAX_SAMPLES, p[0]);
+		TEST_ASSERT_EQUAL(0x111*(ch+1), get_sample(p+2, CONFIG_AD_STREAM_MAX_SAMPLES-1));
+		p+=2+(CONFIG_AD_STREAM_MAX_SAMPLES*3+1)/2;
+	}
+}
+
+/**
+ * A channel that was stopped does not send the samples of the stop
+ */
+static void test_stopped() {
+	start(0x01);
+	fake.ch[0].running=0;
+	ad_history_push(0, 1, 0, 1);
+	TEST_ASSERT_EQUAL(0, ad_stream_next(cobs));
+	fake.ch[0].running=1;
+	ad_history_push(0, 2, 0, 2);
+	TEST_ASSERT_EQUAL(HEADER_BYTES+2+2+2, next_frame());
+	TEST_ASSERT_EQUAL(2, get_sample(frame+HEADER_BYTES+2, 0));
+}
+
+int main() {
+	TEST_ASSERT(ad_stream_init()==pdPASS);
+	TEST_ASSERT_EQUAL(0x29b1, crc16((const uint8_t *) "123456789", 9));
+	RUN_TEST(test_idle);
+	RUN_TEST(test_frame);
+	RUN_TEST(test_lost);
+	RUN_TEST(test_full);
+	RUN_TEST(test_stopped);
+	return TEST_EXIT();
+}
@@ -5,39 +5,68 @@
  *      Author: Ouail
  */
 
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
 #include "driver/adc.h"
 #include "esp_console.h"
 #include "linenoise/linenoise.h"
 #include "argtable3/argtable3.h"
-#include "nvs.h"
-#include "nvs_flash.h"
 
 #include "ad.h"
+#include "ad_dma.h"
+#include "ad_median.h"
+#include "ad_iir.h"
+#include "ad_history.h"
+#include "ad_stream.h"
+#include "ad_log.h"
+#include "ad_alarm.h"
+#include "ad_mv.h"
+#include "ad_hal.h"
+#include "ad_kernel.h"
+#include "ad_ring.h"
+#include "ad_conv.h"
+#include "ad_seqlock.h"
 
 #define ESP_LOG_LOCAL_LEVEL ESP_LOG_DEBUG
 #include "esp_log.h"
 
 #define TAG "ad"
 
-#define MAX_CHANNELS (2)
-
 #define STACK_SIZE 4096
 #define TASK_DELAY_MS 100
 #define MIN_TEMP 0
 #define MAX_TEMP 100
-#define MOVING_AVG_SIZE 10
-#define MOVING_HYST_DELTA 50
-
-#define K_D0 "d0"
-#define K_D1 "d1"
-#define K_T0 "t0"
-#define K_T1 "t1"
-#define K_TGA "tga"
+#define IDLE_WAIT_MS 100
+#define MIN_PERIOD_US 100
+#define MAX_PERIOD_US 60000000
+#define JITTER_AVG_SHIFT 4
+#define ADAPTIVE_QUIET_US ((int64_t) CONFIG_AD_ADAPTIVE_QUIET_MS*1000)
+#define LOCK_WAIT_MS 5
+//a unicore build has core 0 only, pinning to a missing core fails
+#define TASK_CORE (CONFIG_AD_TASK_CORE<0 ? tskNO_AFFINITY \
+		: CONFIG_AD_TASK_CORE<portNUM_PROCESSORS ? CONFIG_AD_TASK_CORE : portNUM_PROCESSORS-1)
+#define PROC_PRIORITY (CONFIG_AD_TASK_PRIORITY>1 ? CONFIG_AD_TASK_PRIORITY-1 : 1)
+#define TEMP_Q (AD_CONV_Q)		//fraction bits of the temperature in the sampler
+#define TEMP_TO_FLOAT(q) AD_CONV_TO_FLOAT(q)
+#define MAX_OSR_SHIFT (8)	//256x
+#define MV_Q (AD_MV_Q)		//fraction bits of raw_q and of the mV in the filters
+#define Q_ROUND(v) (((v)+(1<<(MV_Q-1)))>>MV_Q)
+#define MV_TO_FLOAT(q) ((float) (q)/(1<<MV_Q))
+#define CAL_MAX_POINTS (AD_CONV_MAX_POINTS)
+#define LUT_SIZE (AD_MAX-AD_MIN)
+
+#define K_CFG "cfg"
+#define CFG_VERSION (3)
 #define DEF_D0 (0)
 #define DEF_D1 (4096)
 #define DEF_T0 (10)  //Cannot be float!
@@ -47,15 +76,6 @@
 #error DEF_D1-DEF_D0 is 0!
 #endif
 
-const char *KEYD0[MAX_CHANNELS]={"d00","d01","d02"};
-const char *KEYD1[MAX_CHANNELS]={"d10","d11","d12"};
-const char *KEYT0[MAX_CHANNELS]={"t00","t01","t02"};
-const char *KEYT1[MAX_CHANNELS]={"t10","t11","t12"};
-const char *KEYTGA[MAX_CHANNELS]={"TGA0","TGA1","TGA2"};
-
-
-const float DEF_TGA=((float)(((float)DEF_T1)-((float)DEF_T0))/(((float)DEF_D1)-((float)DEF_D0)));
-
 #if DEF_D1 <= DEF_D0
 #error DEF_D1 is less or equal than DEF_D0
 #endif
@@ -64,58 +84,312 @@ const float DEF_TGA=((float)(((float)DEF_T1)-((float)DEF_T0))/(((float)DEF_D1)-(
 #error DEF_T1 is less or equal than DEF_T0
 #endif
 
-typedef struct {
-	uint16_t hyst_min;
-	uint16_t hyst_max;
-	uint16_t hyst_delta;
-} moving_hyst_t;
+#if CONFIG_AD_AVG_WINDOW > CONFIG_AD_AVG_MAX_WINDOW
+#error CONFIG_AD_AVG_WINDOW is greater than CONFIG_AD_AVG_MAX_WINDOW
+#endif
 
-typedef struct {
-	uint16_t queue[MOVING_AVG_SIZE];
-	uint8_t idx;
-} moving_avg_t;
+#if CONFIG_AD_PIPELINE && CONFIG_AD_TASK_CORE==CONFIG_AD_PROC_CORE
+#error CONFIG_AD_PROC_CORE must differ from CONFIG_AD_TASK_CORE
+#endif
 
-typedef struct {
+#if AD_KERNEL_Q!=AD_MV_Q
+#error the hysteresis and the average run on the mV of ad_mv_lookup
+#endif
+
+//d is mV, raw code before CFG_VERSION 3
+typedef ad_conv_point_t cal_point_t;
+
+/**
+ * Persistent configuration of a channel
+ */
+typedef struct __attribute__((packed)) {
+	uint8_t points;
+	cal_point_t point[CAL_MAX_POINTS];
+	uint16_t window;
+	uint32_t period_us;
+	uint8_t osr_shift;
+	uint8_t median;
+	uint8_t filter;
+	uint8_t stages;
+	float cutoff_hz;
+} cfg_channel_t;
+
+/**
+ * Channel record of CFG_VERSION 1 with the two point calibration
+ */
+typedef struct __attribute__((packed)) {
 	uint16_t d0;
 	uint16_t d1;
 	float t0;
 	float t1;
-	float tga;
+	uint16_t window;
+	uint32_t period_us;
+	uint8_t osr_shift;
+	uint8_t median;
+	uint8_t filter;
+	uint8_t stages;
+	float cutoff_hz;
+} cfg_channel_v1_t;
+
+/**
+ * Image of the configuration in the flash. It is stored with the channels
+ * actually present, so crc follows ch[channels-1] and the crc field is only
+ * in place for MAX_CHANNELS.
+ */
+typedef struct __attribute__((packed)) {
+	uint8_t version;
+	uint8_t channels;
+	cfg_channel_t ch[MAX_CHANNELS];
+	uint32_t crc;		//esp_rom_crc32_le of the bytes before
+} cfg_image_t;
+
+/**
+ * The points are kept in capture order, so a point index of the console
+ * stays put. lut holds the temperature of every code in Q TEMP_Q, linearly
+ * interpolated between the points sorted by code and extrapolated from the
+ * first and last segment.
+ */
+typedef struct {
+	cal_point_t point[CAL_MAX_POINTS];
+	uint8_t points;
 	uint8_t calibrated;
+	int32_t *lut;
 } calibration_t;
 
+/**
+ * Deadline of a channel. next_due is advanced by effective_us from its
+ * previous value, not from the sampling time, so the processing time does not
+ * accumulate into the period. effective_us is period_us<<backoff, backoff is
+ * 0 unless the channel is adaptive.
+ * The ADC task owns effective_us, next_due, last and the timing counters and
+ * writes them without ad_sem, the console posts a restart through
+ * sched_restart instead. period_us and adaptive are written by the console,
+ * backoff, hyst_seen and quiet_since by the filtering side, both under
+ * ad_sem.
+ */
+typedef struct {
+	uint32_t period_us;
+	uint32_t effective_us;
+	uint8_t adaptive;
+	uint8_t backoff;
+	int32_t hyst_seen;		//hysteresis centre at quiet_since
+	int64_t quiet_since;
+	int64_t next_due;
+	int64_t last;
+	uint32_t measured_us;
+	uint32_t jitter_avg_us;		//moving average of |measured-period|
+	uint32_t jitter_max_us;
+	uint32_t overruns;
+	uint32_t hist[AD_TIMING_BINS];
+} ad_sched_t;
+
+/**
+ * Oversampling: the sum of 1<<shift conversions keeps up to MV_Q of its
+ * extra bits as the fraction of raw_q, a larger ratio is shifted down with
+ * rounding. The fraction is interpolated through the mV table and carried
+ * through the filters into the temperature table, so the ratio adds
+ * effective bits as well as rejecting noise. count and acc hold the running
+ * burst in the frame modes.
+ */
+typedef struct {
+	uint8_t shift;
+	uint16_t count;
+	uint32_t acc;
+	uint32_t cycles;	//cycles of the last burst
+} ad_osr_t;
+
+typedef struct {
+	uint16_t normalized;
+	int32_t temperature;	//Q TEMP_Q
+} ad_value_t;
+
+/**
+ * Double buffered publication of the results (ad_seqlock.h), the sampler is
+ * the writer. A preempted sampler never blocks the readers and the readers
+ * never block the sampler.
+ */
+typedef struct {
+	uint32_t seq;
+	ad_value_t buf[2];
+} ad_pub_t;
+
 typedef struct {
 	 uint8_t running;
-	moving_hyst_t moving_hyst;
-	moving_avg_t moving_avg;
 	calibration_t calibration;
-	uint16_t raw;
-	uint16_t normalized;
-	float temperature;
+	const uint16_t *mv;		//raw code to mV of the attenuation of the channel
+	uint16_t raw_q;		//Q MV_Q, the fraction comes from the oversampling
+	uint16_t raw;		//raw_q rounded
+	uint16_t raw_mv;
+	uint16_t filtered;	//Q MV_Q, the seed of the filters when they are reset
+	uint16_t normalized;	//filtered rounded
+	int32_t temperature;	//Q TEMP_Q
+	uint32_t updates;
+	int64_t timestamp;
+	ad_channel_stats_t stats;	//updates and overruns are kept elsewhere
+	uint32_t dropped;		//conversions lost on a full ring, written by the ADC task only
+	ad_sched_t sched;
+	ad_osr_t osr;
+	ad_median_t median;
+	ad_iir_t iir;
+	ad_pub_t pub;
 } ad_struct;
 
+typedef struct {
+	uint32_t scan;
+	struct {
+		uint8_t running;
+		uint16_t raw;
+		uint16_t normalized;
+		int32_t temperature;	//Q TEMP_Q
+		uint32_t seq;
+		int64_t timestamp;
+	} ch[MAX_CHANNELS];
+} ad_scan_t;
+
+/**
+ * Snapshot of every channel published at the end of a scan, same double
+ * buffer scheme as ad_pub_t
+ */
+typedef struct {
+	uint32_t seq;
+	ad_scan_t buf[2];
+} ad_scan_pub_t;
+
 #define MAX(a,b) ((a)>(b)?(a):(b))
 
 #define MIN(a,b) ((a)<(b)?(a):(b))
 
 //!!! convert ad_channel[MAX_CHANNELS] to array of ad_channel[MAX_CHANNELS]s
 static ad_struct ad_channel[MAX_CHANNELS];
+static ad_kernel_t ad_kernel;		//hysteresis and average of all channels
 static TaskHandle_t ad_tsk;
-static SemaphoreHandle_t ad_sem;
-
+static SemaphoreHandle_t ad_sem;	//guards the filter state, readers use pub
+static ad_scan_pub_t ad_scan_pub;
+static cfg_image_t cfg_stored;		//image in the flash, or the defaults
+static ad_stats_t ad_task_stats;	//the task fields, the channels keep their own
+static uint32_t ad_running;		//bit ch is set if the channel is running
+static uint32_t sched_restart;		//bit ch is set until the ADC task restarted the deadline of ch
+
+/**
+ * Channel table of the AD configuration menu, the NVS configuration
+ * overrides period, window and median.
+ */
+typedef struct {
+	adc1_channel_t pin;
+	adc_atten_t atten;
+	uint32_t period_us;
+	uint16_t window;
+	uint8_t median;
+	uint8_t running;
+	uint8_t adaptive;
+} channel_def_t;
+
+#ifndef CONFIG_AD_CH0_RUNNING
+#define CONFIG_AD_CH0_RUNNING 0
+#endif
+#ifndef CONFIG_AD_CH0_ADAPTIVE
+#define CONFIG_AD_CH0_ADAPTIVE 0
+#endif
+#ifndef CONFIG_AD_CH1_RUNNING
+#define CONFIG_AD_CH1_RUNNING 0
+#endif
+#ifndef CONFIG_AD_CH1_ADAPTIVE
+#define CONFIG_AD_CH1_ADAPTIVE 0
+#endif
+#ifndef CONFIG_AD_CH2_RUNNING
+#define CONFIG_AD_CH2_RUNNING 0
+#endif
+#ifndef CONFIG_AD_CH2_ADAPTIVE
+#define CONFIG_AD_CH2_ADAPTIVE 0
+#endif
+#ifndef CONFIG_AD_CH3_RUNNING
+#define CONFIG_AD_CH3_RUNNING 0
+#endif
+#ifndef CONFIG_AD_CH3_ADAPTIVE
+#define CONFIG_AD_CH3_ADAPTIVE 0
+#endif
+#ifndef CONFIG_AD_CH4_RUNNING
+#define CONFIG_AD_CH4_RUNNING 0
+#endif
+#ifndef CONFIG_AD_CH4_ADAPTIVE
+#define CONFIG_AD_CH4_ADAPTIVE 0
+#endif
+#ifndef CONFIG_AD_CH5_RUNNING
+#define CONFIG_AD_CH5_RUNNING 0
+#endif
+#ifndef CONFIG_AD_CH5_ADAPTIVE
+#define CONFIG_AD_CH5_ADAPTIVE 0
+#endif
+#ifndef CONFIG_AD_CH6_RUNNING
+#define CONFIG_AD_CH6_RUNNING 0
+#endif
+#ifndef CONFIG_AD_CH6_ADAPTIVE
+#define CONFIG_AD_CH6_ADAPTIVE 0
+#endif
+#ifndef CONFIG_AD_CH7_RUNNING
+#define CONFIG_AD_CH7_RUNNING 0
+#endif
+#ifndef CONFIG_AD_CH7_ADAPTIVE
+#define CONFIG_AD_CH7_ADAPTIVE 0
+#endif
 
-//!!! Create an array contains de ad channel names for each channels
-const adc_channel_t array_channels[MAX_CHANNELS]={
-	
-ADC1_CHANNEL_7,ADC1_CHANNEL_6 // 0 1 
+#define CHANNEL_DEF(n) { \
+	.pin=CONFIG_AD_CH##n##_PIN, \
+	.atten=CONFIG_AD_CH##n##_ATTEN, \
+	.period_us=CONFIG_AD_CH##n##_PERIOD_US, \
+	.window=CONFIG_AD_CH##n##_AVG_WINDOW, \
+	.median=CONFIG_AD_CH##n##_MEDIAN, \
+	.running=CONFIG_AD_CH##n##_RUNNING, \
+	.adaptive=CONFIG_AD_CH##n##_ADAPTIVE \
+}
 
+static const channel_def_t CHANNELS[MAX_CHANNELS]={
+#if MAX_CHANNELS>0
+	CHANNEL_DEF(0),
+#endif
+#if MAX_CHANNELS>1
+	CHANNEL_DEF(1),
+#endif
+#if MAX_CHANNELS>2
+	CHANNEL_DEF(2),
+#endif
+#if MAX_CHANNELS>3
+	CHANNEL_DEF(3),
+#endif
+#if MAX_CHANNELS>4
+	CHANNEL_DEF(4),
+#endif
+#if MAX_CHANNELS>5
+	CHANNEL_DEF(5),
+#endif
+#if MAX_CHANNELS>6
+	CHANNEL_DEF(6),
+#endif
+#if MAX_CHANNELS>7
+	CHANNEL_DEF(7),
+#endif
 };
 
+static const char *ATTEN_NAMES[ADC_ATTEN_MAX]={"0dB", "2.5dB", "6dB", "11dB"};
+
 
 static void register_cmd();
+
+/**
+ * The polling sampler visits the set bits of ad_running only, so its cost
+ * grows with the running channels, not with the configured ones.
+ */
+static void set_running(uint8_t ch, uint8_t on) {
+	ad_channel[ch].running=on;
+	if (on)
+		__atomic_or_fetch(&ad_running, 1u<<ch, __ATOMIC_RELEASE);
+	else
+		__atomic_and_fetch(&ad_running, ~(1u<<ch), __ATOMIC_RELEASE);
+}
+
 BaseType_t check_channel(uint8_t ch){
 
-if(ch>MAX_CHANNELS){
+if(ch>=MAX_CHANNELS){
 ESP_LOGE(TAG,"more than allowed channels");
 return pdFAIL;
 
@@ -123,195 +397,935 @@ return pdFAIL;
 return pdPASS;
 }
 
-//!!! add channel index to as parameter
-static uint16_t get_hyst(uint16_t raw, uint8_t ch , uint16_t *res) {
-	if(check_channel(ch)!=pdPASS) return pdFAIL;
-	//!!! Use channel index
-	if (raw>ad_channel[ch].moving_hyst.hyst_max) { // out of range in top direction
-		ad_channel[ch].moving_hyst.hyst_max = MIN(AD_MAX,
-						ad_channel[ch].moving_hyst.hyst_max+ad_channel[ch].moving_hyst.hyst_delta);
-		ad_channel[ch].moving_hyst.hyst_min = MIN(AD_MAX,
-						ad_channel[ch].moving_hyst.hyst_min+ad_channel[ch].moving_hyst.hyst_delta);
-		return ad_channel[ch].moving_hyst.hyst_max;
-	}
-	if (raw<ad_channel[ch].moving_hyst.hyst_min) {  //out of range in bottom direction
-		ad_channel[ch].moving_hyst.hyst_min = MAX(AD_MIN,
-						ad_channel[ch].moving_hyst.hyst_min-ad_channel[ch].moving_hyst.hyst_delta);
-		ad_channel[ch].moving_hyst.hyst_max = MAX(AD_MIN,
-						ad_channel[ch].moving_hyst.hyst_max-ad_channel[ch].moving_hyst.hyst_delta);
-		return ad_channel[ch].moving_hyst.hyst_min;
-	}
-	*res=raw;
-	return *res ;
-}
-static uint16_t get_avg(uint16_t input, uint8_t ch, uint16_t *res) {
+static inline int valid_window(int window) {
+	return window>0 && window<=CONFIG_AD_AVG_MAX_WINDOW;
+}
+
+/**
+ * Resizes the moving average window and fills it with seed, mV in Q MV_Q.
+ * Caller must hold ad_sem if the ADC task is running.
+ */
+static BaseType_t set_avg_window(uint8_t ch, uint16_t window, uint16_t seed) {
 	if(check_channel(ch)!=pdPASS) return pdFAIL;
-	ad_channel[ch].moving_avg.queue[ad_channel[ch].moving_avg.idx]=input;
-	ad_channel[ch].moving_avg.idx=(ad_channel[ch].moving_avg.idx+1)%MOVING_AVG_SIZE;
-	uint32_t sum=0;
-	for(uint8_t i=0; i<MOVING_AVG_SIZE;++i)
-		sum+=ad_channel[ch].moving_avg.queue[i];
+	return ad_kernel_set_window(&ad_kernel, ch, window, seed) ? pdPASS : pdFAIL;
+}
+
+static inline void publish(ad_struct *a) {
+	ad_pub_t *pub=&a->pub;
+	ad_value_t *v=&pub->buf[ad_seqlock_write_begin(&pub->seq)];
+	v->normalized=a->normalized;
+	v->temperature=a->temperature;
+	ad_seqlock_write_end(&pub->seq);
+}
+
+static inline void read_published(uint8_t ch, ad_value_t *value) {
+	const ad_pub_t *pub=&ad_channel[ch].pub;
+	uint32_t seq;
+	do {
+		seq=ad_seqlock_read_begin(&pub->seq);
+		*value=pub->buf[seq&1];
+	} while (ad_seqlock_read_retry(&pub->seq, seq));
+}
+
+static void publish_scan() {
+	ad_scan_t *snap=&ad_scan_pub.buf[ad_seqlock_write_begin(&ad_scan_pub.seq)];
+	snap->scan=ad_scan_pub.seq+1;
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch) {
+		snap->ch[ch].running=ad_channel[ch].running;
+		snap->ch[ch].raw=ad_channel[ch].raw;
+		snap->ch[ch].normalized=ad_channel[ch].normalized;
+		snap->ch[ch].temperature=ad_channel[ch].temperature;
+		snap->ch[ch].seq=ad_channel[ch].updates;
+		snap->ch[ch].timestamp=ad_channel[ch].timestamp;
+	}
+	ad_seqlock_write_end(&ad_scan_pub.seq);
+}
+
+/**
+ * Stages of filter_scan timed by ad --bench
+ */
+typedef enum {
+	STAGE_MV,
+	STAGE_MEDIAN,
+	STAGE_HYST,
+	STAGE_AVG,
+	STAGE_IIR,
+	STAGE_TEMP,
+	STAGE_HISTORY,
+	STAGE_ALARM,
+	STAGE_PUBLISH,
+	STAGE_FILTER_MAX
+} stage_t;
+
+#define STAMP(stamps, stage) do { if (stamps) (stamps)[stage]=ad_hal_cycles(); } while (0)
+
+/**
+ * Filters raw_q of every channel of mask, each stage runs over all of them
+ * before the next one, so a stage keeps its code and the kernel keeps its
+ * arrays in cache across the scan. The stages work on mV in Q MV_Q up to the
+ * temperature table, raw, raw_mv and normalized are rounded from them.
+ * @param chan ad_channel, or a scratch copy of it for ad --bench, the history
+ * 		  and the alarms are shared with the live channels and run only for
+ * 		  ad_channel
+ * @param k the kernel state of chan
+ * @param ts ts[ch] is the time of the sample of ch
+ * @param stamps NULL, or the cycle counter after each stage is stored into it
+ */
+static inline void filter_scan(ad_struct *chan, ad_kernel_t *k, uint32_t mask,
+							   const int64_t *ts, uint32_t *stamps) {
+	uint16_t v[MAX_CHANNELS]={0};	//only the entries of mask are used
+	AD_KERNEL_FOR_EACH(ch, mask) {
+		v[ch]=ad_mv_lookup(chan[ch].mv, chan[ch].raw_q);
+		chan[ch].raw=Q_ROUND(chan[ch].raw_q);
+		chan[ch].raw_mv=Q_ROUND(v[ch]);
+	}
+	STAMP(stamps, STAGE_MV);
+	AD_KERNEL_FOR_EACH(ch, mask)
+		v[ch]=ad_median_insert(&chan[ch].median, v[ch]);
+	STAMP(stamps, STAGE_MEDIAN);
+	ad_kernel_hyst(k, mask, v, v);
+	STAMP(stamps, STAGE_HYST);
+	ad_kernel_avg(k, mask, v, v);
+	STAMP(stamps, STAGE_AVG);
+	AD_KERNEL_FOR_EACH(ch, mask) {
+		chan[ch].filtered=ad_iir_process(&chan[ch].iir, v[ch]);
+		chan[ch].normalized=Q_ROUND(chan[ch].filtered);
+	}
+	STAMP(stamps, STAGE_IIR);
+	AD_KERNEL_FOR_EACH(ch, mask) {
+		chan[ch].temperature=ad_conv_lookup(chan[ch].calibration.lut, LUT_SIZE, chan[ch].filtered, MV_Q);
+		chan[ch].timestamp=ts[ch];
+		++chan[ch].updates;
+	}
+	STAMP(stamps, STAGE_TEMP);
+	if (chan==ad_channel)
+		AD_KERNEL_FOR_EACH(ch, mask)
+			ad_history_push(ch, ts[ch], chan[ch].raw, chan[ch].normalized);
+	STAMP(stamps, STAGE_HISTORY);
+	if (chan==ad_channel)
+		AD_KERNEL_FOR_EACH(ch, mask)
+			ad_alarm_update(ch, chan[ch].normalized, ts[ch]);
+	STAMP(stamps, STAGE_ALARM);
+	AD_KERNEL_FOR_EACH(ch, mask)
+		publish(&chan[ch]);
+	STAMP(stamps, STAGE_PUBLISH);
+}
+
+static inline void stat_update(uint32_t *avg, uint32_t *max, uint32_t value) {
+	*max=MAX(*max, value);
+	*avg+=((int32_t) value-(int32_t) *avg)>>JITTER_AVG_SHIFT;
+}
+
+/**
+ * Takes ad_sem for the sampler, it gives up after LOCK_WAIT_MS, so a long
+ * console command costs skipped conversions instead of a stalled task.
+ */
+static BaseType_t sampler_take() {
+	int64_t start=ad_hal_time_us();
+	BaseType_t res=xSemaphoreTake(ad_sem, MAX(1, pdMS_TO_TICKS(LOCK_WAIT_MS)));
+	stat_update(&ad_task_stats.lock_avg_us, &ad_task_stats.lock_max_us, ad_hal_time_us()-start);
+	if (!res)
+		++ad_task_stats.lock_timeouts;
+	return res;
+}
+
+static inline void loop_done(int64_t start) {
+	++ad_task_stats.loops;
+	stat_update(&ad_task_stats.loop_avg_us, &ad_task_stats.loop_max_us, ad_hal_time_us()-start);
+}
+
+static inline int valid_period(int64_t period_us) {
+	return period_us>=MIN_PERIOD_US && period_us<=MAX_PERIOD_US;
+}
+
+static inline float sample_hz(uint8_t ch) {
+	return 1000000.0f/ad_channel[ch].sched.period_us;
+}
 
-	*res=sum/MOVING_AVG_SIZE;
-return *res;
+/**
+ * Caller must hold ad_sem if the ADC task is running.
+ */
+static BaseType_t set_filter(uint8_t ch, ad_filter_type_t type, uint8_t stages, float cutoff_hz) {
+	return ad_iir_config(&ad_channel[ch].iir, type, stages, cutoff_hz,
+						 sample_hz(ch), ad_channel[ch].filtered) ? pdPASS : pdFAIL;
+}
+
+/**
+ * Asks the ADC task to restart the deadline of ch at its next loop, the
+ * deadline and the timing counters belong to it.
+ */
+static void sched_request(uint8_t ch) {
+	__atomic_or_fetch(&sched_restart, 1u<<ch, __ATOMIC_RELEASE);
+	if (ad_tsk)
+		xTaskNotifyGive(ad_tsk);
+}
+
+/**
+ * Restarts the deadlines the console asked for, the first sample is due at
+ * now. Called by the ADC task only.
+ */
+static void sched_take_restart(int64_t now) {
+	uint32_t restart=__atomic_exchange_n(&sched_restart, 0, __ATOMIC_ACQUIRE);
+	AD_KERNEL_FOR_EACH(ch, restart) {
+		ad_sched_t *sched=&ad_channel[ch].sched;
+		sched->effective_us=__atomic_load_n(&sched->period_us, __ATOMIC_RELAXED)
+				<<__atomic_load_n(&sched->backoff, __ATOMIC_RELAXED);
+		sched->next_due=now;
+		sched->last=0;
+		sched->jitter_avg_us=0;
+		sched->jitter_max_us=0;
+		sched->overruns=0;
+		bzero(sched->hist, sizeof(sched->hist));
+	}
 }
 
+/**
+ * The filter coefficients depend on the sample rate, they are recomputed.
+ * The deadline restarts at the next loop of the ADC task. Caller must hold
+ * ad_sem if the ADC task is running.
+ */
+static void set_period(uint8_t ch, uint32_t period_us) {
+	ad_sched_t *sched=&ad_channel[ch].sched;
+	__atomic_store_n(&sched->period_us, period_us, __ATOMIC_RELAXED);
+	__atomic_store_n(&sched->backoff, 0, __ATOMIC_RELAXED);
+	sched->hyst_seen=ad_kernel_centre(&ad_kernel, ch);
+	sched->quiet_since=ad_hal_time_us();
+	sched_request(ch);
+	const ad_iir_t *iir=&ad_channel[ch].iir;
+	if (iir->type!=AD_FILTER_NONE && set_filter(ch, iir->type, iir->stages, iir->cutoff_hz)!=pdPASS) {
+		ESP_LOGW(TAG, "cutoff %f Hz is invalid at the new period, filter is off", iir->cutoff_hz);
+		set_filter(ch, AD_FILTER_NONE, 0, 0);
+	}
+}
+
+/**
+ * Accounts a sample taken at now and advances the deadline. If the deadline
+ * is already missed by a whole period the missed slots are dropped and
+ * counted as overrun.
+ */
+static void sched_sampled(ad_sched_t *sched, int64_t now) {
+	if (sched->last) {
+		sched->measured_us=now-sched->last;
+		uint32_t jitter=sched->measured_us>sched->effective_us
+				? sched->measured_us-sched->effective_us
+				: sched->effective_us-sched->measured_us;
+		sched->jitter_max_us=MAX(sched->jitter_max_us, jitter);
+		sched->jitter_avg_us+=((int32_t) jitter-(int32_t) sched->jitter_avg_us)>>JITTER_AVG_SHIFT;
+		++sched->hist[MIN(jitter ? 32-__builtin_clz(jitter) : 0, AD_TIMING_BINS-1)];
+	}
+	sched->last=now;
+	sched->next_due+=sched->effective_us;
+	if (sched->next_due<=now) {
+		int64_t missed=(now-sched->next_due)/sched->effective_us+1;
+		sched->overruns+=missed;
+		sched->next_due+=missed*sched->effective_us;
+	}
+}
+
+/**
+ * Adaptive mode, called after the sample of now is filtered: the period
+ * doubles every ADAPTIVE_QUIET_US the moving hysteresis stays put and falls
+ * back to period_us on the first sample which moves it. Only backoff is
+ * chosen here, sched_apply moves the deadline. The average and the filter
+ * keep their per-sample coefficients, so their time constants stretch with
+ * the period while the channel is backed off.
+ * @return 1 if the channel fell back to period_us
+ */
+static int sched_adapt(uint8_t ch, int64_t now) {
+	ad_sched_t *sched=&ad_channel[ch].sched;
+	int32_t hyst=ad_kernel_centre(&ad_kernel, ch);
+	if (hyst!=sched->hyst_seen || !sched->adaptive) {
+		int snap=sched->backoff!=0;
+		__atomic_store_n(&sched->backoff, 0, __ATOMIC_RELAXED);
+		sched->hyst_seen=hyst;
+		sched->quiet_since=now;
+		return snap;
+	}
+	if (sched->backoff<CONFIG_AD_ADAPTIVE_MAX_SHIFT && now-sched->quiet_since>=ADAPTIVE_QUIET_US
+			&& (sched->period_us<<sched->backoff)<=MAX_PERIOD_US/2) {
+		__atomic_store_n(&sched->backoff, sched->backoff+1, __ATOMIC_RELAXED);
+		sched->quiet_since=now;
+	}
+	return 0;
+}
+
+/**
+ * Takes the back off chosen by sched_adapt into the deadline, called by the
+ * task which owns the deadlines. Back at a shorter period the next sample is
+ * one new period after the last one, or now.
+ */
+static void sched_apply(uint8_t ch, int64_t now) {
+	ad_sched_t *sched=&ad_channel[ch].sched;
+	uint32_t effective=__atomic_load_n(&sched->period_us, __ATOMIC_RELAXED)
+			<<__atomic_load_n(&sched->backoff, __ATOMIC_RELAXED);
+	if (effective==sched->effective_us)
+		return;
+
+	if (effective<sched->effective_us)
+		sched->next_due=MAX(now, sched->last+effective);
+	sched->effective_us=effective;
+	sched->last=0;		//no jitter across the change
+}
+
+/**
+ * @return the sum of a burst of 1<<shift codes as a code in Q MV_Q
+ */
+static inline uint16_t osr_code(uint32_t acc, uint8_t shift) {
+	return shift<=MV_Q ? acc<<(MV_Q-shift) : (acc+(1<<(shift-MV_Q-1)))>>(shift-MV_Q);
+}
+
+#if CONFIG_AD_ACQ_POLLING
+
+static esp_timer_handle_t ad_timer;
+#if CONFIG_AD_PIPELINE
+static ad_ring_t ad_ring;
+static TaskHandle_t proc_tsk;
+#endif
+
+/**
+ * @return the burst of ch as a code in Q MV_Q
+ */
+static uint16_t read_burst(uint8_t ch, ad_osr_t *osr) {
+	uint32_t start=ad_hal_cycles();
+	uint32_t acc=0;
+	for(uint16_t i=0; i<(1<<osr->shift); ++i)
+		acc+=ad_hal_adc_read(CHANNELS[ch].pin);
+
+	osr->cycles=ad_hal_cycles()-start;
+	return osr_code(acc, osr->shift);
+}
+
+/**
+ * Runs in the timer ISR if the esp_timer supports it, else in the esp_timer
+ * task, in both cases the wake up does not depend on the FreeRTOS tick.
+ */
+static void IRAM_ATTR fn_timer(void *arg) {
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+	BaseType_t woken=pdFALSE;
+	vTaskNotifyGiveFromISR(ad_tsk, &woken);
+	if (woken)
+		portYIELD_FROM_ISR();
+#else
+	xTaskNotifyGive(ad_tsk);
+#endif
+}
+
+/**
+ * Sleeps until CONFIG_AD_TIMER_LEAD_US before the deadline or a notification
+ * from the console, then spins for the rest, so the wake up latency of the
+ * task does not show up as jitter.
+ */
+static void wait_until(int64_t deadline) {
+	int64_t now=ad_hal_time_us();
+	if (deadline-now>CONFIG_AD_TIMER_LEAD_US) {
+		esp_timer_stop(ad_timer);
+		if (esp_timer_start_once(ad_timer, deadline-now-CONFIG_AD_TIMER_LEAD_US)!=ESP_OK) {
+			vTaskDelay(1);
+			return;
+		}
+		if (!ulTaskNotifyTake(pdTRUE, portMAX_DELAY) || ad_hal_time_us()<deadline-CONFIG_AD_TIMER_LEAD_US)
+			return;		//woken by the console
+	}
+	while (ad_hal_time_us()<deadline)
+		;
+}
+
+/**
+ * Filters a scan of the acquisition, in the ADC task, or in the processing
+ * task with CONFIG_AD_PIPELINE.
+ */
+static void process_scan(const ad_ring_scan_t *scan) {
+	int snap=0;
+	AD_KERNEL_FOR_EACH(i, scan->mask)
+		ad_channel[i].raw_q=scan->raw[i];
+	if (sampler_take()) {
+		filter_scan(ad_channel, &ad_kernel, scan->mask, scan->ts, NULL);
+		AD_KERNEL_FOR_EACH(i, scan->mask)
+			snap|=sched_adapt(i, scan->ts[i]);
+		xSemaphoreGive(ad_sem);
+		int64_t done=ad_hal_time_us();
+		AD_KERNEL_FOR_EACH(i, scan->mask)
+			stat_update(&ad_channel[i].stats.latency_avg_us, &ad_channel[i].stats.latency_max_us,
+					done-scan->deadline[i]);
+	}
+	else
+		AD_KERNEL_FOR_EACH(i, scan->mask)
+			ad_channel[i].stats.skipped+=1<<ad_channel[i].osr.shift;
+	if (!ad_stream_running())
+		AD_KERNEL_FOR_EACH(i, scan->mask)
+			AD_LOGI(TAG,"ch:%d raw:%d, normalized:%d ", i, ad_channel[i].raw, ad_channel[i].normalized);
+	publish_scan();
+	ad_alarm_scan();
+#if CONFIG_AD_PIPELINE
+	if (snap)
+		xTaskNotifyGive(ad_tsk);	//the ADC task moves the deadline
+#else
+	(void) snap;
+#endif
+}
+
+#if CONFIG_AD_PIPELINE
+/**
+ * Processing side of the pipeline on CONFIG_AD_PROC_CORE, it drains the ring
+ * while the ADC task keeps converting on its own core.
+ */
+static void fn_proc(void *p) {
+	ESP_LOGI(TAG,"processing task started");
+	ad_ring_scan_t scan;
+	for(;;) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		while (ad_ring_pop(&ad_ring, &scan))
+			process_scan(&scan);
+	}
+}
+#endif
+
+/**
+ * Samples the channels which are due and sleeps until the earliest next
+ * deadline. The deadlines belong to this task, with CONFIG_AD_PIPELINE the
+ * scan is handed to the processing task, so its time never delays a
+ * conversion.
+ */
 static void fn_ad(void *p) {
 	ESP_LOGI(TAG,"ADC task started");
+	ad_ring_scan_t scan;
 	for(;;) {
-		for(int i=0;i<MAX_CHANNELS;i++){
-		if (ad_channel[i].running) {
-			
-			ad_channel[i].raw=adc1_get_raw(array_channels[i]);
-			if (xSemaphoreTake(ad_sem, pdMS_TO_TICKS(5))) {
-				
-				ad_channel[i].normalized=get_avg(get_hyst(ad_channel[i].raw,i,&ad_channel[i].normalized),i,&ad_channel[i].normalized);
-				ad_channel[i].temperature=ad_channel[i].normalized*ad_channel[i].calibration.tga;
-				xSemaphoreGive(ad_sem);
+		int64_t now=ad_hal_time_us();
+		int64_t next=now+IDLE_WAIT_MS*1000;
+		uint32_t running=__atomic_load_n(&ad_running, __ATOMIC_ACQUIRE);
+		sched_take_restart(now);
+		scan.mask=0;
+		AD_KERNEL_FOR_EACH(i, running) {
+			sched_apply(i, now);
+			if (ad_channel[i].sched.next_due<=now) {
+				scan.deadline[i]=ad_channel[i].sched.next_due;
+				scan.ts[i]=now;
+				scan.raw[i]=read_burst(i, &ad_channel[i].osr);
+				ad_channel[i].stats.conversions+=1<<ad_channel[i].osr.shift;
+				scan.mask|=1u<<i;
+				sched_sampled(&ad_channel[i].sched, now);
 			}
-			ESP_LOGI(TAG,"raw:%d, normalized:%d ", ad_channel[i].raw, ad_channel[i].normalized);
-		}}
-		vTaskDelay(pdMS_TO_TICKS(TASK_DELAY_MS));
+			next=MIN(next, ad_channel[i].sched.next_due);
+		}
+		if (scan.mask) {
+#if CONFIG_AD_PIPELINE
+			if (ad_ring_push(&ad_ring, &scan))
+				xTaskNotifyGive(proc_tsk);
+			else
+				AD_KERNEL_FOR_EACH(i, scan.mask)
+					ad_channel[i].dropped+=1<<ad_channel[i].osr.shift;
+#else
+			process_scan(&scan);
+#endif
+		}
+		loop_done(now);
+
+		wait_until(next);
 	}
 }
 
+static uint16_t read_raw(uint8_t ch) {
+	return Q_ROUND(read_burst(ch, &ad_channel[ch].osr));
+}
 
+/**
+ * Cycles of a burst of 1<<shift conversions
+ */
+static uint32_t burst_cost(uint8_t ch, uint8_t shift) {
+	uint32_t start=ad_hal_cycles();
+	for(uint16_t i=0; i<(1<<shift); ++i)
+		ad_hal_adc_read(CHANNELS[ch].pin);
 
-//!!! pass channel index to function & use it
-static inline int validate_calibration(uint8_t ch) {
-	if(check_channel(ch)!=pdPASS) return 0;
-	int res=1;
-	if (ad_channel[ch].calibration.d0>=ad_channel[ch].calibration.d1) {
-		ad_channel[ch].calibration.d0=DEF_D0;
-		ad_channel[ch].calibration.d1=DEF_D1;
-		res=0;
+	return ad_hal_cycles()-start;
+}
+
+#else
+
+#define FRAME_SIZE (CONFIG_AD_FRAME_SCANS*MAX_CHANNELS)
+#define FRAME_WAIT_MS (1000)
+#define CONV_PERIOD_US (1000000.0/CONFIG_AD_CONV_FREQ_HZ)
+
+static ad_sample_t ad_frame[FRAME_SIZE];
+
+/**
+ * Accumulates raw into the burst of a channel
+ * @return 1 if the burst is complete and *out holds the decimated sample in
+ * 		   Q MV_Q
+ */
+static inline int decimate(ad_osr_t *osr, uint16_t raw, uint16_t *out) {
+	osr->acc+=raw;
+	if (++osr->count<(1<<osr->shift))
+		return 0;
+
+	*out=osr_code(osr->acc, osr->shift);
+	osr->acc=0;
+	osr->count=0;
+	return 1;
+}
+
+/**
+ * Filters the channels of mask and advances their deadlines, ts[ch] is the
+ * time of the sample of ch. Caller holds ad_sem.
+ */
+static void sample_scan(uint32_t mask, const int64_t *ts) {
+	filter_scan(ad_channel, &ad_kernel, mask, ts, NULL);
+	AD_KERNEL_FOR_EACH(ch, mask) {
+		sched_adapt(ch, ts[ch]);
+		sched_apply(ch, ts[ch]);
+		sched_sampled(&ad_channel[ch].sched, ts[ch]);
 	}
+}
 
-	if (ad_channel[ch].calibration.t0>=ad_channel[ch].calibration.t1) {
-		ad_channel[ch].calibration.t0=DEF_T0;
-		ad_channel[ch].calibration.t1=DEF_T1;
-		res=0;
+/**
+ * The whole frame is filtered under one semaphore take, raw is updated for
+ * the stopped channels as well, so calibration can use it. The sample time is
+ * back-computed from the end of the frame and the conversion rate, a channel
+ * is filtered only if its deadline is due, so a channel period decimates the
+ * conversion rate.
+ */
+static void fn_ad(void *p) {
+	ESP_LOGI(TAG,"ADC task started, frame size:%d", FRAME_SIZE);
+	for(;;) {
+		int n=ad_dma_read(ad_frame, FRAME_SIZE, pdMS_TO_TICKS(FRAME_WAIT_MS));
+		if (n<0) {
+			AD_LOGE(TAG, "frame read error");
+			vTaskDelay(pdMS_TO_TICKS(TASK_DELAY_MS));
+			continue;
+		}
+		if (!n)
+			continue;
+
+		int64_t timestamp=ad_hal_time_us();
+		for(int i=0; i<n; ++i)
+			++ad_channel[ad_frame[i].ch].stats.conversions;
+		int64_t first=timestamp-(int64_t) ((n-1)*CONV_PERIOD_US);
+		sched_take_restart(first);
+		AD_KERNEL_FOR_EACH(ch, __atomic_load_n(&ad_running, __ATOMIC_ACQUIRE))
+			sched_apply(ch, first);
+
+		if (!sampler_take()) {
+			for(int i=0; i<n; ++i)
+				++ad_channel[ad_frame[i].ch].stats.skipped;
+			loop_done(timestamp);
+			continue;
+		}
+		int64_t oldest[MAX_CHANNELS]={0};
+		int64_t ts[MAX_CHANNELS];
+		uint32_t due=0;
+		for(int i=0; i<n; ++i) {
+			uint8_t ch=ad_frame[i].ch;
+			int64_t t=timestamp-(int64_t) ((n-1-i)*CONV_PERIOD_US);
+			uint32_t start=ad_hal_cycles();
+			uint16_t raw;
+			if (!decimate(&ad_channel[ch].osr, ad_frame[i].raw, &raw))
+				continue;
+
+			ad_channel[ch].osr.cycles=ad_hal_cycles()-start;
+			if (due&(1u<<ch)) {		//next scan, the pending one goes first
+				sample_scan(due, ts);
+				due=0;
+			}
+			ad_channel[ch].raw_q=raw;
+			ad_channel[ch].raw=Q_ROUND(raw);
+			if (ad_channel[ch].running && ad_channel[ch].sched.next_due<=t) {
+				ts[ch]=t;
+				due|=1u<<ch;
+				if (!oldest[ch])
+					oldest[ch]=t;
+			}
+		}
+		if (due)
+			sample_scan(due, ts);
+		publish_scan();
+		xSemaphoreGive(ad_sem);
+		ad_alarm_scan();
+		int64_t done=ad_hal_time_us();
+		for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch)
+			if (oldest[ch])
+				stat_update(&ad_channel[ch].stats.latency_avg_us, &ad_channel[ch].stats.latency_max_us,
+						done-oldest[ch]);
+		loop_done(timestamp);
+		AD_LOGD(TAG,"frame of %d samples, raw:%d, normalized:%d ", n, ad_channel[0].raw, ad_channel[0].normalized);
 	}
+}
 
-	float tga=(ad_channel[ch].calibration.t1-ad_channel[ch].calibration.t0)/
-			  (ad_channel[ch].calibration.d1-ad_channel[ch].calibration.d0);
+static uint16_t read_raw(uint8_t ch) {
+	return ad_channel[ch].raw;
+}
 
+/**
+ * Cycles of decimating a burst of 1<<shift samples of the frame stream, the
+ * conversions themselves are done by the DMA
+ */
+static uint32_t burst_cost(uint8_t ch, uint8_t shift) {
+	ad_osr_t osr={ .shift=shift };
+	uint16_t out;
+	uint32_t start=ad_hal_cycles();
+	for(uint16_t i=0; i<(1<<shift); ++i)
+		decimate(&osr, ad_channel[ch].raw, &out);
+
+	return ad_hal_cycles()-start;
+}
+
+/**
+ * Seeds raw of every channel from the first frame
+ */
+static BaseType_t prime_frame() {
+	int n=ad_dma_read(ad_frame, FRAME_SIZE, pdMS_TO_TICKS(FRAME_WAIT_MS));
+	if (n<=0)
+		return pdFAIL;
 
-if (abs((tga-ad_channel[ch].calibration.tga))>0.01) {
-		ad_channel[ch].calibration.tga=DEF_TGA;
-		res=0;
+	for(int i=0; i<n; ++i) {
+		ad_channel[ad_frame[i].ch].raw=ad_frame[i].raw;
+		ad_channel[ad_frame[i].ch].raw_q=ad_frame[i].raw<<MV_Q;
 	}
 
+	return pdPASS;
+}
 
+#endif
 
-	
+static void default_calibration(calibration_t *cal) {
+	cal->point[0]=(cal_point_t) {.d=DEF_D0, .t=DEF_T0};
+	cal->point[1]=(cal_point_t) {.d=DEF_D1, .t=DEF_T1};
+	cal->points=2;
+}
 
-	return res;
+/**
+ * @return index of the point of code d, -1 if there is none
+ */
+static int find_point(const calibration_t *cal, uint16_t d, int skip) {
+	for(int i=0; i<cal->points; ++i)
+		if (i!=skip && cal->point[i].d==d)
+			return i;
+
+	return -1;
 }
 
 //!!! pass channel index to function & use it
-static BaseType_t restore_cal_from_flash(uint8_t ch) {
-if(check_channel(ch)!=pdPASS) return pdFAIL;
-	ESP_LOGI(TAG, "Enter restore_cal_from_flash");
-	nvs_handle_t handle;
-	esp_err_t res=nvs_open(TAG, NVS_READWRITE, &handle);
-	if(res!=ESP_OK)
-		return pdFAIL;
-
-	if (ad_channel[ch].calibration.calibrated)
-		return pdTRUE;
+static inline int validate_calibration(uint8_t ch) {
+	if(check_channel(ch)!=pdPASS) return 0;
+	calibration_t *cal=&ad_channel[ch].calibration;
+	int res=cal->points>=2 && cal->points<=CAL_MAX_POINTS;
+	for(int i=0; res && i<cal->points; ++i)
+		res=cal->point[i].t>=MIN_TEMP && cal->point[i].t<=MAX_TEMP && find_point(cal, cal->point[i].d, i)<0;
 
-	res=nvs_get_u16(handle, KEYD0[ch], &ad_channel[ch].calibration.d0);
-	if (res!=ESP_OK)
-		ad_channel[ch].calibration.d0=DEF_D0;
+	if (!res)
+		default_calibration(cal);
 
-	res=nvs_get_u16(handle, KEYD1[ch], &ad_channel[ch].calibration.d1);
-	if (res!=ESP_OK)
-		ad_channel[ch].calibration.d1=DEF_D1;
+	return res;
+}
 
-	uint16_t t;
-	res=nvs_get_u16(handle,KEYT0[ch], &t);
-	ad_channel[ch].calibration.t0=res==ESP_OK ? t/100.0 : DEF_T0;
+/**
+ * Rebuilds the lookup table of the channel from the calibration points,
+ * called when the calibration changes only.
+ */
+static void update_conversion(uint8_t ch) {
+	calibration_t *cal=&ad_channel[ch].calibration;
+	if (!ad_conv_build(cal->point, cal->points, cal->lut, LUT_SIZE))
+		ESP_LOGE(TAG, "Invalid calibration of channel %d", ch);
+}
 
-	res=nvs_get_u16(handle, KEYT1[ch], &t);
-	ad_channel[ch].calibration.t1=res==ESP_OK ? t/100.0 : DEF_T1;
+static void cfg_default(uint8_t ch, cfg_channel_t *c) {
+	*c=(cfg_channel_t) {
+		.points=2,
+		.point={{.d=DEF_D0, .t=DEF_T0}, {.d=DEF_D1, .t=DEF_T1}},
+		.window=CHANNELS[ch].window,
+		.period_us=CHANNELS[ch].period_us,
+		.median=CHANNELS[ch].median,
+		.filter=AD_FILTER_NONE
+	};
+}
 
+static inline size_t cfg_size(uint8_t version, uint8_t channels) {
+	size_t record=version==1 ? sizeof(cfg_channel_v1_t) : sizeof(cfg_channel_t);
+	return offsetof(cfg_image_t, ch)+channels*record+sizeof(uint32_t);
+}
 
-	res=nvs_get_u16(handle, KEYTGA[ch], &t);
-	ad_channel[ch].calibration.tga=res==ESP_OK ? t/100.0 : DEF_TGA;
+static inline uint32_t cfg_crc(const cfg_image_t *img, size_t len) {
+	return esp_rom_crc32_le(0, (const uint8_t *) img, len-sizeof(uint32_t));
+}
 
-	ad_channel[ch].calibration.calibrated=validate_calibration(ch);
+static void cfg_upgrade_v1(const cfg_channel_v1_t *v1, cfg_channel_t *c) {
+	*c=(cfg_channel_t) {
+		.points=2,
+		.point={{.d=v1->d0, .t=v1->t0}, {.d=v1->d1, .t=v1->t1}},
+		.window=v1->window,
+		.period_us=v1->period_us,
+		.osr_shift=v1->osr_shift,
+		.median=v1->median,
+		.filter=v1->filter,
+		.stages=v1->stages,
+		.cutoff_hz=v1->cutoff_hz
+	};
+}
 
-	nvs_close(handle);
-	return pdTRUE;
+/**
+ * The calibration points were raw codes before CFG_VERSION 3
+ */
+static inline uint16_t code_to_mv(uint8_t ch, uint16_t d) {
+	return ad_channel[ch].mv[MIN(d, AD_MV_CODES-1)];
 }
 
-#define CHECK_RES(res,msg)     	\
-	do {				   		\
-		if (res!=ESP_OK) { 		\
-			ESP_LOGE(TAG, msg); \
-			return pdFAIL;		\
-		}						\
-	} while(0)
+/**
+ * Reads the per-key u16 values of the firmware before the blob, t0 and t1
+ * were stored in 1/100 degrees.
+ */
+static void cfg_load_legacy(ad_hal_store_t handle, cfg_image_t *img) {
+	char key[AD_HAL_KEY_SIZE];
+	uint16_t v;
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch) {
+		cfg_channel_t *c=&img->ch[ch];
+		for(int i=0; i<2; ++i) {
+			snprintf(key, sizeof(key), "d%d%d", i, ch);
+			if (ad_hal_store_get_u16(handle, key, &v)==ESP_OK)
+				c->point[i].d=code_to_mv(ch, v);
+			snprintf(key, sizeof(key), "t%d%d", i, ch);
+			if (ad_hal_store_get_u16(handle, key, &v)==ESP_OK)
+				c->point[i].t=v/100.0f;
+		}
+		snprintf(key, sizeof(key), "win%d", ch);
+		if (ad_hal_store_get_u16(handle, key, &v)==ESP_OK)
+			c->window=v;
+	}
+}
 
+/**
+ * Checks a stored image of len bytes and takes the channels both builds
+ * have into img, an image of another channel count keeps its first
+ * channels, the others stay at the defaults.
+ */
+static BaseType_t cfg_parse(const cfg_image_t *stored, size_t len, cfg_image_t *img) {
+	uint32_t crc;
+	if (len<cfg_size(CFG_VERSION, 0) || stored->version<1 || stored->version>CFG_VERSION
+			|| len!=cfg_size(stored->version, stored->channels)) {
+		ESP_LOGW(TAG, "configuration version %d of %u bytes is not supported", stored->version, (unsigned) len);
+		return pdFAIL;
+	}
+	memcpy(&crc, (const uint8_t *) stored+len-sizeof(crc), sizeof(crc));
+	if (crc!=cfg_crc(stored, len)) {
+		ESP_LOGW(TAG, "configuration CRC error");
+		return pdFAIL;
+	}
+	uint8_t channels=MIN(stored->channels, MAX_CHANNELS);
+	if (stored->channels!=MAX_CHANNELS)
+		ESP_LOGW(TAG, "configuration of %d channels, %d used", stored->channels, channels);
+	if (stored->version==1)
+		for(uint8_t ch=0; ch<channels; ++ch)
+			cfg_upgrade_v1((const cfg_channel_v1_t *) stored->ch+ch, &img->ch[ch]);
+	else
+		memcpy(img->ch, stored->ch, channels*sizeof(cfg_channel_t));
+
+	if (stored->version<3)
+		for(uint8_t ch=0; ch<channels; ++ch)
+			for(int i=0; i<MIN(img->ch[ch].points, CAL_MAX_POINTS); ++i)
+				img->ch[ch].point[i].d=code_to_mv(ch, img->ch[ch].point[i].d);
+	return pdPASS;
+}
 
-//!!! pass channel index to function & use it
-static BaseType_t save_cal_to_flash(uint8_t ch) {
-	
-	if(check_channel(ch)!=pdPASS) return pdFAIL;
-	ESP_LOGI(TAG, "Enter save_cal_to_flash");
-	nvs_handle_t handle;
-	esp_err_t res=nvs_open(TAG, NVS_READWRITE, &handle);
-	if(res!=ESP_OK) {
-		ESP_LOGE(TAG, "Cannot open flash for write");
+/**
+ * Reads the image with the length the store reports, so an image written
+ * with another AD_CHANNEL_COUNT is still read. Missing channels and a
+ * missing, old or corrupt image fall back to the defaults. The crc of img
+ * is set only if img is the image in the flash, 0 if the next save must
+ * write it.
+ */
+static BaseType_t cfg_load(cfg_image_t *img) {
+	img->version=CFG_VERSION;
+	img->channels=MAX_CHANNELS;
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch)
+		cfg_default(ch, &img->ch[ch]);
+
+	ad_hal_store_t handle;
+	if (ad_hal_store_open(&handle, 0)!=ESP_OK)
 		return pdFAIL;
+
+	size_t len=0;
+	cfg_image_t *stored=NULL;
+	esp_err_t res=ad_hal_store_get_blob(handle, K_CFG, NULL, &len);
+	if (res==ESP_OK) {
+		stored=malloc(len);
+		res=stored ? ad_hal_store_get_blob(handle, K_CFG, stored, &len) : ESP_ERR_NO_MEM;
 	}
+	if (res==ESP_ERR_NVS_NOT_FOUND)
+		cfg_load_legacy(handle, img);
+	ad_hal_store_close(handle);
+
+	BaseType_t result=res==ESP_OK ? cfg_parse(stored, len, img) : pdFAIL;
+	//img equals the flash only if nothing was upgraded, saving it again is skipped
+	img->crc=result==pdPASS && stored->version==CFG_VERSION && stored->channels==MAX_CHANNELS
+			? cfg_crc(img, len) : 0;
+	free(stored);
+	return result;
+}
 
-	res=nvs_set_u16(handle, KEYD0[ch], ad_channel[ch].calibration.d0);
-	CHECK_RES(res, "Cannot write d0");
+static void cfg_capture(uint8_t ch, cfg_channel_t *c) {
+	const ad_struct *a=&ad_channel[ch];
+	*c=(cfg_channel_t) {
+		.points=a->calibration.points,
+		.window=ad_kernel.avg_window[ch],
+		.period_us=a->sched.period_us,
+		.osr_shift=a->osr.shift,
+		.median=a->median.window,
+		.filter=a->iir.type,
+		.stages=a->iir.stages,
+		.cutoff_hz=a->iir.cutoff_hz
+	};
+	memcpy(c->point, a->calibration.point, sizeof(c->point));
+}
 
-	res=nvs_set_u16(handle, KEYD1[ch], ad_channel[ch].calibration.d1);
-	CHECK_RES(res, "Cannot write d1");
+/**
+ * Invalid fields keep the defaults, the filter is set after the period as
+ * its coefficients depend on the sample rate.
+ */
+static void cfg_apply(uint8_t ch, const cfg_channel_t *c) {
+	calibration_t *cal=&ad_channel[ch].calibration;
+	memcpy(cal->point, c->point, sizeof(cal->point));
+	cal->points=c->points;
+	cal->calibrated=validate_calibration(ch);
+	update_conversion(ch);
 
-	res=nvs_set_u16(handle, KEYT0[ch], ad_channel[ch].calibration.t0*100);
-	CHECK_RES(res, "Cannot write t0");
+	set_avg_window(ch, valid_window(c->window) ? c->window : CHANNELS[ch].window, ad_channel[ch].filtered);
+	set_period(ch, valid_period(c->period_us) ? c->period_us : CHANNELS[ch].period_us);
 
-	res=nvs_set_u16(handle, KEYT1[ch], ad_channel[ch].calibration.t1*100);
-	CHECK_RES(res, "Cannot write t1");
+	ad_channel[ch].osr.shift=c->osr_shift<=MAX_OSR_SHIFT ? c->osr_shift : 0;
+	ad_channel[ch].osr.count=0;
+	ad_channel[ch].osr.acc=0;
 
-	res=nvs_set_u16(handle, KEYTGA[ch], ad_channel[ch].calibration.tga*100);
-	CHECK_RES(res, "Cannot write tga");
+	if (!ad_median_init(&ad_channel[ch].median, c->median))
+		ad_median_init(&ad_channel[ch].median, 0);
 
-	nvs_close(handle);
-	return pdTRUE;
+	if (c->filter>=AD_FILTER_MAX || set_filter(ch, c->filter, c->stages, c->cutoff_hz)!=pdPASS)
+		set_filter(ch, AD_FILTER_NONE, 0, 0);
+}
+
+static BaseType_t restore_cfg_from_flash() {
+	ESP_LOGI(TAG, "Enter restore_cfg_from_flash");
+	BaseType_t res=cfg_load(&cfg_stored);
+	if (res!=pdPASS)
+		ESP_LOGI(TAG, "No valid configuration in flash, using defaults");
+
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch)
+		cfg_apply(ch, &cfg_stored.ch[ch]);
+
+	return res;
+}
+
+/**
+ * Writes the configuration of every channel as one blob with one commit,
+ * skipped if it equals the image in the flash.
+ */
+static BaseType_t save_cfg_to_flash() {
+	ESP_LOGI(TAG, "Enter save_cfg_to_flash");
+	static cfg_image_t img;
+	img.version=CFG_VERSION;
+	img.channels=MAX_CHANNELS;
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch)
+		cfg_capture(ch, &img.ch[ch]);
+	size_t len=cfg_size(CFG_VERSION, MAX_CHANNELS);
+	img.crc=cfg_crc(&img, len);
+
+	if (!memcmp(&img, &cfg_stored, len)) {
+		ESP_LOGI(TAG, "Configuration unchanged");
+		return pdPASS;
+	}
+
+	ad_hal_store_t handle;
+	esp_err_t res=ad_hal_store_open(&handle, 1);
+	if (res!=ESP_OK) {
+		ESP_LOGE(TAG, "Cannot open flash for write");
+		return pdFAIL;
+	}
+	res=ad_hal_store_set_blob(handle, K_CFG, &img, len);
+	ad_hal_store_close(handle);
+	if (res!=ESP_OK) {
+		ESP_LOGE(TAG, "Cannot write configuration:%s", esp_err_to_name(res));
+		return pdFAIL;
+	}
+	cfg_stored=img;
+	return pdPASS;
 }
 
 BaseType_t ad_init(){
 	esp_log_level_set(TAG, ESP_LOG_LOCAL_LEVEL);
-	ad_sem=xSemaphoreCreateBinary();
+	ad_sem=xSemaphoreCreateMutex();
 	configASSERT(ad_sem);
-	xSemaphoreGive(ad_sem);
 
 	bzero(&ad_channel, sizeof(ad_struct));
 
+	//the frame modes map a result to its channel by pin, a duplicate would starve one
+	for(int ch=0;ch<MAX_CHANNELS;ch++)
+		for(int other=0;other<ch;other++)
+			if (CHANNELS[ch].pin==CHANNELS[other].pin) {
+				ESP_LOGE(TAG, "Channels %d and %d are both on ADC1 channel %d", other, ch, CHANNELS[ch].pin);
+				return pdFAIL;
+			}
+
 	//!!! Init every channels
 	adc1_config_width(ADC_WIDTH_BIT_12);
-	for(int ch=0;ch<MAX_CHANNELS;ch++){
-	adc1_config_channel_atten(array_channels[ch], ADC_ATTEN_DB_6);
-	uint16_t ad=adc1_get_raw(array_channels[ch]);
-	ad_channel[ch].moving_hyst.hyst_max=ad+MOVING_HYST_DELTA;
-	ad_channel[ch].moving_hyst.hyst_min=ad-MOVING_HYST_DELTA;
-	ad_channel[ch].moving_hyst.hyst_delta=MOVING_HYST_DELTA;
-	for(int i=0;i<MOVING_AVG_SIZE;++i)
-		ad_channel[ch].moving_avg.queue[i]=ad;
+	for(int ch=0;ch<MAX_CHANNELS;ch++)
+		adc1_config_channel_atten(CHANNELS[ch].pin, CHANNELS[ch].atten);
+
+	if (ad_history_init(MAX_CHANNELS)!=pdPASS)
+		return pdFAIL;
 
-	ad_channel[ch].running=0;
-	restore_cal_from_flash(ch);
+#if !CONFIG_AD_ACQ_POLLING
+	adc_channel_t pins[MAX_CHANNELS];
+	adc_atten_t attens[MAX_CHANNELS];
+	for(int ch=0;ch<MAX_CHANNELS;ch++) {
+		pins[ch]=(adc_channel_t) CHANNELS[ch].pin;
+		attens[ch]=CHANNELS[ch].atten;
+	}
+	if (ad_dma_init(pins, attens, MAX_CHANNELS)!=pdPASS || prime_frame()!=pdPASS) {
+		ESP_LOGE(TAG, "Cannot start frame acquisition");
+		return pdFAIL;
+	}
+#endif
+
+	for(int ch=0;ch<MAX_CHANNELS;ch++){
+	ad_channel[ch].mv=ad_mv_table(CHANNELS[ch].atten);
+	if (!ad_channel[ch].mv) {
+		ESP_LOGE(TAG, "Cannot allocate the mV table of channel %d", ch);
+		return pdFAIL;
+	}
+	uint16_t ad=ad_mv_lookup(ad_channel[ch].mv, read_raw(ch)<<MV_Q);
+	ad_kernel_seed(&ad_kernel, ch, ad);
+
+	ad_channel[ch].filtered=ad;
+	ad_channel[ch].normalized=Q_ROUND(ad);
+	ad_channel[ch].calibration.lut=malloc(LUT_SIZE*sizeof(int32_t));
+	if (!ad_channel[ch].calibration.lut) {
+		ESP_LOGE(TAG, "Cannot allocate the lookup table of channel %d", ch);
+		return pdFAIL;
+	}
+	}
+	restore_cfg_from_flash();
+	for(int ch=0;ch<MAX_CHANNELS;ch++) {
+		ad_channel[ch].sched.adaptive=CHANNELS[ch].adaptive;
+		set_running(ch, CHANNELS[ch].running);
 	}
 	
+#if CONFIG_AD_ACQ_POLLING
+	esp_timer_create_args_t timer_args = {
+		.callback=fn_timer,
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+		.dispatch_method=ESP_TIMER_ISR,
+#endif
+		.name="adc"
+	};
+	ESP_ERROR_CHECK(esp_timer_create(&timer_args, &ad_timer));
+#endif
 
+	configASSERT(ad_log_init());
+	configASSERT(ad_alarm_init());
+	ad_log_set_rate(TAG, CONFIG_AD_LOG_RATE);
+	configASSERT(ad_stream_init());
 	register_cmd();
-	configASSERT(xTaskCreate(fn_ad, "adc", STACK_SIZE, NULL, uxTaskPriorityGet(NULL), &ad_tsk));
+#if CONFIG_AD_PIPELINE
+	ad_ring_init(&ad_ring);
+	configASSERT(xTaskCreatePinnedToCore(fn_proc, "adc_proc", STACK_SIZE, NULL, PROC_PRIORITY, &proc_tsk, CONFIG_AD_PROC_CORE));
+#endif
+	configASSERT(xTaskCreatePinnedToCore(fn_ad, "adc", STACK_SIZE, NULL, CONFIG_AD_TASK_PRIORITY, &ad_tsk, TASK_CORE));
 	return pdPASS;
 }
 
@@ -321,12 +1335,10 @@ BaseType_t ad_get(uint16_t *value, TickType_t ticks,uint8_t ch){
 	if(!value || !ad_channel[ch].running)
 		return pdFAIL;
 
-	if (xSemaphoreTake(ad_sem, ticks)) {
-		*value=ad_channel[ch].normalized;
-		xSemaphoreGive(ad_sem);
-		return pdPASS;
-	}
-	return pdFAIL;
+	ad_value_t v;
+	read_published(ch, &v);
+	*value=v.normalized;
+	return pdPASS;
 }
 
 //!!! pass channel index to function & use it
@@ -335,18 +1347,82 @@ if(check_channel(ch)!=pdPASS) return pdFAIL;
 	if(!value || !ad_channel[ch].running)
 		return pdFAIL;
 
-	if (xSemaphoreTake(ad_sem, ticks)) {
-		*value=ad_channel[ch].temperature;
-		xSemaphoreGive(ad_sem);
-		return pdPASS;
+	ad_value_t v;
+	read_published(ch, &v);
+	*value=TEMP_TO_FLOAT(v.temperature);
+	return pdPASS;
+}
+
+BaseType_t ad_get_all(ad_snapshot_t *snapshot) {
+	if (!snapshot)
+		return pdFAIL;
+
+	uint32_t seq;
+	do {
+		seq=ad_seqlock_read_begin(&ad_scan_pub.seq);
+		const ad_scan_t *scan=&ad_scan_pub.buf[seq&1];
+		snapshot->scan=scan->scan;
+		for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch) {
+			snapshot->ch[ch].running=scan->ch[ch].running;
+			snapshot->ch[ch].raw=scan->ch[ch].raw;
+			snapshot->ch[ch].normalized=scan->ch[ch].normalized;
+			snapshot->ch[ch].temperature=TEMP_TO_FLOAT(scan->ch[ch].temperature);
+			snapshot->ch[ch].seq=scan->ch[ch].seq;
+			snapshot->ch[ch].timestamp=scan->ch[ch].timestamp;
+		}
+	} while (ad_seqlock_read_retry(&ad_scan_pub.seq, seq));
+
+	return seq ? pdPASS : pdFAIL;
+}
+
+BaseType_t ad_get_timing(uint8_t ch, ad_timing_t *timing) {
+	if(check_channel(ch)!=pdPASS || !timing) return pdFAIL;
+	const ad_sched_t *sched=&ad_channel[ch].sched;
+	timing->period_us=sched->period_us;
+	timing->effective_us=sched->effective_us;
+	timing->measured_us=sched->measured_us;
+	timing->jitter_avg_us=sched->jitter_avg_us;
+	timing->jitter_max_us=sched->jitter_max_us;
+	timing->overruns=sched->overruns;
+	memcpy(timing->hist, sched->hist, sizeof(timing->hist));
+	return pdPASS;
+}
+
+BaseType_t ad_get_stats(ad_stats_t *stats) {
+	if (!stats || !ad_tsk)
+		return pdFAIL;
+
+	*stats=ad_task_stats;
+	stats->stack_free=uxTaskGetStackHighWaterMark(ad_tsk);
+#if CONFIG_AD_PIPELINE
+	stats->ring_size=AD_RING_SIZE;
+	stats->ring_used=ad_ring_used(&ad_ring);
+	stats->ring_max=ad_ring.max_used;
+	stats->ring_overflows=ad_ring.overflows;
+	stats->proc_stack_free=uxTaskGetStackHighWaterMark(proc_tsk);
+#endif
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch) {
+		stats->ch[ch]=ad_channel[ch].stats;
+		stats->ch[ch].skipped+=ad_channel[ch].dropped;
+		stats->ch[ch].updates=ad_channel[ch].updates;
+		stats->ch[ch].overruns=ad_channel[ch].sched.overruns;
 	}
-	return pdFAIL;
+	return pdPASS;
 }
 
 BaseType_t ad_deinit(uint8_t ch){
 	if(check_channel(ch)!=pdPASS) return pdFAIL;
-	ad_channel[ch].running=0;
+	set_running(ch, 0);
 	vTaskDelete(ad_tsk);
+#if CONFIG_AD_ACQ_POLLING
+#if CONFIG_AD_PIPELINE
+	vTaskDelete(proc_tsk);
+#endif
+	esp_timer_stop(ad_timer);
+	esp_timer_delete(ad_timer);
+#else
+	ad_dma_deinit();
+#endif
 	vSemaphoreDelete(ad_sem);
 	ESP_LOGI(TAG, "ADC deinit");
 	return pdTRUE;
@@ -363,6 +1439,14 @@ BaseType_t ad_deinit(uint8_t ch){
  ad --start
  ad --stop
  ad --ch <ch_num
+ ad --window <n>
+ ad --period <us>
+ ad --osr <n>
+ ad --osrcost
+ ad --median <n>
+ ad --filter <none|ema|biquad> --fc <hz> --stages <n>
+ ad --dump <n>
+ ad --stream <on|off|stat>
  */
 
 #define CMD "ad"
@@ -374,20 +1458,48 @@ static void help() {
 //!!! pass channel index to function & use it
 static void status(uint8_t ch ) {
 if(check_channel(ch)!=pdPASS) return ;
-	printf("ad_channel[ch].running:%s raw value:%d, normalized:%d\r\n",
-			ad_channel[ch].running?"true":"false", ad_channel[ch].raw, ad_channel[ch].normalized);
-	printf("hysteresis min:%d, max:%d, delta:%d\r\n",
-			ad_channel[ch].moving_hyst.hyst_min,
-			ad_channel[ch].moving_hyst.hyst_max,
-			ad_channel[ch].moving_hyst.hyst_delta);
-	printf("moving average: index:%d, queue\r\n", ad_channel[ch].moving_avg.idx);
-	for(int i=0; i<MOVING_AVG_SIZE; i++)
-		printf("%d:%d\r\n", i, ad_channel[ch].moving_avg.queue[i]);
-
-	printf("calibration: calibrated:%s, d0:%d, d1:%d, t0:%f, t1:%f, tga:%f\r\n",
+	printf("ad_channel[ch].running:%s raw value:%.4f (%dmV), normalized:%.4fmV\r\n",
+			ad_channel[ch].running?"true":"false", MV_TO_FLOAT(ad_channel[ch].raw_q), ad_channel[ch].raw_mv,
+			MV_TO_FLOAT(ad_channel[ch].filtered));
+	printf("pin:ADC1_CH%d, attenuation:%s, characterization: %s, %u bytes of tables\r\n",
+			CHANNELS[ch].pin, ATTEN_NAMES[CHANNELS[ch].atten],
+			ad_mv_source_name(CHANNELS[ch].atten), (unsigned) ad_mv_bytes());
+	printf("hysteresis min:%.4f, max:%.4f, delta:%.4f (%d..%d), noise |diff|:%fmV\r\n",
+			MV_TO_FLOAT(ad_kernel.hyst_min[ch]),
+			MV_TO_FLOAT(ad_kernel.hyst_max[ch]),
+			MV_TO_FLOAT(ad_kernel.hyst_delta[ch]),
+			CONFIG_AD_HYST_MIN_DELTA, CONFIG_AD_HYST_MAX_DELTA,
+			MV_TO_FLOAT((float) ad_kernel.noise[ch]/(1<<AD_KERNEL_NOISE_Q)));
+	printf("moving average: window:%d%s, index:%d, sum:%u\r\n",
+			ad_kernel.avg_window[ch],
+			ad_kernel.avg_shift[ch]>=0?" (shift)":"",
+			ad_kernel.avg_idx[ch],
+			ad_kernel.avg_sum[ch]);
+
+	printf("calibration: calibrated:%s, points:%d of %d\r\n",
 			ad_channel[ch].calibration.calibrated?"true":"false",
-			ad_channel[ch].calibration.d0, ad_channel[ch].calibration.d1,
-			ad_channel[ch].calibration.t0, ad_channel[ch].calibration.t1, ad_channel[ch].calibration.tga);
+			ad_channel[ch].calibration.points, CAL_MAX_POINTS);
+	for(int i=0; i<ad_channel[ch].calibration.points; ++i)
+		printf("  %d: d:%d, t:%f\r\n", i,
+				ad_channel[ch].calibration.point[i].d, ad_channel[ch].calibration.point[i].t);
+	printf("conversion: lookup table of %d codes, %u bytes per channel, temperature:%f\r\n",
+			LUT_SIZE, (unsigned) (LUT_SIZE*sizeof(int32_t)), TEMP_TO_FLOAT(ad_channel[ch].temperature));
+	printf("median: %s, window:%d\r\n",
+			ad_channel[ch].median.window?"on":"off", ad_channel[ch].median.window);
+	printf("filter: %s, stages:%d, cutoff:%fHz, sample rate:%fHz\r\n",
+			ad_iir_name(ad_channel[ch].iir.type), ad_channel[ch].iir.stages,
+			ad_channel[ch].iir.cutoff_hz, sample_hz(ch));
+	printf("history: %u of %d records, %u bytes for all channels\r\n",
+			ad_history_count(ch), CONFIG_AD_HISTORY_SIZE, (unsigned) ad_history_bytes());
+	printf("oversampling: %dx, last burst:%u cycles\r\n",
+			1<<ad_channel[ch].osr.shift, ad_channel[ch].osr.cycles);
+	printf("adaptive: %s, back off:%dx, effective period:%uus (%fHz)\r\n",
+			ad_channel[ch].sched.adaptive?"on":"off", 1<<ad_channel[ch].sched.backoff,
+			ad_channel[ch].sched.effective_us, 1000000.0f/ad_channel[ch].sched.effective_us);
+	printf("timing: period:%uus, measured:%uus, jitter avg:%uus, max:%uus, overruns:%u\r\n",
+			ad_channel[ch].sched.period_us, ad_channel[ch].sched.measured_us,
+			ad_channel[ch].sched.jitter_avg_us, ad_channel[ch].sched.jitter_max_us,
+			ad_channel[ch].sched.overruns);
 
 			
 
@@ -395,33 +1507,340 @@ if(check_channel(ch)!=pdPASS) return ;
 }
 
 //!!! pass channel index to function & use it
+/**
+ * Captures the current code of the channel as point tempidx, a point can
+ * replace an existing one or be appended after the last.
+ */
 static void calibrate(int tempidx, float value,uint8_t ch) {
 if(check_channel(ch)!=pdPASS) return;
-	if (tempidx<0||tempidx>1||value<MIN_TEMP||value>MAX_TEMP) {
+	calibration_t *cal=&ad_channel[ch].calibration;
+	if (tempidx<0||tempidx>MIN(cal->points, CAL_MAX_POINTS-1)||value<MIN_TEMP||value>MAX_TEMP) {
 		printf("calibrate param error tempidx:%d, value:%f\r\n", tempidx, value);
 		return;
 	}
-	if (tempidx==0) {
-		ad_channel[ch].calibration.t0=value;
-		ad_channel[ch].calibration.d0=adc1_get_raw(array_channels[ch]);
+	xSemaphoreTake(ad_sem, portMAX_DELAY);
+	uint16_t d=ad_channel[ch].mv[read_raw(ch)];
+	int other=find_point(cal, d, tempidx);
+	if (other>=0) {
+		xSemaphoreGive(ad_sem);
+		printf("%dmV is already point %d\r\n", d, other);
+		return;
+	}
+	cal->point[tempidx]=(cal_point_t) {.d=d, .t=value};
+	if (tempidx==cal->points)
+		++cal->points;
+	update_conversion(ch);
+	xSemaphoreGive(ad_sem);
+}
+
+static void reset_calibration(uint8_t ch) {
+	xSemaphoreTake(ad_sem, portMAX_DELAY);
+	default_calibration(&ad_channel[ch].calibration);
+	ad_channel[ch].calibration.calibrated=0;
+	update_conversion(ch);
+	xSemaphoreGive(ad_sem);
+}
+
+/**
+ * Prints the last n records of the channel, the ring is copied first so
+ * acquisition goes on while the UART is busy.
+ */
+static BaseType_t dump(uint8_t ch, int n) {
+	if (n<=0 || n>CONFIG_AD_HISTORY_SIZE) {
+		printf("dump size must be 1..%d\r\n", CONFIG_AD_HISTORY_SIZE);
+		return pdFAIL;
+	}
+	ad_record_t *records=malloc(n*sizeof(ad_record_t));
+	if (!records) {
+		printf("Cannot allocate %d records\r\n", n);
+		return pdFAIL;
 	}
-	else {
-		ad_channel[ch].calibration.t1=value;
-		ad_channel[ch].calibration.d1=adc1_get_raw(array_channels[ch]);
+	n=ad_history_read(ch, records, n);
+	printf("channel:%d, records:%d\r\ntimestamp;raw;filtered\r\n", ch, n);
+	for(int i=0; i<n; ++i)
+		printf("%u;%d;%d\r\n", records[i].timestamp, records[i].raw, records[i].filtered);
+
+	free(records);
+	return pdPASS;
+}
+
+/**
+ * Prints the histogram of |measured-period| of the channel
+ */
+static void timing(uint8_t ch) {
+	ad_timing_t t;
+	if (ad_get_timing(ch, &t)!=pdPASS)
+		return;
+
+	printf("task: core:%d, priority:%d\r\n", TASK_CORE==tskNO_AFFINITY ? -1 : TASK_CORE, (int) uxTaskPriorityGet(ad_tsk));
+#if CONFIG_AD_PIPELINE
+	printf("processing task: core:%d, priority:%d\r\n", CONFIG_AD_PROC_CORE, (int) uxTaskPriorityGet(proc_tsk));
+#endif
+#if CONFIG_AD_ACQ_POLLING
+	printf("timer dispatch:%s, lead:%dus\r\n",
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+			"isr",
+#else
+			"task",
+#endif
+			CONFIG_AD_TIMER_LEAD_US);
+#endif
+	printf("channel:%d, period:%uus, effective:%uus, measured:%uus, jitter avg:%uus, max:%uus, overruns:%u\r\n",
+			ch, t.period_us, t.effective_us, t.measured_us, t.jitter_avg_us, t.jitter_max_us, t.overruns);
+	uint32_t total=0;
+	for(int b=0; b<AD_TIMING_BINS; ++b)
+		total+=t.hist[b];
+
+	for(int b=0; b<AD_TIMING_BINS; ++b) {
+		if (!t.hist[b])
+			continue;
+
+		if (!b)
+			printf("%8s", "0us");
+		else if (b==AD_TIMING_BINS-1)
+			printf("%6u+us", 1u<<(b-1));
+		else
+			printf("%6u-%uus", 1u<<(b-1), (1u<<b)-1);
+		printf(" %10u %5.1f%%\r\n", t.hist[b], 100.0*t.hist[b]/total);
 	}
 }
 
+#define BENCH_MAX (1000)
+
+/**
+ * Stages of ad --bench, the filter stages first
+ */
+enum {
+	BENCH_CONVERT=STAGE_FILTER_MAX,
+	BENCH_LOCK,
+	BENCH_LOG,
+	BENCH_TOTAL,
+	BENCH_STAGES
+};
+
+static const char *STAGE_NAMES[BENCH_STAGES]={
+	"mV", "median", "hyst", "avg", "iir", "temp", "history", "alarm", "publish",
+	"convert", "lock", "log", "total"
+};
+
+static int cmp_cycles(const void *a, const void *b) {
+	uint32_t x=*(const uint32_t *) a, y=*(const uint32_t *) b;
+	return x<y ? -1 : x>y;
+}
+
+/**
+ * Runs the sample path of the channel n times back to back and prints the
+ * cycles of every stage. The run works on a scratch copy of the channels and
+ * of the kernel taken under ad_sem, so the live filters, the history, the
+ * alarms and the published values never see a bench sample, the history and
+ * alarm stages are left out. The ADC task keeps running and can preempt the
+ * bench, max shows it. convert is a burst of the oversampling ratio, lock is an
+ * uncontended take and give of a mutex.
+ */
+static BaseType_t bench(uint8_t ch, int n) {
+	if (n<=0 || n>BENCH_MAX) {
+		printf("bench iterations must be 1..%d\r\n", BENCH_MAX);
+		return pdFAIL;
+	}
+	uint32_t *cycles=malloc(BENCH_STAGES*n*sizeof(uint32_t));
+	ad_struct *scratch=malloc(sizeof(ad_channel));
+	ad_kernel_t *kernel=malloc(sizeof(ad_kernel_t));
+	SemaphoreHandle_t sem=xSemaphoreCreateMutex();
+	if (!cycles || !scratch || !kernel || !sem) {
+		printf("Cannot allocate the bench of %d iterations\r\n", n);
+		free(cycles);
+		free(scratch);
+		free(kernel);
+		if (sem)
+			vSemaphoreDelete(sem);
+		return pdFAIL;
+	}
+
+	xSemaphoreTake(ad_sem, portMAX_DELAY);
+	for(uint8_t c=0; c<MAX_CHANNELS; ++c) {
+		scratch[c]=ad_channel[c];
+		ad_median_copy(&scratch[c].median, &ad_channel[c].median);
+	}
+	*kernel=ad_kernel;
+	xSemaphoreGive(ad_sem);
+
+	uint32_t stamps[STAGE_FILTER_MAX];
+	int64_t ts[MAX_CHANNELS];
+#if !CONFIG_AD_ACQ_POLLING
+	uint16_t raw=scratch[ch].raw;
+#endif
+	int64_t start=ad_hal_time_us();
+	for(int i=0; i<n; ++i) {
+		uint32_t t0=ad_hal_cycles();
+#if CONFIG_AD_ACQ_POLLING
+		scratch[ch].raw_q=read_burst(ch, &scratch[ch].osr);
+#else
+		while (!decimate(&scratch[ch].osr, raw, &scratch[ch].raw_q))
+			;
+#endif
+		uint32_t t1=ad_hal_cycles();
+		xSemaphoreTake(sem, portMAX_DELAY);
+		xSemaphoreGive(sem);
+		ts[ch]=ad_hal_time_us();
+		uint32_t t2=ad_hal_cycles();
+		filter_scan(scratch, kernel, 1u<<ch, ts, stamps);
+		AD_LOGI(TAG,"ch:%d raw:%d, normalized:%d ", ch, scratch[ch].raw, scratch[ch].normalized);
+		uint32_t t3=ad_hal_cycles();
+
+		cycles[BENCH_CONVERT*n+i]=t1-t0;
+		cycles[BENCH_LOCK*n+i]=t2-t1;
+		uint32_t prev=t2;
+		for(int s=0; s<STAGE_FILTER_MAX; ++s) {
+			cycles[s*n+i]=stamps[s]-prev;
+			prev=stamps[s];
+		}
+		cycles[BENCH_LOG*n+i]=t3-prev;
+		cycles[BENCH_TOTAL*n+i]=t3-t0;
+	}
+	int64_t elapsed=ad_hal_time_us()-start;
+
+	//the filter stages of every channel of the copy, one channel at a time and as one scan
+	uint32_t all=(1u<<MAX_CHANNELS)-1;
+	for(uint8_t c=0; c<MAX_CHANNELS; ++c)
+		ts[c]=ad_hal_time_us();
+	uint32_t t0=ad_hal_cycles();
+	for(int i=0; i<n; ++i)
+		AD_KERNEL_FOR_EACH(c, all)
+			filter_scan(scratch, kernel, 1u<<c, ts, NULL);
+	uint32_t single=ad_hal_cycles()-t0;
+	t0=ad_hal_cycles();
+	for(int i=0; i<n; ++i)
+		filter_scan(scratch, kernel, all, ts, NULL);
+	uint32_t batch=ad_hal_cycles()-t0;
+
+	vSemaphoreDelete(sem);
+	free(scratch);
+	free(kernel);
+
+	printf("channel:%d, iterations:%d, %lldus, %.0f samples/s\r\n",
+			ch, n, (long long) elapsed, elapsed>0 ? n*1e6/elapsed : 0.0);
+	printf("filter of %d channels: %u cycles per channel one at a time, %u in one scan\r\n",
+			MAX_CHANNELS, single/(n*MAX_CHANNELS), batch/(n*MAX_CHANNELS));
+	printf("%-8s %8s %8s %8s %8s cycles\r\n", "stage", "min", "mean", "p99", "max");
+	for(int s=0; s<BENCH_STAGES; ++s) {
+		if (s==STAGE_HISTORY || s==STAGE_ALARM)
+			continue;
+
+		uint32_t *c=&cycles[s*n];
+		uint64_t sum=0;
+		for(int i=0; i<n; ++i)
+			sum+=c[i];
+		qsort(c, n, sizeof(uint32_t), cmp_cycles);
+		printf("%-8s %8u %8u %8u %8u\r\n", STAGE_NAMES[s], c[0], (unsigned) (sum/n), c[(n*99+99)/100-1], c[n-1]);
+	}
+	free(cycles);
+	return pdPASS;
+}
+
+#if CONFIG_AD_ACQ_SIMULATED
+/**
+ * spec is shape[,low,high,rate,period,noise], the omitted fields keep their
+ * current values
+ */
+static BaseType_t simulate(uint8_t ch, const char *spec) {
+	const ad_sim_config_t *current=ad_dma_sim_get(ch);
+	if (!current)
+		return pdFAIL;
+
+	ad_sim_config_t config=*current;
+	char name[16];
+	unsigned low=config.low, high=config.high, rate=config.rate, period=config.period, noise=config.noise;
+	if (sscanf(spec, "%15[^,],%u,%u,%u,%u,%u", name, &low, &high, &rate, &period, &noise)<1)
+		return pdFAIL;
+
+	config.shape=0;
+	while (config.shape<AD_SIM_SHAPE_MAX && strcasecmp(name, ad_sim_name(config.shape)))
+		++config.shape;
+	config.low=low;
+	config.high=high;
+	config.rate=rate;
+	config.period=period;
+	config.noise=noise;
+	if (ad_dma_sim_config(ch, &config)!=pdPASS) {
+		printf("sim must be triangle|ramp|noise|spikes|steps[,low,high,rate,period,noise], low<=high<%d\r\n",
+				AD_SIM_CODES);
+		return pdFAIL;
+	}
+	printf("channel:%d, %s, low:%u, high:%u, rate:%u, period:%u, noise:%u\r\n",
+			ch, ad_sim_name(config.shape), low, high, rate, period, noise);
+	return pdPASS;
+}
+#endif
+
+static void stats() {
+	ad_stats_t st;
+	if (ad_get_stats(&st)!=pdPASS)
+		return;
+
+	printf("loops:%u, busy avg:%uus, max:%uus, stack free:%u bytes\r\n",
+			st.loops, st.loop_avg_us, st.loop_max_us, st.stack_free);
+	printf("lock wait avg:%uus, max:%uus, timeouts:%u\r\n",
+			st.lock_avg_us, st.lock_max_us, st.lock_timeouts);
+	if (st.ring_size)
+		printf("ring: %u of %u scans, max:%u, overflows:%u, processing stack free:%u bytes\r\n",
+				st.ring_used, st.ring_size, st.ring_max, st.ring_overflows, st.proc_stack_free);
+	printf("%2s %10s %10s %8s %8s %8s %8s\r\n", "ch", "conv", "updates", "skipped", "overruns", "lat avg", "lat max");
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch)
+		printf("%2d %10u %10u %8u %8u %6uus %6uus\r\n", ch,
+				st.ch[ch].conversions, st.ch[ch].updates, st.ch[ch].skipped, st.ch[ch].overruns,
+				st.ch[ch].latency_avg_us, st.ch[ch].latency_max_us);
+}
+
+static BaseType_t stream(const char *cmd) {
+	if (!strcasecmp(cmd, "on"))
+		return ad_stream_start();
+
+	if (!strcasecmp(cmd, "off"))
+		return ad_stream_stop();
+
+	if (!strcasecmp(cmd, "stat")) {
+		ad_stream_stats_t stats;
+		ad_stream_get_stats(&stats);
+		printf("stream:%s, frames:%u, samples:%u, bytes:%u, lost:%u\r\n",
+				ad_stream_running()?"on":"off", stats.frames, stats.samples, stats.bytes, stats.lost);
+		return pdPASS;
+	}
+	printf("stream must be on, off or stat\r\n");
+	return pdFAIL;
+}
+
 static struct {
 	struct arg_lit *help;
 	struct arg_lit *cal;
 	struct arg_dbl *t0;
 	struct arg_dbl *t1;
+	struct arg_int *point;
+	struct arg_dbl *temp;
+	struct arg_lit *reset;
 	struct arg_lit *save;
 	struct arg_lit *restore;
 	struct arg_lit *state;
 	struct arg_lit *start;
 	struct arg_lit *stop;
 	struct arg_int *channel;
+	struct arg_int *window;
+	struct arg_int *period;
+	struct arg_rex *adaptive;
+	struct arg_int *osr;
+	struct arg_lit *osrcost;
+	struct arg_int *median;
+	struct arg_str *filter;
+	struct arg_dbl *cutoff;
+	struct arg_int *stages;
+	struct arg_int *dump;
+	struct arg_str *stream;
+	struct arg_lit *alarms;
+	struct arg_lit *timing;
+	struct arg_int *bench;
+	struct arg_lit *stats;
+#if CONFIG_AD_ACQ_SIMULATED
+	struct arg_str *sim;
+#endif
 	struct arg_end *end;
 	
 } ad_args;
@@ -439,13 +1858,13 @@ static int cmd_ad(int argc, char **argv) {
 static	uint8_t ch=0;
 
 if(ad_args.channel->count){
-
-	 ch=ad_args.channel->ival[0];
-	if(ch>=MAX_CHANNELS) 
+	//an invalid index keeps the channel of the next commands
+	if(ad_args.channel->ival[0]<0 || ad_args.channel->ival[0]>=MAX_CHANNELS)
 	{
 		printf("ERROR in CHANNLS");
 	return 1;
 	}
+	 ch=ad_args.channel->ival[0];
 	return 0;
 	}
 
@@ -455,7 +1874,8 @@ if(ad_args.channel->count){
 	}
 
 	if (ad_args.start->count) {
-		ad_channel[ch].running=1;
+		set_running(ch, 1);
+		sched_request(ch);
 		printf("AD conversion starting...");
 
 		return 0;
@@ -465,17 +1885,159 @@ if(ad_args.channel->count){
 	
 	if (ad_args.stop->count) {
 		
-		ad_channel[ch].running=0;
+		set_running(ch, 0);
 		printf("AD conversion stopping...");
 		return 0;
 	}
 
+	if (ad_args.window->count) {
+		int window=ad_args.window->ival[0];
+		if (!valid_window(window)) {
+			printf("window must be 1..%d\r\n", CONFIG_AD_AVG_MAX_WINDOW);
+			return 1;
+		}
+		if (!xSemaphoreTake(ad_sem, pdMS_TO_TICKS(100)))
+			return 1;
+
+		set_avg_window(ch, window, ad_channel[ch].filtered);
+		xSemaphoreGive(ad_sem);
+		return 0;
+	}
+
+	if (ad_args.period->count) {
+		int period=ad_args.period->ival[0];
+		if (!valid_period(period)) {
+			printf("period must be %d..%d us\r\n", MIN_PERIOD_US, MAX_PERIOD_US);
+			return 1;
+		}
+		xSemaphoreTake(ad_sem, portMAX_DELAY);
+		set_period(ch, period);
+		xSemaphoreGive(ad_sem);
+		xTaskNotifyGive(ad_tsk);
+		return 0;
+	}
+
+	if (ad_args.adaptive->count) {
+		xSemaphoreTake(ad_sem, portMAX_DELAY);
+		ad_sched_t *sched=&ad_channel[ch].sched;
+		sched->adaptive=!strcmp(ad_args.adaptive->sval[0], "on");
+		if (!sched->adaptive)
+			__atomic_store_n(&sched->backoff, 0, __ATOMIC_RELAXED);
+		xSemaphoreGive(ad_sem);
+		xTaskNotifyGive(ad_tsk);
+		return 0;
+	}
+
+	if (ad_args.osr->count) {
+		int ratio=ad_args.osr->ival[0];
+		uint8_t shift=0;
+		while (shift<MAX_OSR_SHIFT && (1<<shift)<ratio)
+			++shift;
+
+		if (ratio<1 || (1<<shift)!=ratio) {
+			printf("oversampling must be a power of two, 1..%d\r\n", 1<<MAX_OSR_SHIFT);
+			return 1;
+		}
+		xSemaphoreTake(ad_sem, portMAX_DELAY);
+		ad_channel[ch].osr.shift=shift;
+		ad_channel[ch].osr.count=0;
+		ad_channel[ch].osr.acc=0;
+		xSemaphoreGive(ad_sem);
+		return 0;
+	}
+
+	if (ad_args.osrcost->count) {
+		xSemaphoreTake(ad_sem, portMAX_DELAY);
+		for(uint8_t shift=0; shift<=MAX_OSR_SHIFT; ++shift) {
+			uint32_t cycles=burst_cost(ch, shift);
+			printf("%4dx: %8u cycles, %u cycles/conversion\r\n", 1<<shift, cycles, cycles>>shift);
+		}
+		xSemaphoreGive(ad_sem);
+		return 0;
+	}
+
+	if (ad_args.median->count) {
+		int window=ad_args.median->ival[0];
+		if (window && (window<AD_MEDIAN_MIN_WINDOW || window>AD_MEDIAN_MAX_WINDOW)) {
+			printf("median window must be 0 (off) or %d..%d\r\n", AD_MEDIAN_MIN_WINDOW, AD_MEDIAN_MAX_WINDOW);
+			return 1;
+		}
+		xSemaphoreTake(ad_sem, portMAX_DELAY);
+		ad_median_init(&ad_channel[ch].median, window);
+		xSemaphoreGive(ad_sem);
+		return 0;
+	}
+
+	if (ad_args.filter->count) {
+		ad_filter_type_t type=AD_FILTER_NONE;
+		while (type<AD_FILTER_MAX && strcasecmp(ad_args.filter->sval[0], ad_iir_name(type)))
+			++type;
+
+		if (type==AD_FILTER_MAX) {
+			printf("filter must be none, ema or biquad\r\n");
+			return 1;
+		}
+		int stages=ad_args.stages->count ? ad_args.stages->ival[0] : 1;
+		float cutoff=ad_args.cutoff->count ? ad_args.cutoff->dval[0] : ad_channel[ch].iir.cutoff_hz;
+		if (type!=AD_FILTER_NONE && (stages<1 || stages>AD_IIR_MAX_STAGES)) {
+			printf("stages must be 1..%d\r\n", AD_IIR_MAX_STAGES);
+			return 1;
+		}
+		xSemaphoreTake(ad_sem, portMAX_DELAY);
+		BaseType_t res=set_filter(ch, type, stages, cutoff);
+		xSemaphoreGive(ad_sem);
+		if (res!=pdPASS) {
+			printf("cutoff must be above 0 and below %f Hz at %f Hz sample rate\r\n", sample_hz(ch)/2, sample_hz(ch));
+			return 1;
+		}
+		return 0;
+	}
+
+	if (ad_args.dump->count) {
+		return dump(ch, ad_args.dump->ival[0])==pdPASS?0:1;
+	}
+
+	if (ad_args.stream->count) {
+		return stream(ad_args.stream->sval[0])==pdPASS?0:1;
+	}
+
+#if CONFIG_AD_ACQ_SIMULATED
+	if (ad_args.sim->count) {
+		return simulate(ch, ad_args.sim->sval[0])==pdPASS?0:1;
+	}
+#endif
+
+	if (ad_args.stats->count) {
+		stats();
+		return 0;
+	}
+
+	if (ad_args.bench->count) {
+		return bench(ch, ad_args.bench->ival[0])==pdPASS?0:1;
+	}
+
+	if (ad_args.timing->count) {
+		timing(ch);
+		return 0;
+	}
+
+	if (ad_args.alarms->count) {
+		ad_alarm_print();
+		return 0;
+	}
+
 	if (ad_args.save->count) {
-		return save_cal_to_flash(ch)==pdTRUE?0:1;
+		xSemaphoreTake(ad_sem, portMAX_DELAY);
+		BaseType_t res=save_cfg_to_flash();
+		xSemaphoreGive(ad_sem);
+		return res==pdPASS?0:1;
 	}
 
 	if (ad_args.restore->count) {
-		return restore_cal_from_flash(ch)==pdTRUE?0:1;
+		xSemaphoreTake(ad_sem, portMAX_DELAY);
+		BaseType_t res=restore_cfg_from_flash();
+		xSemaphoreGive(ad_sem);
+		return res==pdPASS?0:1;
 	}
 
 	if (ad_args.cal->count) {
@@ -487,7 +2049,15 @@ if(ad_args.channel->count){
 			calibrate(1, ad_args.t1->dval[0],ch);
 			return 0;
 		}
-		printf("Unknown index, 0 or 1 accepted only\r\n");
+		if (ad_args.point->count && ad_args.temp->count) {
+			calibrate(ad_args.point->ival[0], ad_args.temp->dval[0],ch);
+			return 0;
+		}
+		if (ad_args.reset->count) {
+			reset_calibration(ch);
+			return 0;
+		}
+		printf("Unknown index, -0, -1 or --point <n> --temp <t> accepted only\r\n");
 		return 1;
 	}
 
@@ -498,14 +2068,35 @@ if(ad_args.channel->count){
 static void register_cmd() {
 	ad_args.help=arg_lit0("hH", "help", "help for ad");
 	ad_args.cal=arg_lit0("cC", "cal", "Calibration");
-	ad_args.t0=arg_dbl1("0", "t0", "<n>", "t0 temp value");
-	ad_args.t1=arg_dbl1("1", "t1", "<n>", "t1 temp value");
-	ad_args.save=arg_lit0("vV", "save", "save calibration to flash");
-	ad_args.restore=arg_lit0("eE", "restore", "restore calibration from flash");
+	ad_args.t0=arg_dbl0("0", "t0", "<n>", "t0 temp value");
+	ad_args.t1=arg_dbl0("1", "t1", "<n>", "t1 temp value");
+	ad_args.point=arg_int0(NULL, "point", "<n>", "calibration point index, appends after the last");
+	ad_args.temp=arg_dbl0(NULL, "temp", "<t>", "temp value of the point");
+	ad_args.reset=arg_lit0(NULL, "reset", "reset to the default two point calibration");
+	ad_args.save=arg_lit0("vV", "save", "save the configuration of every channel to flash");
+	ad_args.restore=arg_lit0("eE", "restore", "restore the configuration of every channel from flash");
 	ad_args.state=arg_lit0("sS", "stat", "print statistics");
 	ad_args.start=arg_lit0("tT", "start", "start ad conversion");
 	ad_args.stop=arg_lit0("oO", "stop", "stop ad conversion");
 	ad_args.channel=arg_int0("lL","channel","<n>","channel index");
+	ad_args.window=arg_int0("wW","window","<n>","moving average window");
+	ad_args.period=arg_int0("pP","period","<us>","sample period of the channel");
+	ad_args.adaptive=arg_rex0(NULL,"adaptive","^(on|off)$","<on|off>",0,"back off the period while the signal is flat");
+	ad_args.osr=arg_int0("xX","osr","<n>","oversampling ratio, power of two");
+	ad_args.osrcost=arg_lit0(NULL,"osrcost","cycle cost of every burst size");
+	ad_args.median=arg_int0("mM","median","<n>","median window before the hysteresis, 0 is off");
+	ad_args.filter=arg_str0("fF","filter","<none|ema|biquad>","low-pass filter after the moving average");
+	ad_args.cutoff=arg_dbl0(NULL,"fc","<hz>","cutoff frequency of the filter");
+	ad_args.stages=arg_int0(NULL,"stages","<n>","cascaded filter sections");
+	ad_args.dump=arg_int0("dD","dump","<n>","print the last n samples of the history");
+	ad_args.stream=arg_str0(NULL,"stream","<on|off|stat>","binary telemetry of the running channels");
+	ad_args.alarms=arg_lit0(NULL,"alarms","list the alarm subscriptions");
+	ad_args.timing=arg_lit0(NULL,"timing","histogram of the measured sample period");
+	ad_args.stats=arg_lit0(NULL,"stats","health counters of the ADC task and the channels");
+	ad_args.bench=arg_int0(NULL,"bench","<n>","cycles of every stage of the sample path, n iterations");
+#if CONFIG_AD_ACQ_SIMULATED
+	ad_args.sim=arg_str0(NULL,"sim","<shape[,low,high,rate,period,noise]>","signal of the simulated channel");
+#endif
 	ad_args.end=arg_end(0);
  
 	esp_console_cmd_t cmd = {
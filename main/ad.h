@@ -11,20 +11,92 @@
 #include <stdint.h>
 #include "freertos/FreeRTOS.h"
 
-//!!! Define the channel number
-
+//channel table of the AD configuration menu
+#define MAX_CHANNELS (CONFIG_AD_CHANNEL_COUNT)
 
 #define AD_MAX (4096)
 #define AD_MIN (0)
 
+#define AD_TIMING_BINS (16)
+
 BaseType_t ad_init();
 
+/*
+ * Readers never block, they copy the last published value of the channel.
+ * ticks is kept for compatibility only. The value is in mV, converted from
+ * the raw code by the characterization of the chip (ad_mv.h).
+ */
+
 //!!! pass channel index to function & use it
 BaseType_t ad_get(uint16_t *value, TickType_t ticks, uint8_t ch);
 
 //!!! pass channel index to function & use it
 BaseType_t ad_get_temperature(float *value, TickType_t ticks,uint8_t ch);
 
+typedef struct {
+	uint8_t running;
+	uint16_t raw;
+	uint16_t normalized;
+	float temperature;
+	uint32_t seq;		//number of filter updates of the channel
+	int64_t timestamp;	//esp_timer time of the last update, us
+} ad_channel_snapshot_t;
+
+typedef struct {
+	uint32_t scan;		//scan sequence number
+	ad_channel_snapshot_t ch[MAX_CHANNELS];
+} ad_snapshot_t;
+
+/**
+ * @brief copies every channel of the last completed scan
+ * @param snapshot caller-provided buffer
+ * @return pdFAIL if no scan was completed yet
+ */
+BaseType_t ad_get_all(ad_snapshot_t *snapshot);
+
+typedef struct {
+	uint32_t period_us;		//configured sample period
+	uint32_t effective_us;	//period of the adaptive mode, period_us if not backed off
+	uint32_t measured_us;	//last measured sample period
+	uint32_t jitter_avg_us;
+	uint32_t jitter_max_us;
+	uint32_t overruns;		//missed deadlines
+	uint32_t hist[AD_TIMING_BINS];	//|measured-period|, bin 0: 0us, bin b: 2^(b-1)..2^b-1us, the last bin is open
+} ad_timing_t;
+
+BaseType_t ad_get_timing(uint8_t ch, ad_timing_t *timing);
+
+typedef struct {
+	uint32_t conversions;		//ADC conversions of the channel
+	uint32_t updates;			//filter updates
+	uint32_t skipped;			//conversions dropped as the sampler could not take the lock or the pipeline ring was full
+	uint32_t overruns;			//missed periods
+	uint32_t latency_avg_us;	//age of the sample when its update is published
+	uint32_t latency_max_us;
+} ad_channel_stats_t;
+
+typedef struct {
+	uint32_t loops;				//sampling loops of the ADC task
+	uint32_t loop_avg_us;		//busy time of a loop
+	uint32_t loop_max_us;
+	uint32_t lock_avg_us;		//wait of the sampler for the lock
+	uint32_t lock_max_us;
+	uint32_t lock_timeouts;
+	uint32_t stack_free;		//high water mark of the ADC task stack, bytes
+	uint32_t ring_size;			//scans of the pipeline ring, 0 without CONFIG_AD_PIPELINE
+	uint32_t ring_used;
+	uint32_t ring_max;			//high water mark of ring_used
+	uint32_t ring_overflows;	//scans dropped on a full ring
+	uint32_t proc_stack_free;	//high water mark of the processing task stack, bytes
+	ad_channel_stats_t ch[MAX_CHANNELS];
+} ad_stats_t;
+
+/**
+ * @brief copies the health counters, they are updated by the ADC task
+ * 		  without locking, a field can be one update behind another
+ */
+BaseType_t ad_get_stats(ad_stats_t *stats);
+
 BaseType_t ad_deinit(uint8_t ch);
 
 
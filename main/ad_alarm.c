@@ -0,0 +1,225 @@
+/*
+ * ad_alarm.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "ad.h"
+#include "ad_alarm.h"
+
+#if AD_ALARM_MAX>32
+#error CONFIG_AD_ALARM_MAX must fit the 32 bit active mask
+#endif
+
+/**
+ * Inputs of a check, the low alarm is a high alarm on the negated value, so
+ * every check is the same compare.
+ */
+enum {
+	INPUT_VALUE,
+	INPUT_NEG,
+	INPUT_RATE,
+	INPUT_MAX
+};
+
+typedef struct {
+	int32_t set;		//turns on at input>=set
+	int32_t clear;		//turns off at input<clear
+	uint8_t input;
+	uint8_t id;
+} check_t;
+
+typedef struct {
+	ad_alarm_t alarm;
+	TaskHandle_t task;
+	QueueHandle_t queue;
+	uint8_t used;
+} subscriber_t;
+
+typedef struct {
+	uint16_t value;
+	uint16_t prev;
+	int64_t timestamp;
+	int64_t prev_timestamp;
+	uint8_t updated;
+} input_t;
+
+static const char *TYPE_NAMES[AD_ALARM_TYPE_MAX]={"high", "low", "rate"};
+
+static SemaphoreHandle_t alarm_sem;	//guards the subscribers and the table
+static subscriber_t subscribers[AD_ALARM_MAX];
+static check_t checks[AD_ALARM_MAX];
+static uint8_t first[MAX_CHANNELS+1];	//checks of ch are first[ch]..first[ch+1]-1
+static uint32_t active;
+static uint32_t dropped;
+static uint32_t busy;		//scans skipped while the console held the table
+static input_t inputs[MAX_CHANNELS];
+
+/**
+ * Rebuilds the table ordered by channel, called under alarm_sem.
+ */
+static void compile() {
+	uint8_t n=0;
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch) {
+		first[ch]=n;
+		for(uint8_t id=0; id<AD_ALARM_MAX; ++id) {
+			const subscriber_t *s=&subscribers[id];
+			if (!s->used || s->alarm.ch!=ch)
+				continue;
+
+			check_t *c=&checks[n++];
+			c->id=id;
+			switch (s->alarm.type) {
+			case AD_ALARM_LOW:
+				c->input=INPUT_NEG;
+				c->set=-s->alarm.limit;
+				c->clear=-s->alarm.limit-s->alarm.hyst;
+				break;
+			case AD_ALARM_RATE:
+				c->input=INPUT_RATE;
+				c->set=s->alarm.limit;
+				c->clear=s->alarm.limit-s->alarm.hyst;
+				break;
+			default:
+				c->input=INPUT_VALUE;
+				c->set=s->alarm.limit;
+				c->clear=s->alarm.limit-s->alarm.hyst;
+				break;
+			}
+		}
+	}
+	first[MAX_CHANNELS]=n;
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch)
+		inputs[ch].prev_timestamp=0;	//no rate across a gap without checks
+}
+
+static void notify(uint8_t id, uint8_t on, const input_t *in) {
+	const subscriber_t *s=&subscribers[id];
+	if (s->task)
+		xTaskNotify(s->task, 1u<<id, eSetBits);
+
+	if (s->queue) {
+		ad_alarm_event_t event={
+			.id=id,
+			.ch=s->alarm.ch,
+			.type=s->alarm.type,
+			.active=on,
+			.value=in->value,
+			.timestamp=in->timestamp
+		};
+		if (xQueueSend(s->queue, &event, 0)!=pdPASS)
+			++dropped;
+	}
+}
+
+BaseType_t ad_alarm_init() {
+	if (alarm_sem)
+		return pdPASS;
+
+	alarm_sem=xSemaphoreCreateMutex();
+	return alarm_sem?pdPASS:pdFAIL;
+}
+
+int ad_alarm_subscribe(const ad_alarm_t *alarm, TaskHandle_t task, QueueHandle_t queue) {
+	if (!alarm || alarm->ch>=MAX_CHANNELS || alarm->type>=AD_ALARM_TYPE_MAX || (!task && !queue))
+		return -1;
+
+	if (alarm->type==AD_ALARM_RATE ? alarm->limit<=0 : (alarm->limit<AD_MIN || alarm->limit>AD_MAX))
+		return -1;
+
+	int id=-1;
+	xSemaphoreTake(alarm_sem, portMAX_DELAY);
+	for(int i=0; i<AD_ALARM_MAX; ++i)
+		if (!subscribers[i].used) {
+			subscribers[i]=(subscriber_t) {.alarm=*alarm, .task=task, .queue=queue, .used=1};
+			__atomic_and_fetch(&active, ~(1u<<i), __ATOMIC_RELAXED);
+			compile();
+			id=i;
+			break;
+		}
+	xSemaphoreGive(alarm_sem);
+	return id;
+}
+
+BaseType_t ad_alarm_unsubscribe(int id) {
+	if (id<0 || id>=AD_ALARM_MAX)
+		return pdFAIL;
+
+	xSemaphoreTake(alarm_sem, portMAX_DELAY);
+	BaseType_t res=subscribers[id].used?pdPASS:pdFAIL;
+	subscribers[id].used=0;
+	__atomic_and_fetch(&active, ~(1u<<id), __ATOMIC_RELAXED);
+	compile();
+	xSemaphoreGive(alarm_sem);
+	return res;
+}
+
+uint32_t ad_alarm_active() {
+	return __atomic_load_n(&active, __ATOMIC_RELAXED);
+}
+
+uint32_t ad_alarm_dropped() {
+	return dropped;
+}
+
+void ad_alarm_print() {
+	xSemaphoreTake(alarm_sem, portMAX_DELAY);
+	printf("alarms: %d of %d, events dropped:%u, scans skipped:%u\r\n", first[MAX_CHANNELS], AD_ALARM_MAX, dropped, busy);
+	for(uint8_t i=0; i<first[MAX_CHANNELS]; ++i) {
+		const subscriber_t *s=&subscribers[checks[i].id];
+		printf("id:%d, channel:%d, %s, limit:%d, hyst:%d, %s\r\n",
+				checks[i].id, s->alarm.ch, TYPE_NAMES[s->alarm.type], s->alarm.limit, s->alarm.hyst,
+				ad_alarm_active()&(1u<<checks[i].id)?"on":"off");
+	}
+	xSemaphoreGive(alarm_sem);
+}
+
+void ad_alarm_update(uint8_t ch, uint16_t value, int64_t timestamp) {
+	inputs[ch].value=value;
+	inputs[ch].timestamp=timestamp;
+	inputs[ch].updated=1;
+}
+
+void ad_alarm_scan() {
+	if (!first[MAX_CHANNELS])
+		return;
+
+	if (xSemaphoreTake(alarm_sem, 0)!=pdTRUE) {
+		++busy;
+		return;
+	}
+
+	uint32_t state=active;
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch) {
+		input_t *in=&inputs[ch];
+		if (!in->updated)
+			continue;
+
+		int32_t x[INPUT_MAX];
+		x[INPUT_VALUE]=in->value;
+		x[INPUT_NEG]=-in->value;
+		x[INPUT_RATE]=0;
+		int64_t dt=in->timestamp-in->prev_timestamp;
+		if (in->prev_timestamp && dt>0)
+			x[INPUT_RATE]=(int32_t) (llabs((int64_t) (in->value-in->prev)*1000000)/dt);
+
+		in->prev=in->value;
+		in->prev_timestamp=in->timestamp;
+		in->updated=0;
+
+		for(uint8_t i=first[ch]; i<first[ch+1]; ++i) {
+			const check_t *c=&checks[i];
+			uint32_t bit=1u<<c->id;
+			if (state&bit ? x[c->input]<c->clear : x[c->input]>=c->set) {
+				state^=bit;
+				notify(c->id, !!(state&bit), in);
+			}
+		}
+	}
+	__atomic_store_n(&active, state, __ATOMIC_RELAXED);
+	xSemaphoreGive(alarm_sem);
+}
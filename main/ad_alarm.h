@@ -0,0 +1,80 @@
+/*
+ * ad_alarm.h
+ *
+ * Threshold and rate-of-change alarms on the normalized value of the
+ * channels, in mV. The subscriptions are compiled into one table ordered by
+ * channel, the ADC task scans the checks of the updated channels once per
+ * scan and wakes a subscriber only when its alarm turns on or off.
+ */
+
+#ifndef MAIN_AD_ALARM_H_
+#define MAIN_AD_ALARM_H_
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#define AD_ALARM_MAX (CONFIG_AD_ALARM_MAX)
+
+typedef enum {
+	AD_ALARM_HIGH,		//on at value>=limit, off below limit-hyst
+	AD_ALARM_LOW,		//on at value<=limit, off above limit+hyst
+	AD_ALARM_RATE,		//on at |rate|>=limit, off below limit-hyst, rate in mV/s
+	AD_ALARM_TYPE_MAX
+} ad_alarm_type_t;
+
+typedef struct {
+	uint8_t ch;
+	ad_alarm_type_t type;
+	int32_t limit;		//mV, mV/s for AD_ALARM_RATE
+	uint16_t hyst;		//same unit as limit
+} ad_alarm_t;
+
+typedef struct {
+	uint8_t id;			//returned by ad_alarm_subscribe()
+	uint8_t ch;
+	uint8_t type;
+	uint8_t active;		//1 the alarm turned on, 0 turned off
+	uint16_t value;		//normalized value of the scan, mV
+	int64_t timestamp;	//esp_timer time of the sample, us
+} ad_alarm_event_t;
+
+BaseType_t ad_alarm_init();
+
+/**
+ * @brief registers an alarm
+ * @param task notified with eSetBits of 1<<id on every change, can be NULL
+ * @param queue receives an ad_alarm_event_t on every change without
+ * 		  blocking the ADC task, can be NULL, one of task and queue is required
+ * @return id of the alarm, -1 if the table is full or the alarm is invalid
+ */
+int ad_alarm_subscribe(const ad_alarm_t *alarm, TaskHandle_t task, QueueHandle_t queue);
+
+BaseType_t ad_alarm_unsubscribe(int id);
+
+/**
+ * @brief bit id is set if the alarm is on
+ */
+uint32_t ad_alarm_active();
+
+/**
+ * @brief events lost on full subscriber queues
+ */
+uint32_t ad_alarm_dropped();
+
+void ad_alarm_print();
+
+/**
+ * @brief stores the last sample of a channel, called by the ADC task only
+ */
+void ad_alarm_update(uint8_t ch, uint16_t value, int64_t timestamp);
+
+/**
+ * @brief evaluates the checks of the channels updated since the last scan,
+ * 		  called by the ADC task only. The scan is skipped while the console
+ * 		  holds the table, the updates wait for the next scan.
+ */
+void ad_alarm_scan();
+
+#endif /* MAIN_AD_ALARM_H_ */
@@ -0,0 +1,44 @@
+/*
+ * ad_conv.c
+ */
+
+#include <math.h>
+#include <string.h>
+#include "ad_conv.h"
+
+#define T_MAX ((double) INT32_MAX/(1<<AD_CONV_Q))
+
+/**
+ * The segments are evaluated in double, a float slope times a code of 12
+ * bits is off by more than an LSB of the table at the far end. A steep
+ * outer segment may leave the Q AD_CONV_Q range far from its points, the
+ * entries saturate there instead of overflowing lround.
+ */
+int ad_conv_build(const ad_conv_point_t *points, uint8_t n, int32_t *lut, uint16_t size) {
+	if (!points || !lut || n<2 || n>AD_CONV_MAX_POINTS)
+		return 0;
+
+	ad_conv_point_t p[AD_CONV_MAX_POINTS];
+	memcpy(p, points, n*sizeof(ad_conv_point_t));
+	for(int i=1; i<n; ++i)
+		for(int j=i; j>0 && p[j-1].d>p[j].d; --j) {
+			ad_conv_point_t tmp=p[j];
+			p[j]=p[j-1];
+			p[j-1]=tmp;
+		}
+	for(int i=0; i<n; ++i)
+		if ((i && p[i].d==p[i-1].d) || !(fabs(p[i].t)<=T_MAX))
+			return 0;
+
+	int seg=0;
+	double tga=((double) p[1].t-p[0].t)/(p[1].d-p[0].d);
+	for(int d=0; d<size; ++d) {
+		if (d>=p[seg+1].d && seg<n-2) {
+			++seg;
+			tga=((double) p[seg+1].t-p[seg].t)/(p[seg+1].d-p[seg].d);
+		}
+		double q=(p[seg].t+tga*(d-p[seg].d))*(1<<AD_CONV_Q);
+		lut[d]=q>=INT32_MAX ? INT32_MAX : q<=INT32_MIN ? INT32_MIN : lround(q);
+	}
+	return 1;
+}
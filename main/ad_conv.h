@@ -0,0 +1,55 @@
+/*
+ * ad_conv.h
+ *
+ * Piecewise linear conversion of a channel value to temperature through a
+ * lookup table in fixed point. The table is rebuilt from the calibration
+ * points when they change, the sampler only indexes it, so the sample path
+ * has no float. Values are interpolated between the points sorted by value
+ * and extrapolated from the first and last segment. A value with fraction
+ * bits is interpolated between two entries by ad_conv_lookup.
+ *
+ * No ESP-IDF dependencies, it builds on the host as well.
+ */
+
+#ifndef MAIN_AD_CONV_H_
+#define MAIN_AD_CONV_H_
+
+#include <stdint.h>
+
+#define AD_CONV_Q (16)		//fraction bits of the table entries
+#define AD_CONV_MAX_POINTS (16)
+#define AD_CONV_TO_FLOAT(q) ((float) (q)/(1<<AD_CONV_Q))
+
+/**
+ * A calibration point, stored as is in the configuration of ad.c
+ */
+typedef struct __attribute__((packed)) {
+	uint16_t d;
+	float t;
+} ad_conv_point_t;
+
+/**
+ * @brief fills lut[0..size-1] with the temperature of every value in Q AD_CONV_Q
+ * @param points 2..AD_CONV_MAX_POINTS points of distinct d in any order, every t
+ * 		  within the range of Q AD_CONV_Q
+ * @return 0 if the points are invalid, lut is not changed then. Entries
+ * 		   extrapolated out of the range are saturated at INT32_MIN/INT32_MAX.
+ */
+int ad_conv_build(const ad_conv_point_t *points, uint8_t n, int32_t *lut, uint16_t size);
+
+/**
+ * @brief temperature of a value with a fraction, linear between the entry of
+ * 		  the value and the next one
+ * @param x value in Q q, past the table it gives the last entry
+ * @return Q AD_CONV_Q
+ */
+static inline int32_t ad_conv_lookup(const int32_t *lut, uint16_t size, uint32_t x, uint8_t q) {
+	uint32_t i=x>>q;
+	if (i>=size-1u)
+		return lut[size-1];
+
+	int64_t step=(int64_t) lut[i+1]-lut[i];
+	return lut[i]+(int32_t) ((step*(int32_t) (x&((1u<<q)-1)))>>q);
+}
+
+#endif /* MAIN_AD_CONV_H_ */
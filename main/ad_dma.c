@@ -0,0 +1,198 @@
+/*
+ * ad_dma.c
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "driver/adc.h"
+
+#include "ad.h"
+#include "ad_dma.h"
+
+#include "esp_log.h"
+
+#define TAG "ad_dma"
+
+#define MAX(a,b) ((a)>(b)?(a):(b))
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+
+#if CONFIG_AD_ACQ_CONTINUOUS || CONFIG_AD_ACQ_SIMULATED
+static uint8_t channel_count;
+#endif
+
+#if CONFIG_AD_ACQ_CONTINUOUS
+
+#define RESULT_BYTES (SOC_ADC_DIGI_RESULT_BYTES)
+#define FRAME_BYTES (CONFIG_AD_FRAME_SCANS*ADC1_CHANNEL_MAX*RESULT_BYTES)
+
+static uint8_t dma_buf[FRAME_BYTES];
+static int8_t hw_to_idx[ADC1_CHANNEL_MAX];
+
+BaseType_t ad_dma_init(const adc_channel_t *channels, const adc_atten_t *atten, uint8_t count) {
+	static adc_digi_pattern_config_t pattern[ADC1_CHANNEL_MAX];
+	if (!channels || !atten || !count || count>ADC1_CHANNEL_MAX)
+		return pdFAIL;
+
+	uint32_t mask=0;
+	memset(hw_to_idx, -1, sizeof(hw_to_idx));
+	for(uint8_t i=0; i<count; ++i) {
+		mask|=1<<channels[i];
+		hw_to_idx[channels[i]]=i;
+		pattern[i].atten=atten[i];
+		pattern[i].channel=channels[i];
+		pattern[i].unit=0;	//ADC1
+		pattern[i].bit_width=SOC_ADC_DIGI_MAX_BITWIDTH;
+	}
+
+	adc_digi_init_config_t init = {
+		.max_store_buf_size=FRAME_BYTES*4,
+		.conv_num_each_intr=CONFIG_AD_FRAME_SCANS*count*RESULT_BYTES,
+		.adc1_chan_mask=mask,
+		.adc2_chan_mask=0
+	};
+	esp_err_t res=adc_digi_initialize(&init);
+	if (res!=ESP_OK) {
+		ESP_LOGE(TAG, "Cannot initialize adc digi:%s", esp_err_to_name(res));
+		return pdFAIL;
+	}
+
+	adc_digi_configuration_t config = {
+		.conv_limit_en=1,
+		.conv_limit_num=250,
+		.pattern_num=count,
+		.adc_pattern=pattern,
+		.sample_freq_hz=CONFIG_AD_CONV_FREQ_HZ,
+		.conv_mode=ADC_CONV_SINGLE_UNIT_1,
+		.format=ADC_DIGI_OUTPUT_FORMAT_TYPE1
+	};
+	res=adc_digi_controller_configure(&config);
+	if (res==ESP_OK)
+		res=adc_digi_start();
+
+	if (res!=ESP_OK) {
+		ESP_LOGE(TAG, "Cannot start adc digi:%s", esp_err_to_name(res));
+		adc_digi_deinitialize();
+		return pdFAIL;
+	}
+	channel_count=count;
+	ESP_LOGI(TAG, "continuous conversion of %d channels at %d Hz", count, CONFIG_AD_CONV_FREQ_HZ);
+	return pdPASS;
+}
+
+int ad_dma_read(ad_sample_t *frame, int max, TickType_t ticks) {
+	if (!frame || !channel_count)
+		return -1;
+
+	uint32_t len=0;
+	esp_err_t res=adc_digi_read_bytes(dma_buf, MIN(sizeof(dma_buf), (uint32_t) max*RESULT_BYTES),
+									  &len, ticks*portTICK_PERIOD_MS);
+	if (res==ESP_ERR_TIMEOUT)
+		return 0;
+
+	//ESP_ERR_INVALID_STATE means the driver buffer was full, data is still valid
+	if (res!=ESP_OK && res!=ESP_ERR_INVALID_STATE)
+		return -1;
+
+	int n=0;
+	for(uint32_t i=0; i<len; i+=RESULT_BYTES) {
+		const adc_digi_output_data_t *d=(const adc_digi_output_data_t *) &dma_buf[i];
+		uint8_t hw=d->type1.channel;
+		if (hw>=ADC1_CHANNEL_MAX || hw_to_idx[hw]<0)
+			continue;
+
+		frame[n].ch=hw_to_idx[hw];
+		frame[n].raw=d->type1.data;
+		++n;
+	}
+	return n;
+}
+
+BaseType_t ad_dma_deinit() {
+	if (!channel_count)
+		return pdFAIL;
+
+	adc_digi_stop();
+	adc_digi_deinitialize();
+	channel_count=0;
+	return pdPASS;
+}
+
+#elif CONFIG_AD_ACQ_SIMULATED
+
+#define SIM_NOISE (16)
+#define SIM_LOW (AD_MAX/4)
+#define SIM_HIGH (AD_MAX*3/4)
+
+static ad_sim_t sim[ADC1_CHANNEL_MAX];
+static ad_sim_config_t sim_pending[ADC1_CHANNEL_MAX];
+static uint32_t sim_pending_mask;		//channels with a new config for the next frame
+
+BaseType_t ad_dma_init(const adc_channel_t *channels, const adc_atten_t *atten, uint8_t count) {
+	if (!channels || !atten || !count || count>ADC1_CHANNEL_MAX)
+		return pdFAIL;
+
+	for(uint8_t i=0; i<count; ++i) {
+		ad_sim_config_t config={
+			.shape=AD_SIM_TRIANGLE,
+			.low=SIM_LOW,
+			.high=SIM_HIGH,
+			.rate=i+1,
+			.noise=SIM_NOISE
+		};
+		ad_sim_init(&sim[i], &config, 0x12345678+i);
+		sim[i].value=SIM_LOW+i*(SIM_HIGH-SIM_LOW)/count;
+	}
+	channel_count=count;
+	ESP_LOGI(TAG, "simulated conversion of %d channels at %d Hz", count, CONFIG_AD_CONV_FREQ_HZ);
+	return pdPASS;
+}
+
+int ad_dma_read(ad_sample_t *frame, int max, TickType_t ticks) {
+	if (!frame || !channel_count)
+		return -1;
+
+	int scans=MIN(CONFIG_AD_FRAME_SCANS, max/channel_count);
+	uint32_t ms=(uint32_t) scans*channel_count*1000/CONFIG_AD_CONV_FREQ_HZ;
+	vTaskDelay(MAX(1, pdMS_TO_TICKS(ms)));
+
+	uint32_t pending=__atomic_exchange_n(&sim_pending_mask, 0, __ATOMIC_ACQUIRE);
+	for(uint8_t ch=0; pending; ++ch, pending>>=1)
+		if (pending&1)
+			ad_sim_init(&sim[ch], &sim_pending[ch], sim[ch].seed);
+
+	int n=0;
+	for(int s=0; s<scans; ++s)
+		for(uint8_t ch=0; ch<channel_count; ++ch, ++n) {
+			frame[n].ch=ch;
+			frame[n].raw=ad_sim_next(&sim[ch]);
+		}
+
+	return n;
+}
+
+BaseType_t ad_dma_deinit() {
+	channel_count=0;
+	return pdPASS;
+}
+
+BaseType_t ad_dma_sim_config(uint8_t ch, const ad_sim_config_t *config) {
+	ad_sim_t probe;
+	if (ch>=channel_count || !ad_sim_init(&probe, config, 1))
+		return pdFAIL;
+
+	while (__atomic_load_n(&sim_pending_mask, __ATOMIC_ACQUIRE)&(1u<<ch))
+		vTaskDelay(1);
+
+	sim_pending[ch]=*config;
+	__atomic_or_fetch(&sim_pending_mask, 1u<<ch, __ATOMIC_RELEASE);
+	return pdPASS;
+}
+
+const ad_sim_config_t *ad_dma_sim_get(uint8_t ch) {
+	return ch<channel_count ? &sim[ch].config : NULL;
+}
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ * ad_dma.h
+ *
+ * Frame source of the continuous acquisition modes. The ADC (or the
+ * simulator) scans every channel of the channel table and delivers the
+ * results in frames, a frame contains CONFIG_AD_FRAME_SCANS scans.
+ */
+
+#ifndef MAIN_AD_DMA_H_
+#define MAIN_AD_DMA_H_
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/adc.h"
+#include "ad_sim.h"
+
+typedef struct {
+	uint8_t ch;		//index in the channel table, not the ADC channel
+	uint16_t raw;
+} ad_sample_t;
+
+/**
+ * @brief start scanning of channels
+ * @param channels ADC1 channels to scan, the index of the channel in this
+ * 		  array is reported in ad_sample_t.ch
+ * @param atten attenuation of each channel
+ * @param count number of channels
+ */
+BaseType_t ad_dma_init(const adc_channel_t *channels, const adc_atten_t *atten, uint8_t count);
+
+/**
+ * @brief read the next frame
+ * @param frame buffer of the samples
+ * @param max size of frame
+ * @param ticks max wait for the frame
+ * @return number of samples stored into frame, 0 on timeout, -1 on error
+ */
+int ad_dma_read(ad_sample_t *frame, int max, TickType_t ticks);
+
+BaseType_t ad_dma_deinit();
+
+#if CONFIG_AD_ACQ_SIMULATED
+/**
+ * @brief replaces the signal of a simulated channel from the next frame
+ */
+BaseType_t ad_dma_sim_config(uint8_t ch, const ad_sim_config_t *config);
+
+const ad_sim_config_t *ad_dma_sim_get(uint8_t ch);
+#endif
+
+#endif /* MAIN_AD_DMA_H_ */
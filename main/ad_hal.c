@@ -0,0 +1,28 @@
+/*
+ * ad_hal.c
+ */
+
+#include "ad_hal.h"
+
+#define NAMESPACE "ad"
+
+esp_err_t ad_hal_store_open(ad_hal_store_t *store, uint8_t write) {
+	return nvs_open(NAMESPACE, write ? NVS_READWRITE : NVS_READONLY, store);
+}
+
+esp_err_t ad_hal_store_get_blob(ad_hal_store_t store, const char *key, void *blob, size_t *len) {
+	return nvs_get_blob(store, key, blob, len);
+}
+
+esp_err_t ad_hal_store_get_u16(ad_hal_store_t store, const char *key, uint16_t *value) {
+	return nvs_get_u16(store, key, value);
+}
+
+esp_err_t ad_hal_store_set_blob(ad_hal_store_t store, const char *key, const void *blob, size_t len) {
+	esp_err_t res=nvs_set_blob(store, key, blob, len);
+	return res==ESP_OK ? nvs_commit(store) : res;
+}
+
+void ad_hal_store_close(ad_hal_store_t store) {
+	nvs_close(store);
+}
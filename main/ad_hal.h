@@ -0,0 +1,62 @@
+/*
+ * ad_hal.h
+ *
+ * Hardware access of the ADC pipeline: single conversions, time and the
+ * configuration store. ad.c reaches the chip only through these and the
+ * frame source of ad_dma.h, so a port replaces this file and ad_hal.c.
+ * The calls of the sample path are inline.
+ */
+
+#ifndef MAIN_AD_HAL_H_
+#define MAIN_AD_HAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "driver/adc.h"
+#include "nvs.h"
+
+#define AD_HAL_KEY_SIZE (NVS_KEY_NAME_MAX_SIZE)
+
+typedef nvs_handle_t ad_hal_store_t;
+
+static inline uint16_t ad_hal_adc_read(adc1_channel_t channel) {
+	return adc1_get_raw(channel);
+}
+
+/**
+ * @brief monotonic time, us
+ */
+static inline int64_t ad_hal_time_us() {
+	return esp_timer_get_time();
+}
+
+/**
+ * @brief CPU cycle counter, wraps
+ */
+static inline uint32_t ad_hal_cycles() {
+	return esp_cpu_get_ccount();
+}
+
+/**
+ * @brief opens the configuration namespace of the pipeline
+ */
+esp_err_t ad_hal_store_open(ad_hal_store_t *store, uint8_t write);
+
+/**
+ * @param blob NULL stores the length of the blob in *len
+ */
+esp_err_t ad_hal_store_get_blob(ad_hal_store_t store, const char *key, void *blob, size_t *len);
+
+esp_err_t ad_hal_store_get_u16(ad_hal_store_t store, const char *key, uint16_t *value);
+
+/**
+ * @brief writes the blob and commits it
+ */
+esp_err_t ad_hal_store_set_blob(ad_hal_store_t store, const char *key, const void *blob, size_t len);
+
+void ad_hal_store_close(ad_hal_store_t store);
+
+#endif /* MAIN_AD_HAL_H_ */
@@ -0,0 +1,147 @@
+/*
+ * ad_history.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+
+#include "ad.h"
+#include "ad_history.h"
+
+#include "esp_log.h"
+
+#define TAG "ad_history"
+
+#define HISTORY_SIZE (CONFIG_AD_HISTORY_SIZE)
+#define SLOT(i) ((i)&(HISTORY_SIZE-1))
+
+//head runs freely over the whole u32 range, a slot index must survive its wrap
+#if HISTORY_SIZE & (HISTORY_SIZE-1)
+#error CONFIG_AD_HISTORY_SIZE must be a power of two
+#endif
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+
+#if CONFIG_AD_HISTORY_PSRAM
+#define HISTORY_CAPS (MALLOC_CAP_SPIRAM|MALLOC_CAP_8BIT)
+#else
+#define HISTORY_CAPS (MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT)
+#endif
+
+typedef struct {
+	ad_record_t *records;
+	uint32_t head;		//number of records written, next slot is SLOT(head)
+} history_t;
+
+static history_t history[MAX_CHANNELS];
+static uint8_t channel_count;
+
+BaseType_t ad_history_init(uint8_t channels) {
+	if (channels>MAX_CHANNELS)
+		return pdFAIL;
+
+	for(uint8_t ch=0; ch<channels; ++ch) {
+		history[ch].records=heap_caps_calloc(HISTORY_SIZE, sizeof(ad_record_t), HISTORY_CAPS);
+		if (!history[ch].records) {
+			ESP_LOGE(TAG, "Cannot allocate history of channel %d", ch);
+			return pdFAIL;
+		}
+		history[ch].head=0;
+	}
+	channel_count=channels;
+	ESP_LOGI(TAG, "%d records per channel, %u bytes", HISTORY_SIZE, (unsigned) ad_history_bytes());
+	return pdPASS;
+}
+
+void ad_history_push(uint8_t ch, int64_t timestamp, uint16_t raw, uint16_t filtered) {
+	if (ch>=channel_count)
+		return;
+
+	history_t *h=&history[ch];
+	//the previous head store must be visible before the slot is overwritten,
+	//readers tell a torn copy by the head they load after it (ad_seqlock.h)
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	ad_record_t *r=&h->records[SLOT(h->head)];
+	r->timestamp=(uint32_t) timestamp;
+	r->raw=raw;
+	r->filtered=filtered;
+	__atomic_store_n(&h->head, h->head+1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Copies n records starting at record index first, then drops the ones the
+ * writer overwrote meanwhile.
+ * @return records kept, *dropped is the number of records dropped
+ */
+static uint32_t copy_records(const history_t *h, uint32_t first, uint32_t n,
+							 ad_record_t *records, uint32_t *dropped) {
+	for(uint32_t i=0; i<n; ++i)
+		records[i]=h->records[SLOT(first+i)];
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	//the writer may be overwriting the slot of record head_now-HISTORY_SIZE
+	uint32_t head_now=__atomic_load_n(&h->head, __ATOMIC_RELAXED);
+	uint32_t lost=head_now-first>=HISTORY_SIZE ? head_now-first-HISTORY_SIZE+1 : 0;
+	*dropped=MIN(lost, n);
+	if (lost>=n)
+		return 0;
+
+	if (lost)
+		memmove(records, records+lost, (n-lost)*sizeof(ad_record_t));
+
+	return n-lost;
+}
+
+int ad_history_read(uint8_t ch, ad_record_t *records, int max) {
+	if (ch>=channel_count || !records || max<=0)
+		return 0;
+
+	const history_t *h=&history[ch];
+	uint32_t head=__atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+	uint32_t n=MIN((uint32_t) max, MIN(head, HISTORY_SIZE));
+	uint32_t dropped;
+	return copy_records(h, head-n, n, records, &dropped);
+}
+
+int ad_history_read_from(uint8_t ch, uint32_t *cursor, ad_record_t *records, int max, uint32_t *lost) {
+	if (ch>=channel_count || !cursor || !records || max<=0)
+		return 0;
+
+	const history_t *h=&history[ch];
+	uint32_t head=__atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+	uint32_t first=*cursor;
+	uint32_t skipped=0;
+	//the oldest slot may be under overwrite, keep one slot distance
+	if (head-first>HISTORY_SIZE-1) {
+		skipped=head-first-(HISTORY_SIZE-1);
+		first+=skipped;
+	}
+	uint32_t n=MIN((uint32_t) max, head-first);
+	uint32_t dropped;
+	uint32_t copied=copy_records(h, first, n, records, &dropped);
+	*cursor=first+n;
+	if (lost)
+		*lost+=skipped+dropped;
+
+	return copied;
+}
+
+uint32_t ad_history_head(uint8_t ch) {
+	if (ch>=channel_count)
+		return 0;
+
+	return __atomic_load_n(&history[ch].head, __ATOMIC_ACQUIRE);
+}
+
+uint32_t ad_history_count(uint8_t ch) {
+	if (ch>=channel_count)
+		return 0;
+
+	return MIN(__atomic_load_n(&history[ch].head, __ATOMIC_RELAXED), HISTORY_SIZE);
+}
+
+size_t ad_history_bytes() {
+	return (size_t) channel_count*HISTORY_SIZE*sizeof(ad_record_t);
+}
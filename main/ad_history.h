@@ -0,0 +1,70 @@
+/*
+ * ad_history.h
+ *
+ * Per-channel ring of the last CONFIG_AD_HISTORY_SIZE samples. The ADC task
+ * is the only writer, readers copy a window out without locking and drop
+ * the records that were overwritten during the copy.
+ *
+ * A record keeps the low 32 bits of the esp_timer time to stay 8 bytes, the
+ * timestamp wraps every 2^32 us (~71.6 minutes). Order records by the signed
+ * difference (int32_t) (a-b), it holds for records less than ~35 minutes
+ * apart. A slow channel with a large ring can hold older records, their
+ * absolute time is ambiguous.
+ */
+
+#ifndef MAIN_AD_HISTORY_H_
+#define MAIN_AD_HISTORY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+
+typedef struct __attribute__((packed)) {
+	uint32_t timestamp;		//low 32 bits of the esp_timer time, us
+	uint16_t raw;
+	uint16_t filtered;
+} ad_record_t;
+
+/**
+ * @brief allocates the rings, in PSRAM if CONFIG_AD_HISTORY_PSRAM is set
+ */
+BaseType_t ad_history_init(uint8_t channels);
+
+/**
+ * @param timestamp esp_timer time, us, the record keeps its low 32 bits
+ */
+void ad_history_push(uint8_t ch, int64_t timestamp, uint16_t raw, uint16_t filtered);
+
+/**
+ * @brief copies the last max records of a channel, oldest first
+ * @return number of records copied
+ */
+int ad_history_read(uint8_t ch, ad_record_t *records, int max);
+
+/**
+ * @brief copies the records written after *cursor, oldest first
+ * @param cursor record index to start from, start with 0, advanced past the
+ * 		  returned records
+ * @param lost incremented with the records that were overwritten before they
+ * 		  could be copied, can be NULL
+ * @return number of records copied
+ */
+int ad_history_read_from(uint8_t ch, uint32_t *cursor, ad_record_t *records, int max, uint32_t *lost);
+
+/**
+ * @brief index of the next record of the channel, a cursor of
+ * 		  ad_history_read_from() set to it skips the records stored so far
+ */
+uint32_t ad_history_head(uint8_t ch);
+
+/**
+ * @brief records stored in the ring of a channel so far, saturates at the capacity
+ */
+uint32_t ad_history_count(uint8_t ch);
+
+/**
+ * @brief memory used by the rings of all channels in bytes
+ */
+size_t ad_history_bytes();
+
+#endif /* MAIN_AD_HISTORY_H_ */
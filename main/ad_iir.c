@@ -0,0 +1,77 @@
+/*
+ * ad_iir.c
+ */
+
+#include <math.h>
+#include <string.h>
+#include "ad_iir.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define Q(c) ((int32_t) lround((c)*(double) (1<<AD_IIR_COEF_Q)))
+
+static const char *names[AD_FILTER_MAX]={"none", "ema", "biquad"};
+
+const char *ad_iir_name(ad_filter_type_t type) {
+	return type<AD_FILTER_MAX ? names[type] : "?";
+}
+
+/**
+ * y=alpha*x+(1-alpha)*y, b0 is taken from the rounded a1 so that
+ * b0=1+a1 holds exactly and the DC gain is 1
+ */
+static void ema_coefs(ad_biquad_t *s, double w) {
+	double alpha=1.0-exp(-w);
+	s->a1=Q(alpha-1.0);
+	s->a2=0;
+	s->b0=(1<<AD_IIR_COEF_Q)+s->a1;
+	s->b1=0;
+	s->b2=0;
+}
+
+/**
+ * low-pass of the audio EQ cookbook (R. Bristow-Johnson) with Q=1/sqrt(2).
+ * At a low cutoff b0 is a few thousand LSB and its rounding alone moves the
+ * DC gain by a few 1e-4, so the numerator is split from the rounded
+ * denominator: b0+b1+b2=1+a1+a2 exactly, b1 takes the remainder.
+ */
+static void biquad_coefs(ad_biquad_t *s, double w) {
+	double alpha=sin(w)/(2.0*M_SQRT1_2);
+	double cosw=cos(w);
+	double a0=1.0+alpha;
+	s->a1=Q(-2.0*cosw/a0);
+	s->a2=Q((1.0-alpha)/a0);
+	int32_t sum=(1<<AD_IIR_COEF_Q)+s->a1+s->a2;
+	s->b0=(sum+2)>>2;
+	s->b2=s->b0;
+	s->b1=sum-2*s->b0;
+}
+
+int ad_iir_config(ad_iir_t *f, ad_filter_type_t type, uint8_t stages,
+				  float cutoff_hz, float sample_hz, uint16_t seed) {
+	if (!f || type>=AD_FILTER_MAX || stages>AD_IIR_MAX_STAGES)
+		return 0;
+
+	if (type!=AD_FILTER_NONE && (!stages || sample_hz<=0 || cutoff_hz<=0 || cutoff_hz>=sample_hz/2))
+		return 0;
+
+	memset(f, 0, sizeof(*f));
+	f->type=type;
+	f->stages=type==AD_FILTER_NONE ? 0 : stages;
+	f->cutoff_hz=cutoff_hz;
+	f->sample_hz=sample_hz;
+	double w=2.0*M_PI*cutoff_hz/sample_hz;
+	int32_t state=(int32_t) seed<<AD_IIR_STATE_Q;
+	for(uint8_t i=0; i<f->stages; ++i) {
+		ad_biquad_t *s=&f->section[i];
+		if (type==AD_FILTER_EMA)
+			ema_coefs(s, w);
+		else
+			biquad_coefs(s, w);
+
+		s->x1=s->x2=s->y1=s->y2=state;
+	}
+	return 1;
+}
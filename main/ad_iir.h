@@ -0,0 +1,82 @@
+/*
+ * ad_iir.h
+ *
+ * Fixed point low-pass filter bank. Every filter type is a cascade of
+ * direct form I biquad sections, a first order EMA is a section with
+ * b1=b2=a2=0, so the per sample kernel is the same for all types. The
+ * truncation error of a section is fed back into its next sample, otherwise
+ * the high DC gain of the recursive part of low cutoff sections shows it
+ * as an offset. The numerator is derived from the rounded denominator, so
+ * the DC gain of every section is exactly 1.
+ * Coefficients are computed in float only when the filter is configured.
+ *
+ * No ESP-IDF dependencies, it builds on the host as well.
+ */
+
+#ifndef MAIN_AD_IIR_H_
+#define MAIN_AD_IIR_H_
+
+#include <stdint.h>
+
+#define AD_IIR_MAX_STAGES (4)
+#define AD_IIR_COEF_Q (28)		//fraction bits of the coefficients
+#define AD_IIR_STATE_Q (8)		//fraction bits of the section states
+
+typedef enum {
+	AD_FILTER_NONE=0,
+	AD_FILTER_EMA,
+	AD_FILTER_BIQUAD,
+	AD_FILTER_MAX
+} ad_filter_type_t;
+
+typedef struct {
+	int32_t b0, b1, b2;
+	int32_t a1, a2;
+	int32_t x1, x2;
+	int32_t y1, y2;
+	int32_t err;		//truncation error fed back into the next sample
+} ad_biquad_t;
+
+typedef struct {
+	ad_filter_type_t type;
+	uint8_t stages;
+	float cutoff_hz;
+	float sample_hz;
+	ad_biquad_t section[AD_IIR_MAX_STAGES];
+} ad_iir_t;
+
+/**
+ * @brief computes the coefficients and sets the states to seed
+ * @param type AD_FILTER_EMA: stages first order sections,
+ * 		  AD_FILTER_BIQUAD: stages Butterworth (Q=0.707) sections
+ * @param cutoff_hz -3dB frequency of a section, must be below sample_hz/2
+ * @return 0 if a parameter is invalid, f is not changed then
+ */
+int ad_iir_config(ad_iir_t *f, ad_filter_type_t type, uint8_t stages,
+				  float cutoff_hz, float sample_hz, uint16_t seed);
+
+const char *ad_iir_name(ad_filter_type_t type);
+
+/**
+ * @brief runs x through the sections
+ * @return filtered value, x if the filter is AD_FILTER_NONE
+ */
+static inline uint16_t ad_iir_process(ad_iir_t *f, uint16_t x) {
+	int32_t v=(int32_t) x<<AD_IIR_STATE_Q;
+	for(uint8_t i=0; i<f->stages; ++i) {
+		ad_biquad_t *s=&f->section[i];
+		int64_t acc=(int64_t) s->b0*v+(int64_t) s->b1*s->x1+(int64_t) s->b2*s->x2
+				   -(int64_t) s->a1*s->y1-(int64_t) s->a2*s->y2+s->err;
+		int32_t y=(int32_t) (acc>>AD_IIR_COEF_Q);
+		s->err=(int32_t) (acc-((int64_t) y<<AD_IIR_COEF_Q));
+		s->x2=s->x1;
+		s->x1=v;
+		s->y2=s->y1;
+		s->y1=y;
+		v=y;
+	}
+	v=(v+(1<<(AD_IIR_STATE_Q-1)))>>AD_IIR_STATE_Q;
+	return v<0 ? 0 : v>UINT16_MAX ? UINT16_MAX : v;
+}
+
+#endif /* MAIN_AD_IIR_H_ */
@@ -0,0 +1,87 @@
+/*
+ * ad_kernel.c
+ */
+
+#include "ad_kernel.h"
+
+/**
+ * delta=K*sigma, sigma=sqrt(pi)/2*mean|x[n]-x[n-1]| for gaussian noise,
+ * sqrt(pi)/2*1024=907.5. The noise of a full scale step is below 2^24, 6 of
+ * its fraction bits are dropped before the product to keep it in 32 bits.
+ */
+#define NOISE_K_SCALE (CONFIG_AD_HYST_NOISE_K*908/10)
+#define NOISE_TO_DELTA(noise) ((((noise)>>6)*NOISE_K_SCALE)>>(AD_KERNEL_NOISE_Q-6+10))
+#define MIN_DELTA (CONFIG_AD_HYST_MIN_DELTA<<AD_KERNEL_Q)
+#define MAX_DELTA (CONFIG_AD_HYST_MAX_DELTA<<AD_KERNEL_Q)
+
+static inline uint16_t clip(int32_t v) {
+	return v<0 ? 0 : v>AD_KERNEL_MAX ? AD_KERNEL_MAX : v;
+}
+
+static inline void set_band(ad_kernel_t *k, uint8_t ch, int32_t centre, uint16_t delta) {
+	k->hyst_centre[ch]=centre;
+	k->hyst_delta[ch]=delta;
+	k->hyst_min[ch]=clip(centre-delta);
+	k->hyst_max[ch]=clip(centre+delta);
+}
+
+void ad_kernel_seed(ad_kernel_t *k, uint8_t ch, uint16_t value) {
+	set_band(k, ch, value, MAX_DELTA);
+	k->prev[ch]=value;
+	k->noise[ch]=((uint64_t) (MAX_DELTA+1)<<(AD_KERNEL_NOISE_Q+10))/NOISE_K_SCALE;
+}
+
+int ad_kernel_set_window(ad_kernel_t *k, uint8_t ch, uint16_t window, uint16_t seed) {
+	if (!window || window>CONFIG_AD_AVG_MAX_WINDOW)
+		return 0;
+
+	for(uint16_t i=0; i<window; ++i)
+		k->queue[ch][i]=seed;
+
+	k->avg_sum[ch]=(uint32_t) seed*window;
+	k->avg_idx[ch]=0;
+	k->avg_window[ch]=window;
+	k->avg_shift[ch]=-1;
+	if (!(window&(window-1)))
+		k->avg_shift[ch]=__builtin_ctz(window);
+	return 1;
+}
+
+/**
+ * A new delta resizes the band around its unclipped centre, so the band only
+ * moves when a sample leaves it, also next to 0 where the clipped edges
+ * would put the centre higher. A sample above the band moves it up by delta
+ * and gives the new top, below moves it down and gives the new bottom,
+ * inside passes through.
+ */
+void ad_kernel_hyst(ad_kernel_t *k, uint32_t mask, const uint16_t *in, uint16_t *out) {
+	AD_KERNEL_FOR_EACH(ch, mask) {
+		uint16_t x=in[ch];
+		uint32_t diff=(x>k->prev[ch] ? x-k->prev[ch] : k->prev[ch]-x)<<AD_KERNEL_NOISE_Q;
+		k->prev[ch]=x;
+		k->noise[ch]+=((int32_t) diff-(int32_t) k->noise[ch])>>CONFIG_AD_HYST_NOISE_SHIFT;
+		uint32_t delta=NOISE_TO_DELTA(k->noise[ch]);
+		delta=delta<MIN_DELTA ? MIN_DELTA : delta>MAX_DELTA ? MAX_DELTA : delta;
+		if (delta!=k->hyst_delta[ch])
+			set_band(k, ch, ad_kernel_centre(k, ch), delta);
+
+		int32_t move=x>k->hyst_max[ch] ? k->hyst_delta[ch] : x<k->hyst_min[ch] ? -k->hyst_delta[ch] : 0;
+		if (move) {
+			set_band(k, ch, k->hyst_centre[ch]+move, k->hyst_delta[ch]);
+			x=move>0 ? k->hyst_max[ch] : k->hyst_min[ch];
+		}
+		out[ch]=x;
+	}
+}
+
+void ad_kernel_avg(ad_kernel_t *k, uint32_t mask, const uint16_t *in, uint16_t *out) {
+	AD_KERNEL_FOR_EACH(ch, mask) {
+		uint16_t *slot=&k->queue[ch][k->avg_idx[ch]];
+		k->avg_sum[ch]+=in[ch]-*slot;
+		*slot=in[ch];
+		if (++k->avg_idx[ch]>=k->avg_window[ch])
+			k->avg_idx[ch]=0;
+
+		out[ch]=k->avg_shift[ch]>=0 ? k->avg_sum[ch]>>k->avg_shift[ch] : k->avg_sum[ch]/k->avg_window[ch];
+	}
+}
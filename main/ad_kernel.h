@@ -0,0 +1,108 @@
+/*
+ * ad_kernel.h
+ *
+ * Noise estimate, moving hysteresis and moving average of all channels in a
+ * struct-of-arrays layout. A stage runs over every channel of a scan before
+ * the next stage starts, so one stage of all channels works on a few
+ * contiguous arrays and the loops call nothing per channel.
+ *
+ * No ESP-IDF dependencies, it builds on the host as well.
+ */
+
+#ifndef MAIN_AD_KERNEL_H_
+#define MAIN_AD_KERNEL_H_
+
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#ifndef CONFIG_AD_CHANNEL_COUNT
+#define CONFIG_AD_CHANNEL_COUNT (8)
+#endif
+#ifndef CONFIG_AD_AVG_MAX_WINDOW
+#define CONFIG_AD_AVG_MAX_WINDOW (1024)
+#endif
+#ifndef CONFIG_AD_HYST_NOISE_K
+#define CONFIG_AD_HYST_NOISE_K (30)
+#endif
+#ifndef CONFIG_AD_HYST_NOISE_SHIFT
+#define CONFIG_AD_HYST_NOISE_SHIFT (6)
+#endif
+#ifndef CONFIG_AD_HYST_MIN_DELTA
+#define CONFIG_AD_HYST_MIN_DELTA (2)
+#endif
+#ifndef CONFIG_AD_HYST_MAX_DELTA
+#define CONFIG_AD_HYST_MAX_DELTA (50)
+#endif
+
+#define AD_KERNEL_CHANNELS (CONFIG_AD_CHANNEL_COUNT)
+#define AD_KERNEL_Q (4)		//fraction bits of the values, the Kconfig deltas are whole units
+#define AD_KERNEL_MAX (UINT16_MAX)	//the band is clipped to 0..AD_KERNEL_MAX
+#define AD_KERNEL_NOISE_Q (8)	//fraction bits of the noise estimate in value units, fewer bias the average low
+
+#if AD_KERNEL_CHANNELS > 32
+#error the channels of a scan are a 32 bit mask
+#endif
+
+/**
+ * Iterates ch over the set bits of mask, lowest first
+ */
+#define AD_KERNEL_FOR_EACH(ch, mask) \
+	for(uint32_t m_=(mask), ch=m_ ? __builtin_ctz(m_) : 0; m_; m_&=m_-1, ch=m_ ? __builtin_ctz(m_) : 0)
+
+/**
+ * All values are in Q AD_KERNEL_Q. The band of ch is hyst_min..hyst_max,
+ * hyst_centre+-hyst_delta clipped to 0..AD_KERNEL_MAX, the centre itself is
+ * not clipped. noise is the moving average of |in-prev| in Q
+ * AD_KERNEL_NOISE_Q of the value. queue[ch] holds the
+ * samples to subtract when they leave the average window, avg_shift is
+ * log2(window) for power of two windows, -1 otherwise.
+ */
+typedef struct {
+	int32_t hyst_centre[AD_KERNEL_CHANNELS];
+	uint16_t hyst_min[AD_KERNEL_CHANNELS];
+	uint16_t hyst_max[AD_KERNEL_CHANNELS];
+	uint16_t hyst_delta[AD_KERNEL_CHANNELS];
+	uint16_t prev[AD_KERNEL_CHANNELS];
+	uint32_t noise[AD_KERNEL_CHANNELS];
+	uint32_t avg_sum[AD_KERNEL_CHANNELS];
+	uint16_t avg_idx[AD_KERNEL_CHANNELS];
+	uint16_t avg_window[AD_KERNEL_CHANNELS];
+	int8_t avg_shift[AD_KERNEL_CHANNELS];
+	uint16_t queue[AD_KERNEL_CHANNELS][CONFIG_AD_AVG_MAX_WINDOW];
+} ad_kernel_t;
+
+/**
+ * @brief centres the band of ch on value at the max delta and seeds the noise
+ * 		  estimate to match, the average is left alone
+ */
+void ad_kernel_seed(ad_kernel_t *k, uint8_t ch, uint16_t value);
+
+/**
+ * @brief resizes the average window of ch and fills it with seed
+ * @return 0 if window is not 1..CONFIG_AD_AVG_MAX_WINDOW
+ */
+int ad_kernel_set_window(ad_kernel_t *k, uint8_t ch, uint16_t window, uint16_t seed);
+
+/**
+ * @brief noise estimate and hysteresis of the channels of mask, in and out
+ * 		  are indexed by channel and can be the same array
+ */
+void ad_kernel_hyst(ad_kernel_t *k, uint32_t mask, const uint16_t *in, uint16_t *out);
+
+/**
+ * @brief moving average of the channels of mask, in and out are indexed by
+ * 		  channel and can be the same array
+ */
+void ad_kernel_avg(ad_kernel_t *k, uint32_t mask, const uint16_t *in, uint16_t *out);
+
+/**
+ * @brief centre of the band of ch, it moves only when a sample leaves the band
+ */
+static inline int32_t ad_kernel_centre(const ad_kernel_t *k, uint8_t ch) {
+	return k->hyst_centre[ch];
+}
+
+#endif /* MAIN_AD_KERNEL_H_ */
@@ -0,0 +1,201 @@
+/*
+ * ad_log.c
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "ad_log.h"
+#include "console.h"
+
+#define STACK_SIZE 3072
+#define DRAIN_PERIOD_MS 20
+#define RING_SIZE (CONFIG_AD_LOG_RING_SIZE)
+#define RING_MASK (RING_SIZE-1)
+#define MAX_TAGS 8
+#define LINE_SIZE 160
+
+#if RING_SIZE & RING_MASK
+#error CONFIG_AD_LOG_RING_SIZE must be a power of two
+#endif
+
+typedef struct {
+	const char *tag;
+	const char *format;
+	uint32_t timestamp;		//ms
+	uint8_t level;
+	uint8_t nargs;
+	int32_t args[AD_LOG_MAX_ARGS];
+} entry_t;
+
+/**
+ * Bounded MPSC queue of D. Vyukov: a slot is free for the producer of
+ * position pos if seq==pos, and holds an entry for the consumer if
+ * seq==pos+1.
+ */
+typedef struct {
+	uint32_t seq;
+	entry_t entry;
+} slot_t;
+
+typedef struct {
+	const char *tag;
+	uint16_t per_sec;
+	uint16_t tokens;
+	uint32_t second;		//second of the last refill
+} rate_t;
+
+static slot_t ring[RING_SIZE];
+static uint32_t head;		//next position of the producers
+static uint32_t tail;		//next position of the consumer
+static esp_log_level_t max_level=ESP_LOG_INFO;
+static rate_t rates[MAX_TAGS];
+static ad_log_stats_t stats;
+static TaskHandle_t log_tsk;
+
+static const char level_chars[]={'N', 'E', 'W', 'I', 'D', 'V'};
+
+/**
+ * Token bucket of the tag, refilled once a second. Concurrent producers of
+ * the same tag may let a message more through, it is a limit for the
+ * output, not a guarantee.
+ */
+static bool rate_allows(const char *tag, uint32_t now_ms) {
+	for(uint8_t i=0; i<MAX_TAGS && rates[i].tag; ++i) {
+		rate_t *r=&rates[i];
+		if (r->tag!=tag && strcmp(r->tag, tag))
+			continue;
+
+		if (!r->per_sec)
+			return true;
+
+		if (now_ms/1000!=r->second) {
+			r->second=now_ms/1000;
+			r->tokens=r->per_sec;
+		}
+		if (!r->tokens)
+			return false;
+
+		--r->tokens;
+		return true;
+	}
+	return true;
+}
+
+void ad_log_write(esp_log_level_t level, const char *tag, const char *format,
+				  const int32_t *args, uint8_t nargs) {
+	if (!G_LOG_ON || level>max_level)
+		return;
+
+	uint32_t now_ms=esp_timer_get_time()/1000;
+	if (!rate_allows(tag, now_ms)) {
+		__atomic_fetch_add(&stats.dropped_rate, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	uint32_t pos=__atomic_load_n(&head, __ATOMIC_RELAXED);
+	slot_t *slot;
+	for(;;) {
+		slot=&ring[pos&RING_MASK];
+		int32_t diff=(int32_t) (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE)-pos);
+		if (!diff) {
+			if (__atomic_compare_exchange_n(&head, &pos, pos+1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+		else if (diff<0) {
+			__atomic_fetch_add(&stats.dropped_full, 1, __ATOMIC_RELAXED);
+			return;
+		}
+		else
+			pos=__atomic_load_n(&head, __ATOMIC_RELAXED);
+	}
+
+	entry_t *e=&slot->entry;
+	e->tag=tag;
+	e->format=format;
+	e->timestamp=now_ms;
+	e->level=level;
+	e->nargs=nargs>AD_LOG_MAX_ARGS ? AD_LOG_MAX_ARGS : nargs;
+	for(uint8_t i=0; i<e->nargs; ++i)
+		e->args[i]=args[i];
+
+	__atomic_store_n(&slot->seq, pos+1, __ATOMIC_RELEASE);
+	__atomic_fetch_add(&stats.written, 1, __ATOMIC_RELAXED);
+}
+
+static bool pop(entry_t *e) {
+	slot_t *slot=&ring[tail&RING_MASK];
+	if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE)!=tail+1)
+		return false;
+
+	*e=slot->entry;
+	__atomic_store_n(&slot->seq, tail+RING_SIZE, __ATOMIC_RELEASE);
+	++tail;
+	return true;
+}
+
+static void print_entry(const entry_t *e) {
+	char line[LINE_SIZE];
+	int32_t a[AD_LOG_MAX_ARGS]={0};
+	memcpy(a, e->args, e->nargs*sizeof(int32_t));
+	snprintf(line, sizeof(line), e->format, a[0], a[1], a[2], a[3]);
+	printf("%c (%u) %s: %s\n", e->level<sizeof(level_chars) ? level_chars[e->level] : '?',
+			e->timestamp, e->tag, line);
+}
+
+static void fn_log(void *arg) {
+	entry_t e;
+	uint32_t reported=0;
+	for(;;) {
+		while (pop(&e))
+			print_entry(&e);
+
+		uint32_t dropped=stats.dropped_full+stats.dropped_rate;
+		if (dropped!=reported && G_LOG_ON) {
+			printf("W ad_log: %u messages dropped (ring full:%u, rate limit:%u)\n",
+					dropped-reported, stats.dropped_full, stats.dropped_rate);
+			reported=dropped;
+		}
+		vTaskDelay(pdMS_TO_TICKS(DRAIN_PERIOD_MS));
+	}
+}
+
+BaseType_t ad_log_init() {
+	if (log_tsk)
+		return pdPASS;
+
+	for(uint32_t i=0; i<RING_SIZE; ++i)
+		ring[i].seq=i;
+
+	return xTaskCreate(fn_log, "ad_log", STACK_SIZE, NULL, tskIDLE_PRIORITY+1, &log_tsk);
+}
+
+void ad_log_set_level(esp_log_level_t level) {
+	max_level=level;
+}
+
+BaseType_t ad_log_set_rate(const char *tag, uint16_t per_sec) {
+	if (!tag)
+		return pdFAIL;
+
+	for(uint8_t i=0; i<MAX_TAGS; ++i) {
+		if (rates[i].tag && strcmp(rates[i].tag, tag))
+			continue;
+
+		rates[i].per_sec=per_sec;
+		rates[i].tokens=per_sec;
+		rates[i].second=0;
+		rates[i].tag=tag;
+		return pdPASS;
+	}
+	return pdFAIL;
+}
+
+void ad_log_get_stats(ad_log_stats_t *s) {
+	if (s)
+		*s=stats;
+}
@@ -0,0 +1,61 @@
+/*
+ * ad_log.h
+ *
+ * Deferred logging for hot paths. AD_LOGx() only stores the level, tag,
+ * format pointer and up to AD_LOG_MAX_ARGS 32 bit integer arguments into a
+ * lock-free ring, a low priority task formats and prints them later, so the
+ * caller never waits for the UART. The format string must be a literal
+ * (it is kept by pointer) and it may use integer conversions only, pass
+ * floats in fixed point.
+ *
+ * Nothing is recorded while G_LOG_ON is false (log off command). A tag can
+ * be limited to a number of messages per second with ad_log_set_rate(),
+ * messages over the limit or not fitting into the ring are counted as
+ * dropped.
+ */
+
+#ifndef MAIN_AD_LOG_H_
+#define MAIN_AD_LOG_H_
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+
+#define AD_LOG_MAX_ARGS (4)
+
+typedef struct {
+	uint32_t written;
+	uint32_t dropped_full;		//ring was full
+	uint32_t dropped_rate;		//over the rate limit of the tag
+} ad_log_stats_t;
+
+void ad_log_write(esp_log_level_t level, const char *tag, const char *format,
+				  const int32_t *args, uint8_t nargs);
+
+#define AD_LOG_LEVEL(level, tag, format, ...) \
+	ad_log_write(level, tag, format, (const int32_t[]) {0, ##__VA_ARGS__}+1, \
+				 sizeof((const int32_t[]) {0, ##__VA_ARGS__})/sizeof(int32_t)-1)
+
+#define AD_LOGE(tag, format, ...) AD_LOG_LEVEL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define AD_LOGW(tag, format, ...) AD_LOG_LEVEL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define AD_LOGI(tag, format, ...) AD_LOG_LEVEL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define AD_LOGD(tag, format, ...) AD_LOG_LEVEL(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+
+/**
+ * @brief creates the drain task
+ */
+BaseType_t ad_log_init();
+
+/**
+ * @brief messages with a level above level are not recorded
+ */
+void ad_log_set_level(esp_log_level_t level);
+
+/**
+ * @brief limits tag to per_sec messages per second, 0 removes the limit
+ */
+BaseType_t ad_log_set_rate(const char *tag, uint16_t per_sec);
+
+void ad_log_get_stats(ad_log_stats_t *stats);
+
+#endif /* MAIN_AD_LOG_H_ */
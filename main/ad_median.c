@@ -0,0 +1,130 @@
+/*
+ * ad_median.c
+ */
+
+#include <stdint.h>
+#include "ad_median.h"
+
+#define MIN_COUNT(m) (((m)->count-1)/2)		//items in the min heap
+#define MAX_COUNT(m) ((m)->count/2)			//items in the max heap
+
+static inline int less(const ad_median_t *m, int i, int j) {
+	return m->data[m->heap[i]]<m->data[m->heap[j]];
+}
+
+static inline int exchange(ad_median_t *m, int i, int j) {
+	uint8_t t=m->heap[i];
+	m->heap[i]=m->heap[j];
+	m->heap[j]=t;
+	m->pos[m->heap[i]]=i;
+	m->pos[m->heap[j]]=j;
+	return 1;
+}
+
+static inline int cmp_exchange(ad_median_t *m, int i, int j) {
+	return less(m, i, j) && exchange(m, i, j);
+}
+
+/**
+ * restores the min heap below i/2, i>0
+ */
+static void min_sort_down(ad_median_t *m, int i) {
+	for (; i<=MIN_COUNT(m); i*=2) {
+		if (i>1 && i<MIN_COUNT(m) && less(m, i+1, i))
+			++i;
+
+		if (!cmp_exchange(m, i, i/2))
+			break;
+	}
+}
+
+/**
+ * restores the max heap below i/2, i<0
+ */
+static void max_sort_down(ad_median_t *m, int i) {
+	for (; i>=-MAX_COUNT(m); i*=2) {
+		if (i<-1 && i>-MAX_COUNT(m) && less(m, i, i-1))
+			--i;
+
+		if (!cmp_exchange(m, i/2, i))
+			break;
+	}
+}
+
+/**
+ * @return 1 if the item reached the median
+ */
+static inline int min_sort_up(ad_median_t *m, int i) {
+	while (i>0 && cmp_exchange(m, i, i/2))
+		i/=2;
+
+	return i==0;
+}
+
+static inline int max_sort_up(ad_median_t *m, int i) {
+	while (i<0 && cmp_exchange(m, i/2, i))
+		i/=2;
+
+	return i==0;
+}
+
+int ad_median_init(ad_median_t *m, uint16_t window) {
+	if (!m || (window && (window<AD_MEDIAN_MIN_WINDOW || window>AD_MEDIAN_MAX_WINDOW)))
+		return 0;
+
+	m->window=window;
+	m->idx=0;
+	m->count=0;
+	m->heap=m->heap_buf+window/2;
+	//initial fill pattern of the heap: median, max, min, max, min...
+	for(int i=window-1; i>=0; --i) {
+		m->pos[i]=((i+1)/2)*((i&1) ? -1 : 1);
+		m->heap[m->pos[i]]=i;
+	}
+	return 1;
+}
+
+uint16_t ad_median_insert(ad_median_t *m, uint16_t value) {
+	if (!m->window)
+		return value;
+
+	int is_new=m->count<m->window;
+	int p=m->pos[m->idx];
+	uint16_t old=m->data[m->idx];
+	m->data[m->idx]=value;
+	if (++m->idx>=m->window)
+		m->idx=0;
+
+	m->count+=is_new;
+	if (p>0) {				//in the min heap
+		if (!is_new && old<value)
+			min_sort_down(m, p*2);
+		else if (min_sort_up(m, p))
+			max_sort_down(m, -1);
+	}
+	else if (p<0) {			//in the max heap
+		if (!is_new && value<old)
+			max_sort_down(m, p*2);
+		else if (max_sort_up(m, p))
+			min_sort_down(m, 1);
+	}
+	else {					//at the median
+		if (MAX_COUNT(m))
+			max_sort_down(m, -1);
+
+		if (MIN_COUNT(m))
+			min_sort_down(m, 1);
+	}
+
+	uint16_t median=m->data[m->heap[0]];
+	if (!(m->count&1))
+		median=(median+m->data[m->heap[-1]])/2;
+
+	return median;
+}
+
+void ad_median_copy(ad_median_t *dst, const ad_median_t *src) {
+	*dst=*src;
+	if (src->heap)
+		dst->heap=dst->heap_buf+(src->heap-src->heap_buf);
+}
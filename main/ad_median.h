@@ -0,0 +1,61 @@
+/*
+ * ad_median.h
+ *
+ * Sliding window median, insert is O(log window). The window is kept in
+ * a ring and indexed by two heaps around the median: a max heap of the
+ * lower half at negative heap indexes, a min heap of the upper half at
+ * positive ones and the median at index 0 (mediator of AShelly).
+ *
+ * No ESP-IDF dependencies, it builds on the host as well.
+ */
+
+#ifndef MAIN_AD_MEDIAN_H_
+#define MAIN_AD_MEDIAN_H_
+
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#ifndef CONFIG_AD_MEDIAN_MAX_WINDOW
+#define CONFIG_AD_MEDIAN_MAX_WINDOW (255)
+#endif
+
+#define AD_MEDIAN_MIN_WINDOW (3)
+#define AD_MEDIAN_MAX_WINDOW (CONFIG_AD_MEDIAN_MAX_WINDOW)
+
+#if AD_MEDIAN_MAX_WINDOW > 255
+#error heap indexes are stored in uint8_t, max window is 255
+#endif
+
+typedef struct {
+	uint16_t data[AD_MEDIAN_MAX_WINDOW];	//ring of the samples
+	int16_t pos[AD_MEDIAN_MAX_WINDOW];		//heap index of data[i]
+	uint8_t heap_buf[AD_MEDIAN_MAX_WINDOW];	//data indexes
+	uint8_t *heap;							//heap_buf+window/2, index 0 is the median
+	uint16_t window;						//0 if the median is switched off
+	uint16_t idx;
+	uint16_t count;
+} ad_median_t;
+
+/**
+ * @brief resets the median to an empty window
+ * @param window AD_MEDIAN_MIN_WINDOW..AD_MEDIAN_MAX_WINDOW or 0 to switch off
+ * @return 0 if window is invalid
+ */
+int ad_median_init(ad_median_t *m, uint16_t window);
+
+/**
+ * @brief pushes value into the window, drops the oldest one if full
+ * @return median of the window, value itself if the median is switched off
+ */
+uint16_t ad_median_insert(ad_median_t *m, uint16_t value);
+
+/**
+ * @brief copies the state of src into dst, heap of dst points into its own
+ * 		  buffer, a plain struct copy would share the heap of src
+ */
+void ad_median_copy(ad_median_t *dst, const ad_median_t *src);
+
+#endif /* MAIN_AD_MEDIAN_H_ */
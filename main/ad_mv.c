@@ -0,0 +1,72 @@
+/*
+ * ad_mv.c
+ */
+
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_adc_cal.h"
+
+#include "ad_mv.h"
+
+#include "esp_log.h"
+
+#define TAG "ad_mv"
+
+static const char *EFUSE_NAMES[]={"eFuse Vref", "eFuse two point", "default Vref", "eFuse two point fit"};
+
+static ad_mv_source_t mv_source;
+static uint16_t *tables[ADC_ATTEN_MAX];
+static const char *names[ADC_ATTEN_MAX];
+
+static esp_adc_cal_characteristics_t chars[ADC_ATTEN_MAX];
+
+static uint32_t efuse_source(adc_atten_t atten, uint16_t raw) {
+	return esp_adc_cal_raw_to_voltage(raw, &chars[atten]);
+}
+
+void ad_mv_set_source(ad_mv_source_t source) {
+	mv_source=source;
+}
+
+const uint16_t *ad_mv_table(adc_atten_t atten) {
+	if (atten>=ADC_ATTEN_MAX)
+		return NULL;
+
+	if (tables[atten])
+		return tables[atten];
+
+	uint16_t *table=malloc(AD_MV_CODES*sizeof(uint16_t));
+	if (!table)
+		return NULL;
+
+	ad_mv_source_t source=mv_source;
+	if (source)
+		names[atten]="injected";
+	else {
+		esp_adc_cal_value_t type=esp_adc_cal_characterize(ADC_UNIT_1, atten, ADC_WIDTH_BIT_12,
+				CONFIG_AD_DEFAULT_VREF_MV, &chars[atten]);
+		names[atten]=type<ESP_ADC_CAL_VAL_MAX ? EFUSE_NAMES[type] : "unknown";
+		source=efuse_source;
+	}
+
+	for(uint16_t raw=0; raw<AD_MV_CODES; ++raw) {
+		uint32_t mv=source(atten, raw);
+		table[raw]=mv<UINT16_MAX ? mv : UINT16_MAX;
+	}
+	ESP_LOGI(TAG, "attenuation:%d, %s, %dmV..%dmV", atten, names[atten], table[0], table[AD_MV_CODES-1]);
+	tables[atten]=table;
+	return table;
+}
+
+const char *ad_mv_source_name(adc_atten_t atten) {
+	return atten<ADC_ATTEN_MAX && names[atten] ? names[atten] : "none";
+}
+
+size_t ad_mv_bytes() {
+	size_t bytes=0;
+	for(int i=0; i<ADC_ATTEN_MAX; ++i)
+		if (tables[i])
+			bytes+=AD_MV_CODES*sizeof(uint16_t);
+
+	return bytes;
+}
@@ -0,0 +1,62 @@
+/*
+ * ad_mv.h
+ *
+ * Raw code to millivolt tables, one per attenuation, built once from the
+ * characterization of the chip. The source of the characterization can be
+ * replaced before the first table is built, e.g. by a model on a host.
+ * An oversampled code has fraction bits, ad_mv_lookup interpolates it
+ * between two entries, so the mV keep the resolution of the burst.
+ */
+
+#ifndef MAIN_AD_MV_H_
+#define MAIN_AD_MV_H_
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "driver/adc.h"
+
+#define AD_MV_CODES (4096)
+#define AD_MV_Q (4)		//fraction bits of the codes and mV of ad_mv_lookup
+
+/**
+ * @brief millivolts of a raw code at an attenuation
+ */
+typedef uint32_t (*ad_mv_source_t)(adc_atten_t atten, uint16_t raw);
+
+/**
+ * @brief replaces the eFuse characterization, must be called before the
+ * 		  first ad_mv_table(), NULL restores the default
+ */
+void ad_mv_set_source(ad_mv_source_t source);
+
+/**
+ * @brief returns the table of the attenuation, builds it on the first call
+ * @return table of AD_MV_CODES entries, NULL if it cannot be allocated
+ */
+const uint16_t *ad_mv_table(adc_atten_t atten);
+
+/**
+ * @brief mV of a code with a fraction, linear between the entries of the
+ * 		  code and the next one
+ * @param raw code in Q AD_MV_Q
+ * @return mV in Q AD_MV_Q, saturated at UINT16_MAX
+ */
+static inline uint16_t ad_mv_lookup(const uint16_t *table, uint16_t raw) {
+	uint16_t code=raw>>AD_MV_Q;
+	int32_t mv=(int32_t) table[code]<<AD_MV_Q;
+	if (code<AD_MV_CODES-1)
+		mv+=((int32_t) table[code+1]-table[code])*(raw&((1<<AD_MV_Q)-1));
+	return mv<UINT16_MAX ? mv : UINT16_MAX;
+}
+
+/**
+ * @brief characterization used for the attenuation, "none" if no table was built
+ */
+const char *ad_mv_source_name(adc_atten_t atten);
+
+/**
+ * @brief memory of the built tables in bytes
+ */
+size_t ad_mv_bytes();
+
+#endif /* MAIN_AD_MV_H_ */
@@ -0,0 +1,42 @@
+/*
+ * ad_ring.c
+ */
+
+#include <string.h>
+#include "ad_ring.h"
+
+void ad_ring_init(ad_ring_t *r) {
+	memset(r, 0, sizeof(*r));
+}
+
+/**
+ * The slot is written before head is released, so the consumer never sees a
+ * half written scan.
+ */
+int ad_ring_push(ad_ring_t *r, const ad_ring_scan_t *scan) {
+	uint32_t head=r->head;
+	uint32_t used=head-__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+	if (used>=AD_RING_SIZE) {
+		++r->overflows;
+		return 0;
+	}
+	r->slot[head&(AD_RING_SIZE-1)]=*scan;
+	__atomic_store_n(&r->head, head+1, __ATOMIC_RELEASE);
+	if (used+1>r->max_used)
+		r->max_used=used+1;
+	return 1;
+}
+
+/**
+ * The slot is copied out before tail is released, so the producer never
+ * overwrites a scan being read.
+ */
+int ad_ring_pop(ad_ring_t *r, ad_ring_scan_t *scan) {
+	uint32_t tail=r->tail;
+	if (tail==__atomic_load_n(&r->head, __ATOMIC_ACQUIRE))
+		return 0;
+
+	*scan=r->slot[tail&(AD_RING_SIZE-1)];
+	__atomic_store_n(&r->tail, tail+1, __ATOMIC_RELEASE);
+	return 1;
+}
@@ -0,0 +1,76 @@
+/*
+ * ad_ring.h
+ *
+ * Lock-free single producer, single consumer ring of raw scans between the
+ * acquisition and the processing task. head is written by the producer only,
+ * tail by the consumer only, both run freely and are masked on access. A full
+ * ring drops the new scan and counts it, the producer never waits.
+ *
+ * No ESP-IDF dependencies, it builds on the host as well.
+ */
+
+#ifndef MAIN_AD_RING_H_
+#define MAIN_AD_RING_H_
+
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#ifndef CONFIG_AD_CHANNEL_COUNT
+#define CONFIG_AD_CHANNEL_COUNT (8)
+#endif
+#ifndef CONFIG_AD_RING_SIZE
+#define CONFIG_AD_RING_SIZE (16)
+#endif
+
+#define AD_RING_CHANNELS (CONFIG_AD_CHANNEL_COUNT)
+#define AD_RING_SIZE (CONFIG_AD_RING_SIZE)
+
+#if AD_RING_SIZE & (AD_RING_SIZE-1)
+#error CONFIG_AD_RING_SIZE must be a power of two
+#endif
+
+/**
+ * The channels of mask were converted in one loop of the acquisition task,
+ * the other entries are stale.
+ */
+typedef struct {
+	uint32_t mask;
+	uint16_t raw[AD_RING_CHANNELS];
+	int64_t ts[AD_RING_CHANNELS];		//time of the conversion, us
+	int64_t deadline[AD_RING_CHANNELS];	//deadline it served, us
+} ad_ring_scan_t;
+
+typedef struct {
+	ad_ring_scan_t slot[AD_RING_SIZE];
+	uint32_t head;
+	uint32_t tail;
+	uint32_t overflows;		//scans dropped on a full ring
+	uint32_t max_used;		//high water mark
+} ad_ring_t;
+
+void ad_ring_init(ad_ring_t *r);
+
+/**
+ * @brief called by the producer only
+ * @return 0 if the ring is full, the scan is dropped
+ */
+int ad_ring_push(ad_ring_t *r, const ad_ring_scan_t *scan);
+
+/**
+ * @brief called by the consumer only
+ * @return 0 if the ring is empty
+ */
+int ad_ring_pop(ad_ring_t *r, ad_ring_scan_t *scan);
+
+/**
+ * @brief scans waiting, exact for the producer and the consumer, a snapshot
+ * 		  for anybody else
+ */
+static inline uint32_t ad_ring_used(const ad_ring_t *r) {
+	return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE)-__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+}
+
+#endif /* MAIN_AD_RING_H_ */
@@ -0,0 +1,61 @@
+/*
+ * ad_seqlock.h
+ *
+ * Double buffered publication for a single writer and any number of
+ * readers. The writer fills buf[(seq+1)&1] and then increments seq, a reader
+ * copies buf[seq&1] and retries if seq changed meanwhile. The writer never
+ * waits, a preempted writer never blocks the readers.
+ *
+ *	writer:
+ *		buf[ad_seqlock_write_begin(&seq)]=value;
+ *		ad_seqlock_write_end(&seq);
+ *	reader:
+ *		do {
+ *			s=ad_seqlock_read_begin(&seq);
+ *			value=buf[s&1];
+ *		} while (ad_seqlock_read_retry(&seq, s));
+ *
+ * No ESP-IDF dependencies, it builds on the host as well.
+ */
+
+#ifndef MAIN_AD_SEQLOCK_H_
+#define MAIN_AD_SEQLOCK_H_
+
+#include <stdint.h>
+
+/**
+ * The buffer to fill was published two writes ago, the fence keeps the seq
+ * of the previous write ahead of the new data, so a reader still copying
+ * that buffer sees seq changed.
+ * @brief called by the writer only
+ * @return index of the buffer to fill
+ */
+static inline uint32_t ad_seqlock_write_begin(const uint32_t *seq) {
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	return (*seq+1)&1;
+}
+
+/**
+ * @brief called by the writer only, publishes the filled buffer
+ */
+static inline void ad_seqlock_write_end(uint32_t *seq) {
+	__atomic_store_n(seq, *seq+1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @return seq to read buf[seq&1] of, 0 if nothing was published yet
+ */
+static inline uint32_t ad_seqlock_read_begin(const uint32_t *seq) {
+	return __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @param start return value of ad_seqlock_read_begin()
+ * @return nonzero if the copy may be torn and must be repeated
+ */
+static inline int ad_seqlock_read_retry(const uint32_t *seq, uint32_t start) {
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return start!=__atomic_load_n(seq, __ATOMIC_RELAXED);
+}
+
+#endif /* MAIN_AD_SEQLOCK_H_ */
@@ -0,0 +1,70 @@
+/*
+ * ad_sim.c
+ */
+
+#include <stddef.h>
+#include "ad_sim.h"
+
+static const char *NAMES[AD_SIM_SHAPE_MAX]={"triangle", "ramp", "noise", "spikes", "steps"};
+
+static inline uint32_t xorshift(uint32_t *seed) {
+	*seed^=*seed<<13;
+	*seed^=*seed>>17;
+	*seed^=*seed<<5;
+	return *seed;
+}
+
+int ad_sim_init(ad_sim_t *s, const ad_sim_config_t *config, uint32_t seed) {
+	if (!s || !config || config->shape>=AD_SIM_SHAPE_MAX || config->low>config->high
+			|| config->high>=AD_SIM_CODES || !seed)
+		return 0;
+
+	if ((config->shape==AD_SIM_SPIKES || config->shape==AD_SIM_STEPS) && !config->period)
+		return 0;
+
+	s->config=*config;
+	s->n=0;
+	s->value=config->low;
+	s->dir=1;
+	s->seed=seed;
+	return 1;
+}
+
+uint16_t ad_sim_next(ad_sim_t *s) {
+	const ad_sim_config_t *c=&s->config;
+	int32_t v;
+	switch (c->shape) {
+	case AD_SIM_TRIANGLE:
+		v=s->value+s->dir*c->rate;
+		if (v>=c->high || v<=c->low) {
+			s->dir=-s->dir;
+			v=v<c->low ? c->low : v>c->high ? c->high : v;
+		}
+		s->value=v;
+		break;
+	case AD_SIM_RAMP:
+		v=s->value+c->rate;
+		if (v>c->high)
+			v=c->low;
+		s->value=v;
+		break;
+	case AD_SIM_SPIKES:
+		v=s->n%c->period ? c->low : c->high;
+		break;
+	case AD_SIM_STEPS:
+		v=(s->n/c->period)&1 ? c->high : c->low;
+		break;
+	default:
+		v=(c->low+c->high)/2;
+		break;
+	}
+	++s->n;
+	if (c->noise)
+		v+=(int32_t) (xorshift(&s->seed)%c->noise)-c->noise/2;
+
+	return v<0 ? 0 : v>=AD_SIM_CODES ? AD_SIM_CODES-1 : v;
+}
+
+const char *ad_sim_name(ad_sim_shape_t shape) {
+	return shape<AD_SIM_SHAPE_MAX ? NAMES[shape] : NULL;
+}
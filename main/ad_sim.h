@@ -0,0 +1,54 @@
+/*
+ * ad_sim.h
+ *
+ * Signal generator of the simulated acquisition. Every shape gets uniform
+ * noise of config.noise peak to peak on top, the output is clamped to the
+ * 12 bit code range.
+ *
+ * No ESP-IDF dependencies, it builds on the host as well.
+ */
+
+#ifndef MAIN_AD_SIM_H_
+#define MAIN_AD_SIM_H_
+
+#include <stdint.h>
+
+#define AD_SIM_CODES (4096)
+
+typedef enum {
+	AD_SIM_TRIANGLE,	//low..high..low, rate codes per sample
+	AD_SIM_RAMP,		//low..high then back to low, rate codes per sample
+	AD_SIM_NOISE,		//the middle of low..high
+	AD_SIM_SPIKES,		//low, high for one sample of every period
+	AD_SIM_STEPS,		//low and high for period samples each
+	AD_SIM_SHAPE_MAX
+} ad_sim_shape_t;
+
+typedef struct {
+	ad_sim_shape_t shape;
+	uint16_t low;
+	uint16_t high;
+	uint16_t rate;
+	uint32_t period;	//samples
+	uint16_t noise;
+} ad_sim_config_t;
+
+typedef struct {
+	ad_sim_config_t config;
+	uint32_t n;			//samples generated
+	int32_t value;		//of the triangle and the ramp
+	int8_t dir;
+	uint32_t seed;
+} ad_sim_t;
+
+/**
+ * @param seed of the noise, must not be 0
+ * @return 0 if the config is invalid
+ */
+int ad_sim_init(ad_sim_t *s, const ad_sim_config_t *config, uint32_t seed);
+
+uint16_t ad_sim_next(ad_sim_t *s);
+
+const char *ad_sim_name(ad_sim_shape_t shape);
+
+#endif /* MAIN_AD_SIM_H_ */
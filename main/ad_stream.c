@@ -0,0 +1,189 @@
+/*
+ * ad_stream.c
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/uart.h"
+
+#include "ad.h"
+#include "ad_history.h"
+#include "ad_stream.h"
+
+#include "esp_log.h"
+
+#define TAG "ad_stream"
+
+#define STACK_SIZE 3072
+#define MAX_SAMPLES (CONFIG_AD_STREAM_MAX_SAMPLES)
+#define HEADER_SIZE (8)
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+
+#if MAX_CHANNELS > 8
+#error channel mask of the stream frame is 8 bits
+#endif
+
+static TaskHandle_t stream_tsk;
+static uint8_t streaming;
+static uint16_t seq;
+static uint32_t cursor[MAX_CHANNELS];
+static uint32_t lost[MAX_CHANNELS];
+static ad_stream_stats_t stats;
+
+static ad_record_t records[MAX_SAMPLES];
+static uint8_t frame[AD_STREAM_FRAME_MAX];
+static uint8_t cobs[AD_STREAM_COBS_MAX];
+
+static uint16_t crc16(const uint8_t *data, size_t len) {
+	uint16_t crc=0xffff;
+	while (len--) {
+		crc^=(uint16_t) *data++<<8;
+		for(uint8_t i=0; i<8; ++i)
+			crc=crc&0x8000 ? (crc<<1)^0x1021 : crc<<1;
+	}
+	return crc;
+}
+
+/**
+ * @return length of the encoded frame including the terminating 0
+ */
+static size_t cobs_encode(const uint8_t *src, size_t len, uint8_t *dst) {
+	size_t code_idx=0;
+	size_t out=1;
+	uint8_t code=1;
+	for(size_t i=0; i<len; ++i) {
+		if (src[i]) {
+			dst[out++]=src[i];
+			++code;
+		}
+		if (!src[i] || code==0xff) {
+			dst[code_idx]=code;
+			code_idx=out++;
+			code=1;
+		}
+	}
+	dst[code_idx]=code;
+	dst[out++]=0;
+	return out;
+}
+
+static inline uint8_t *put_u16(uint8_t *p, uint16_t v) {
+	*p++=v;
+	*p++=v>>8;
+	return p;
+}
+
+static inline uint8_t *put_u32(uint8_t *p, uint32_t v) {
+	p=put_u16(p, v);
+	return put_u16(p, v>>16);
+}
+
+/**
+ * @return frame size, 0 if there is nothing to send
+ */
+static size_t build_frame() {
+	ad_snapshot_t snapshot;
+	if (ad_get_all(&snapshot)!=pdPASS)
+		return 0;
+
+	uint8_t *p=frame+HEADER_SIZE;
+	uint8_t mask=0;
+	uint32_t timestamp=0;
+	uint32_t samples=0;
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch) {
+		if (!snapshot.ch[ch].running) {
+			cursor[ch]=ad_history_head(ch);
+			continue;
+		}
+		int n=ad_history_read_from(ch, &cursor[ch], records, MAX_SAMPLES, &lost[ch]);
+		if (n<=0)
+			continue;
+
+		mask|=1<<ch;
+		*p++=n;
+		*p++=MIN(lost[ch], 0xff);
+		stats.lost+=lost[ch];
+		lost[ch]=0;
+		for(int i=0; i<n; i+=2) {
+			uint16_t s0=records[i].filtered&0xfff;
+			uint16_t s1=i+1<n ? records[i+1].filtered&0xfff : 0;
+			*p++=s0;
+			*p++=(s0>>8)|(s1<<4);
+			if (i+1<n)
+				*p++=s1>>4;
+		}
+		if ((int32_t) (records[n-1].timestamp-timestamp)>0 || !timestamp)
+			timestamp=records[n-1].timestamp;
+
+		samples+=n;
+	}
+	if (!mask)
+		return 0;
+
+	uint8_t *h=frame;
+	*h++=AD_STREAM_VERSION;
+	h=put_u16(h, seq++);
+	h=put_u32(h, timestamp);
+	*h++=mask;
+	p=put_u16(p, crc16(frame, p-frame));
+	stats.samples+=samples;
+	return p-frame;
+}
+
+static void fn_stream(void *arg) {
+	TickType_t last=xTaskGetTickCount();
+	for(;;) {
+		if (!streaming) {
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			last=xTaskGetTickCount();
+			continue;
+		}
+		vTaskDelayUntil(&last, pdMS_TO_TICKS(CONFIG_AD_STREAM_PERIOD_MS));
+		size_t len=ad_stream_next(cobs);
+		if (!len)
+			continue;
+
+		uart_write_bytes(CONFIG_ESP_CONSOLE_UART_NUM, cobs, len);
+		++stats.frames;
+		stats.bytes+=len;
+	}
+}
+
+BaseType_t ad_stream_init() {
+	return xTaskCreate(fn_stream, "ad_stream", STACK_SIZE, NULL, tskIDLE_PRIORITY+1, &stream_tsk);
+}
+
+BaseType_t ad_stream_start() {
+	if (!stream_tsk)
+		return pdFAIL;
+
+	for(uint8_t ch=0; ch<MAX_CHANNELS; ++ch) {
+		cursor[ch]=ad_history_head(ch);
+		lost[ch]=0;
+	}
+	memset(&stats, 0, sizeof(stats));
+	streaming=1;
+	xTaskNotifyGive(stream_tsk);
+	return pdPASS;
+}
+
+BaseType_t ad_stream_stop() {
+	streaming=0;
+	return pdPASS;
+}
+
+size_t ad_stream_next(uint8_t *out) {
+	size_t len=build_frame();
+	return len ? cobs_encode(frame, len, out) : 0;
+}
+
+uint8_t ad_stream_running() {
+	return streaming;
+}
+
+void ad_stream_get_stats(ad_stream_stats_t *s) {
+	if (s)
+		*s=stats;
+}
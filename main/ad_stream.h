@@ -0,0 +1,64 @@
+/*
+ * ad_stream.h
+ *
+ * Binary telemetry of the running channels over the console UART. Every
+ * CONFIG_AD_STREAM_PERIOD_MS the stream task collects the new samples from
+ * the history rings into a frame:
+ *
+ *  u8  version (AD_STREAM_VERSION)
+ *  u16 sequence number
+ *  u32 timestamp of the newest sample, us
+ *  u8  channel mask
+ *  for every channel of the mask, lowest first:
+ *      u8  sample count n
+ *      u8  samples lost since the previous frame, saturated at 255
+ *      n filtered samples in mV, 12 bit, two samples in three bytes:
+ *          s0&0xff, (s0>>8)|((s1&0xf)<<4), s1>>4
+ *  u16 CRC-16/CCITT-FALSE of the bytes above
+ *
+ * All fields are little endian. The frame is COBS encoded and terminated
+ * by a 0 byte, so a receiver resynchronizes at the next 0 after garbage
+ * (e.g. a log line) on the line. tools/ad_stream.py decodes it.
+ */
+
+#ifndef MAIN_AD_STREAM_H_
+#define MAIN_AD_STREAM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "ad.h"
+
+#define AD_STREAM_VERSION (1)
+
+//longest frame before and after the COBS encoding
+#define AD_STREAM_FRAME_MAX (8+MAX_CHANNELS*(2+(CONFIG_AD_STREAM_MAX_SAMPLES*3+1)/2)+2)
+#define AD_STREAM_COBS_MAX (AD_STREAM_FRAME_MAX+AD_STREAM_FRAME_MAX/254+2)
+
+typedef struct {
+	uint32_t frames;
+	uint32_t samples;
+	uint32_t bytes;
+	uint32_t lost;		//samples overwritten in the history before they were sent
+} ad_stream_stats_t;
+
+BaseType_t ad_stream_init();
+
+BaseType_t ad_stream_start();
+
+BaseType_t ad_stream_stop();
+
+uint8_t ad_stream_running();
+
+void ad_stream_get_stats(ad_stream_stats_t *stats);
+
+/**
+ * @brief builds the frame of the samples stored since the previous one and
+ * 		  COBS encodes it, called by the stream task only while it runs
+ * @param out AD_STREAM_COBS_MAX bytes
+ * @return encoded length including the terminating 0, 0 if no running
+ * 		   channel has new samples
+ */
+size_t ad_stream_next(uint8_t *out);
+
+#endif /* MAIN_AD_STREAM_H_ */
@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <strings.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -22,6 +23,7 @@
 #include "esp_vfs_fat.h"
 #include "console.h"
 #include "cmd_system.h"
+#include "ad_log.h"
 
 #undef LOG_LOCAL_LEVEL
 #define LOG_LOCAL_LEVEL ESP_LOG_ERROR
@@ -36,6 +38,8 @@
 
 #define CONSOLE_HIST_LINE_SIZE (100)
 
+#define CONSOLE_TX_BUF_SIZE (1024)
+
 #if (CONSOLE_TASK_SIZE < 4096)
 #error "Console task size must be at least 4096"
 #endif
@@ -135,29 +139,30 @@ void console_func(void *arg) {
 #define HELP_LOG "on/off log"
 
 static struct {
-	struct arg_rex *logon;
-	struct arg_rex *logoff;
+	struct arg_rex *state;
 	struct arg_end *end;
 } log_args;
 
 static int cmd_box(int argc, char **argv) {
 	int err=arg_parse(argc, argv, (void **)&log_args);
-	if (err||log_args.logon->count>0) {
-		G_LOG_ON=true;
-		return 0;
+	if (err) {
+		arg_print_errors(stdout, log_args.end, CMD_LOG);
+		return 1;
 	}
-	if (err||log_args.logoff->count>0) {
-		G_LOG_ON=false;
+	if (log_args.state->count>0) {
+		G_LOG_ON=!strcasecmp(log_args.state->sval[0], "on");
 		return 0;
 	}
-	printf("Log is %s\n", G_LOG_ON?"true":"false");
+	ad_log_stats_t stats;
+	ad_log_get_stats(&stats);
+	printf("Log is %s, deferred messages:%u, dropped ring full:%u, rate limit:%u\n",
+			G_LOG_ON?"true":"false", stats.written, stats.dropped_full, stats.dropped_rate);
 	return 0;
 }
 
 static void register_log_cmd() {
-	log_args.logon=arg_rex1(NULL, NULL, "on", NULL, ARG_REX_ICASE, NULL);
-	log_args.logoff=arg_rex1(NULL, NULL, "off", NULL, ARG_REX_ICASE, NULL);
-	log_args.end=arg_end(0);
+	log_args.state=arg_rex0(NULL, NULL, "^(on|off)$", "on|off", ARG_REX_ICASE, NULL);
+	log_args.end=arg_end(1);
 
 	esp_console_cmd_t cmd = {
 		.command=CMD_LOG,
@@ -186,7 +191,7 @@ esp_err_t console_init() {
 			.source_clk = UART_SCLK_REF_TICK
 	};
 
-	ESP_ERROR_CHECK(uart_driver_install(CONFIG_ESP_CONSOLE_UART_NUM, 256, 0, 0, NULL, 0));
+	ESP_ERROR_CHECK(uart_driver_install(CONFIG_ESP_CONSOLE_UART_NUM, 256, CONSOLE_TX_BUF_SIZE, 0, NULL, 0));
 	ESP_ERROR_CHECK(uart_param_config(CONFIG_ESP_CONSOLE_UART_NUM, &uart_config));
 
 	esp_vfs_dev_uart_use_driver(CONFIG_ESP_CONSOLE_UART_NUM);
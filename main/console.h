@@ -12,6 +12,14 @@
 #ifndef MAIN_CONSOLE_H_
 #define MAIN_CONSOLE_H_
 
+#include <stdbool.h>
+#include "esp_err.h"
+
+/**
+ * @brief switched by the log command, checked by the deferred log (ad_log)
+ */
+extern bool G_LOG_ON;
+
 /**
  * @brief Initialize console
  */
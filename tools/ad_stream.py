@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""Decoder of the binary telemetry of the `ad --stream on` console command.
+
+The frame layout is documented in main/ad_stream.h. Usage:
+
+    ad_stream.py /dev/ttyUSB0 [--baud 115200]   decode a serial port
+    ad_stream.py --run CMD [ARG...]             decode the stdout of CMD over a
+                                                pseudo-terminal, check the ramp
+                                                of host_test/stream_host.c and
+                                                report the sustained rate
+
+Serial ports are opened with pyserial if it is installed, other paths
+(pseudo-terminals, captured files) are read as plain files.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import subprocess
+import time
+import tty
+
+VERSION = 1
+HEADER = struct.Struct('<BHIB')
+
+
+def crc16(data):
+    crc = 0xffff
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xffff
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if not code or i + code > len(data):
+            raise ValueError('bad COBS block')
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xff and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def unpack_samples(data, n):
+    samples = []
+    for i in range(0, n, 2):
+        b = data[i // 2 * 3:i // 2 * 3 + 3]
+        samples.append(b[0] | ((b[1] & 0xf) << 8))
+        if i + 1 < n:
+            samples.append((b[1] >> 4) | (b[2] << 4))
+    return samples
+
+
+def decode_frame(packet):
+    """packet: COBS encoded frame without the terminating 0"""
+    frame = cobs_decode(packet)
+    if len(frame) < HEADER.size + 2:
+        raise ValueError('short frame')
+    if crc16(frame[:-2]) != struct.unpack('<H', frame[-2:])[0]:
+        raise ValueError('CRC error')
+    version, seq, timestamp, mask = HEADER.unpack_from(frame)
+    if version != VERSION:
+        raise ValueError('unknown version %d' % version)
+    channels = {}
+    pos = HEADER.size
+    for ch in range(8):
+        if not mask & (1 << ch):
+            continue
+        n, lost = frame[pos], frame[pos + 1]
+        size = (n * 3 + 1) // 2
+        channels[ch] = (lost, unpack_samples(frame[pos + 2:pos + 2 + size], n))
+        pos += 2 + size
+    if pos != len(frame) - 2:
+        raise ValueError('length mismatch')
+    return seq, timestamp, channels
+
+
+class Decoder:
+    def __init__(self):
+        self.buf = bytearray()
+        self.frames = self.samples = self.errors = self.lost = self.gaps = 0
+        self.seq = None
+
+    def feed(self, data):
+        self.buf += data
+        while True:
+            end = self.buf.find(0)
+            if end < 0:
+                return
+            packet, self.buf = bytes(self.buf[:end]), self.buf[end + 1:]
+            if not packet:
+                continue
+            try:
+                seq, timestamp, channels = decode_frame(packet)
+            except (ValueError, IndexError):
+                self.errors += 1
+                continue
+            if self.seq is not None and seq != (self.seq + 1) & 0xffff:
+                self.gaps += 1
+            self.seq = seq
+            self.frames += 1
+            for lost, samples in channels.values():
+                self.samples += len(samples)
+                self.lost += lost
+            yield seq, timestamp, channels
+
+    def summary(self, seconds):
+        return ('frames:%d samples:%d (%.0f samples/s) lost:%d gaps:%d errors:%d'
+                % (self.frames, self.samples, self.samples / seconds,
+                   self.lost, self.gaps, self.errors))
+
+
+def open_port(path, baud):
+    try:
+        import serial
+        return serial.Serial(path, baud, timeout=0.1).read
+    except (ImportError, ValueError, OSError):
+        f = open(path, 'rb', buffering=0)
+        return lambda n: f.read(n)
+
+
+def decode(args):
+    read = open_port(args.port, args.baud)
+    decoder = Decoder()
+    start = time.monotonic()
+    try:
+        while True:
+            for seq, timestamp, channels in decoder.feed(read(4096) or b''):
+                if not args.quiet:
+                    for ch, (lost, samples) in channels.items():
+                        print('%5d %10d ch%d lost:%d %s' % (seq, timestamp, ch, lost,
+                                                            ' '.join(map(str, samples))))
+    except KeyboardInterrupt:
+        pass
+    print(decoder.summary(time.monotonic() - start), file=sys.stderr)
+
+
+def run(args):
+    """Decodes the frames CMD writes to its stdout. Sample i of channel ch
+    is expected to be (i + ch * 1000) & 0xfff, the ramp stream_host writes."""
+    master, slave = os.openpty()
+    tty.setraw(slave)
+    start = time.monotonic()
+    child = subprocess.Popen(args.run, stdout=slave)
+    os.close(slave)
+    decoder = Decoder()
+    expected = {}
+    mismatches = 0
+    while True:
+        try:
+            data = os.read(master, 65536)
+        except OSError:     # EIO once the child closed the slave
+            data = b''
+        if not data:
+            break
+        for seq, timestamp, channels in decoder.feed(data):
+            for ch, (lost, samples) in channels.items():
+                value = expected.get(ch, (ch * 1000) & 0xfff)
+                if lost < 0xff:
+                    value = (value + lost) & 0xfff
+                elif samples:
+                    value = samples[0]
+                for s in samples:
+                    mismatches += s != value
+                    value = (s + 1) & 0xfff
+                expected[ch] = value
+    os.close(master)
+    status = child.wait()
+    print(decoder.summary(time.monotonic() - start))
+    failed = status or decoder.errors or decoder.gaps or mismatches
+    if mismatches:
+        print('%d samples off the ramp' % mismatches, file=sys.stderr)
+    if args.expect is not None and decoder.samples != args.expect:
+        print('%d samples, %d expected' % (decoder.samples, args.expect), file=sys.stderr)
+        failed = True
+    return 1 if failed else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('port', nargs='?', help='serial port or file to decode')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--quiet', action='store_true', help='print the summary only')
+    parser.add_argument('--run', nargs=argparse.REMAINDER, metavar='CMD',
+                        help='decode the stdout of CMD over a pseudo-terminal')
+    parser.add_argument('--expect', type=int, help='samples --run must decode')
+    args = parser.parse_args()
+    if args.run:
+        return run(args)
+    if not args.port:
+        parser.error('port is required')
+    decode(args)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())